@@ -0,0 +1,137 @@
+#pragma once
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+//
+#include <lyrahgames/riscv/assembler/int_literal.hpp>
+#include <lyrahgames/riscv/assembler/lexer.hpp>
+#include <lyrahgames/riscv/assembler/scan_kernel.hpp>
+#include <lyrahgames/riscv/assembler/token.hpp>
+#include <lyrahgames/riscv/assembler/utility.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Lexer front end for contiguous character buffers, like strings or
+/// memory-mapped files. It uses the same rules as 'lexer' but never copies
+/// characters. Identifier tokens are views into the given buffer and
+/// therefore stay valid as long as the buffer itself.
+struct buffer_lexer {
+  using char_traits = lexer::char_traits;
+  using int_type = lexer::int_type;
+  using token = riscv::token;
+
+  buffer_lexer(std::string_view s)
+      : first{s.data()}, last{s.data() + s.size()}, current{first} {}
+
+  operator bool() const { return !eof_reached; }
+
+  /// Identifiers are views into the buffer. Nothing has to be released.
+  void release_identifiers() noexcept {}
+
+  /// Returns the current reading position inside the buffer.
+  auto position() const noexcept -> czstring_iterator { return current; }
+
+  auto peek(size_t offset = 0) const noexcept -> int_type {
+    if (size_t(last - current) <= offset) return char_traits::eof();
+    return char_traits::to_int_type(current[offset]);
+  }
+
+  void ignore(size_t count = 1) noexcept { current += count; }
+
+  void ignore_space() { current = scan_space(current, last); }
+
+  bool newline_match() {
+    if (!lexer::is_newline(peek())) return false;
+    ignore();
+    return true;
+  }
+
+  bool multiline_comment_match() {
+    if (!lexer::is_multiline_comment_start(peek(), peek(1))) return false;
+    ignore(2);
+    // Jump directly to the terminating '*/' or the end of the buffer.
+    current = scan_comment_end(current, last);
+    if (!lexer::is_multiline_comment_end(peek(), peek(1)))
+      throw std::runtime_error("Failed to match end of multiline comment.");
+    ignore(2);
+    return true;
+  }
+
+  bool line_comment_match() {
+    if (!lexer::is_line_comment_start(peek(), peek(1))) return false;
+    current = scan_line_end(current + 2, last);
+    return true;
+  }
+
+  auto identifier_match() -> std::optional<identifier> {
+    const auto start = current;
+    // First character must not be a digit and string should not be empty.
+    if (!lexer::is_identifier_start(peek())) return {};
+    // Following characters can also include digits.
+    current = scan_identifier_tail(current + 1, last);
+    if (!lexer::is_lexeme_end(peek())) return {};
+    if (size_t(current - start) > token::max_identifier_size)
+      throw std::runtime_error("Failed to match too long identifier.");
+    return identifier{start, size_t(current - start)};
+  }
+
+  /// String literals end at the next double quote on the same line.
+  auto string_literal_match() -> std::optional<string_literal> {
+    if (!lexer::is_quote(peek())) return {};
+    const auto start = current + 1;
+    current = start;
+    while (!lexer::is_quote(peek()) && !lexer::is_line_comment_end(peek()))
+      ignore();
+    if (!lexer::is_quote(peek()))
+      throw std::runtime_error("Failed to match end of string literal.");
+    if (size_t(current - start) > token::max_identifier_size)
+      throw std::runtime_error("Failed to match too long string literal.");
+    ignore();
+    return string_literal{{start, size_t(current - start - 1)}};
+  }
+
+  auto int_literal_match() -> std::optional<int_literal> {
+    const auto result = parse_int_literal(current, last);
+    if (!result || !lexer::is_lexeme_end(peek())) return {};
+    return result;
+  }
+
+  auto next_token() -> token {
+    while (true) {
+      ignore_space();
+      if (line_comment_match()) continue;
+      if (multiline_comment_match()) continue;
+      if (newline_match()) {
+        if (newline_started) continue;
+        newline_started = true;
+        return separator{'\n'};
+      }
+      if (lexer::is_end(peek())) {
+        if (newline_started) {
+          eof_reached = true;
+          return {};
+        }
+        newline_started = true;
+        return separator{'\n'};
+      }
+      newline_started = false;
+      if (lexer::is_separator(peek())) {
+        const auto c = separator(peek());
+        ignore();
+        return c;
+      }
+      if (const auto m = identifier_match()) return m.value();
+      if (const auto m = string_literal_match()) return m.value();
+      if (const auto m = int_literal_match()) return m.value();
+      return {};
+    }
+  }
+
+  czstring_iterator first;
+  czstring_iterator last;
+  czstring_iterator current;
+  bool newline_started = true;
+  bool eof_reached = false;
+};
+
+}  // namespace lyrahgames::riscv
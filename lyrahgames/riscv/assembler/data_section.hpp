@@ -0,0 +1,127 @@
+#pragma once
+#include <compare>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+//
+#include <sys/uio.h>
+//
+#include <lyrahgames/riscv/assembler/mapped_file.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Bytes of the data section of one assembly unit.
+/// Values of data directives are copied into one contiguous buffer.
+/// Included files are memory-mapped and only referenced. Their mappings
+/// are shared by all copies of the section. The section is described by
+/// consecutive pieces that are handed over to 'writev' without copies.
+class data_section {
+ public:
+  data_section() = default;
+
+  explicit data_section(std::pmr::memory_resource* r)
+      : buffer{r}, pieces{r} {}
+
+  auto size() const noexcept -> size_t { return total; }
+  bool empty() const noexcept { return !total; }
+
+  /// Returns true if the content of a file has been appended.
+  bool includes_files() const noexcept { return !files.empty(); }
+
+  /// Appends the lowest 'count' bytes of 'value' in little-endian order.
+  void append(uint64_t value, size_t count) {
+    for (size_t i = 0; i < count; ++i) buffer.push_back(char(value >> 8 * i));
+    add_piece(copied, buffer.size() - count, count);
+  }
+
+  /// Appends a copy of the given bytes.
+  void append(std::string_view bytes) {
+    buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+    add_piece(copied, buffer.size() - bytes.size(), bytes.size());
+  }
+
+  /// Appends the content of a file without copying it.
+  void append(mapped_file file) {
+    const auto size = file.view().size();
+    files.push_back(std::make_shared<const mapped_file>(std::move(file)));
+    add_piece(files.size() - 1, 0, size);
+  }
+
+  /// Appends another section, like the one of a chunk parsed on its own.
+  void append(const data_section& other) {
+    const auto base = buffer.size();
+    const auto file_base = files.size();
+    buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+    files.insert(files.end(), other.files.begin(), other.files.end());
+    for (auto p : other.pieces) {
+      if (p.source == copied)
+        p.offset += base;
+      else
+        p.source += file_base;
+      add_piece(p.source, p.offset, p.size);
+    }
+  }
+
+  /// Consecutive pieces of the section. They stay valid until the section
+  /// is modified or destroyed.
+  auto segments() const -> std::vector<iovec> {
+    std::vector<iovec> result{};
+    result.reserve(pieces.size());
+    for (const auto& p : pieces) {
+      const auto data = (p.source == copied) ? buffer.data()
+                                             : files[p.source]->view().data();
+      result.push_back({const_cast<char*>(data) + p.offset, p.size});
+    }
+    return result;
+  }
+
+  /// Returns a copy of all bytes of the section.
+  auto bytes() const -> std::string {
+    std::string result{};
+    result.reserve(total);
+    for (const auto& v : segments())
+      result.append(static_cast<const char*>(v.iov_base), v.iov_len);
+    return result;
+  }
+
+  friend bool operator==(const data_section& x, const data_section& y) {
+    return (x.size() == y.size()) && (x.bytes() == y.bytes());
+  }
+
+  friend auto operator<=>(const data_section& x, const data_section& y) {
+    return x.bytes() <=> y.bytes();
+  }
+
+ private:
+  static constexpr size_t copied = -1;
+
+  /// Range of the buffer or of an included file.
+  struct piece {
+    size_t source;
+    size_t offset;
+    size_t size;
+  };
+
+  /// Adjacent copies are merged into one piece.
+  void add_piece(size_t source, size_t offset, size_t size) {
+    total += size;
+    if (!pieces.empty() && (source == copied)) {
+      auto& p = pieces.back();
+      if ((p.source == copied) && (p.offset + p.size == offset)) {
+        p.size += size;
+        return;
+      }
+    }
+    pieces.push_back({source, offset, size});
+  }
+
+  std::pmr::vector<char> buffer{};
+  std::vector<std::shared_ptr<const mapped_file>> files{};
+  std::pmr::vector<piece> pieces{};
+  size_t total = 0;
+};
+
+}  // namespace lyrahgames::riscv
@@ -0,0 +1,471 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+//
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/program.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Returns the bit field [first, last) of 'x' as sign-extended value.
+constexpr auto signed_bits(uint32_t x, size_t first, size_t last)
+    -> immediate {
+  const auto shift = 64 - last;
+  return immediate(uint64_t{x} << shift) >> (shift + first);
+}
+
+/// Extracts the bit fields of an instruction of the given format.
+/// This is the inverse of 'pack'. Fields that do not exist in the format
+/// are left zero and immediates are sign-extended. Only the upper
+/// immediate of 'U' formats is returned unsigned like it has been written.
+template <instruction_format format>
+constexpr auto unpack(uint32_t x) -> instruction_fields;
+
+template <>
+constexpr auto unpack<instruction_format::r>(uint32_t x)
+    -> instruction_fields {
+  return {bits(x, 0, 7, 0),   bits(x, 7, 12, 0),  bits(x, 12, 15, 0),
+          bits(x, 15, 20, 0), bits(x, 20, 25, 0), bits(x, 25, 32, 0)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::i>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .rd = bits(x, 7, 12, 0),
+          .funct3 = bits(x, 12, 15, 0),
+          .rs1 = bits(x, 15, 20, 0),
+          .imm = signed_bits(x, 20, 32)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::s>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .funct3 = bits(x, 12, 15, 0),
+          .rs1 = bits(x, 15, 20, 0),
+          .rs2 = bits(x, 20, 25, 0),
+          .imm = (signed_bits(x, 25, 32) << 5) | bits(x, 7, 12, 0)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::b>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .funct3 = bits(x, 12, 15, 0),
+          .rs1 = bits(x, 15, 20, 0),
+          .rs2 = bits(x, 20, 25, 0),
+          .imm = (signed_bits(x, 31, 32) << 12) | bits(x, 7, 8, 11) |
+                 bits(x, 8, 12, 1) | bits(x, 25, 31, 5)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::u>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .rd = bits(x, 7, 12, 0),
+          .imm = bits(x, 12, 32, 0)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::j>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .rd = bits(x, 7, 12, 0),
+          .imm = (signed_bits(x, 31, 32) << 20) | bits(x, 12, 20, 12) |
+                 bits(x, 20, 21, 11) | bits(x, 21, 31, 1)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::r4>(uint32_t x)
+    -> instruction_fields {
+  return {bits(x, 0, 7, 0),   bits(x, 7, 12, 0),  bits(x, 12, 15, 0),
+          bits(x, 15, 20, 0), bits(x, 20, 25, 0), bits(x, 25, 27, 0),
+          0,                  bits(x, 27, 32, 0)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::sh>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .rd = bits(x, 7, 12, 0),
+          .funct3 = bits(x, 12, 15, 0),
+          .rs1 = bits(x, 15, 20, 0),
+          .funct7 = bits(x, 26, 32, 1),
+          .imm = bits(x, 20, 26, 0)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::shw>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .rd = bits(x, 7, 12, 0),
+          .funct3 = bits(x, 12, 15, 0),
+          .rs1 = bits(x, 15, 20, 0),
+          .funct7 = bits(x, 25, 32, 0),
+          .imm = bits(x, 20, 25, 0)};
+}
+
+template <>
+constexpr auto unpack<instruction_format::csr>(uint32_t x)
+    -> instruction_fields {
+  return {.opcode = bits(x, 0, 7, 0),
+          .rd = bits(x, 7, 12, 0),
+          .funct3 = bits(x, 12, 15, 0),
+          .rs1 = bits(x, 15, 20, 0),
+          .imm = bits(x, 20, 32, 0)};
+}
+
+/// Unpacking function for every format indexed by 'instruction_format'.
+inline constexpr std::array format_unpackers{
+    unpack<instruction_format::r>,   unpack<instruction_format::i>,
+    unpack<instruction_format::s>,   unpack<instruction_format::b>,
+    unpack<instruction_format::u>,   unpack<instruction_format::j>,
+    unpack<instruction_format::r4>,  unpack<instruction_format::sh>,
+    unpack<instruction_format::shw>, unpack<instruction_format::csr>,
+};
+
+static_assert(format_unpackers.size() == instruction_format_count);
+
+/// Returns the value of the register field 'k' of 'f'.
+/// Indices follow 'instruction_field' from 'rd' to 'rs3'.
+constexpr auto register_field_value(const instruction_fields& f, size_t k)
+    -> uint32_t {
+  const std::array values{f.rd, f.rs1, f.rs2, f.rs3};
+  return values[k];
+}
+
+/// Returns the number of register fields that are tied to another field
+/// by the same operand, like the source of 'fmv.s' for 'fsgnj.s'.
+constexpr auto tied_field_count(const instruction_data& data) -> size_t {
+  size_t result = 0;
+  for (const auto& operand : data.operands) {
+    const auto n = std::popcount(field_set(operand.fields & register_fields));
+    if (n > 1) result += n - 1;
+  }
+  return result;
+}
+
+/// Returns whether all tied register fields of the given overload have
+/// equal values in 'f'. Such ties cannot be expressed by a bit mask.
+constexpr bool ties_hold(const instruction_data& data,
+                         const instruction_fields& f) {
+  for (const auto& operand : data.operands) {
+    size_t first = 4;
+    for (size_t k = 0; k < 4; ++k) {
+      if (!(operand.fields & field_bit(instruction_field(k)))) continue;
+      if (first == 4)
+        first = k;
+      else if (register_field_value(f, k) != register_field_value(f, first))
+        return false;
+    }
+  }
+  return true;
+}
+
+/// Bits of an encoded instruction that are fixed for one entry of the
+/// 'instruction_table'. A word is an instance of the entry if and only if
+/// '(word & mask) == value' and all tied fields are equal. Fields that are
+/// given by no operand, like the immediate of 'nop' or the registers of
+/// 'ret', are fixed as well.
+struct instruction_pattern {
+  uint32_t mask;
+  uint32_t value;
+  uint32_t id;
+};
+
+constexpr auto instruction_pattern_of(size_t id) -> instruction_pattern {
+  using enum instruction_field;
+  constexpr uint32_t opcode_mask = 0x0000007f;
+  constexpr uint32_t funct3_mask = 0x00007000;
+  constexpr std::array<uint32_t, 4> register_masks{0x00000f80, 0x000f8000,
+                                                   0x01f00000, 0xf8000000};
+  // Indexed by 'instruction_format'.
+  constexpr std::array<uint32_t, instruction_format_count> funct7_masks{
+      0xfe000000, 0, 0, 0, 0, 0, 0x06000000, 0xfc000000, 0xfe000000, 0};
+  constexpr std::array<uint32_t, instruction_format_count> imm_masks{
+      0,          0xfff00000, 0xfe000f80, 0xfe000f80, 0xfffff000,
+      0xfffff000, 0,          0x03f00000, 0x01f00000, 0xfff00000};
+
+  const auto& data = instruction_table[id];
+  const auto& e = data.encoding;
+  const auto format = size_t(e.format);
+
+  // Fields that exist in the format and are not given by operands.
+  field_set given = 0;
+  for (const auto& operand : data.operands) given |= operand.fields;
+  const field_set fixed = format_fields[format] & ~given;
+
+  uint32_t mask = opcode_mask | funct7_masks[format];
+  if ((e.format != instruction_format::u) &&
+      (e.format != instruction_format::j))
+    mask |= funct3_mask;
+  for (size_t k = 0; k < register_masks.size(); ++k)
+    if (fixed & field_bit(instruction_field(k))) mask |= register_masks[k];
+  if (fixed & field_bit(imm)) mask |= imm_masks[format];
+
+  const auto value = format_packers[format](
+      {e.opcode, e.rd, e.funct3, e.rs1, e.rs2, e.funct7, e.imm, e.rs3});
+  return {mask, value & mask, uint32_t(id)};
+}
+
+/// Two-level decoding table of all 32-bit entries in 'instruction_table'.
+/// The first level is indexed by the major opcode, i.e. bits [2, 7) of the
+/// word, and the second level by 'funct3'. Every slot refers to a range of
+/// candidate patterns that is sorted such that the first match is the most
+/// specific one. Pseudo instructions with more fixed bits, like 'nop' and
+/// 'ret', come first and tied fields, like in 'fmv.s', count as fixed.
+/// For equal patterns, mnemonics without further overloads, like 'addi',
+/// are preferred to overloads, like 'add'. Entries of the C extension are
+/// decoded by 'instruction_compressed_table' instead.
+struct decoding_table {
+  struct range {
+    uint16_t first = 0;
+    uint16_t last = 0;
+  };
+
+  static constexpr size_t opcode_count = 32;
+  static constexpr size_t funct3_count = 8;
+  static constexpr size_t entry_count = std::size(instruction_table);
+
+  /// Patterns without fixed 'funct3' are placed into all eight slots.
+  static constexpr size_t pattern_count = [] {
+    size_t result = 0;
+    for (const auto& data : instruction_table) {
+      if (data.compressed) continue;
+      const auto format = data.encoding.format;
+      const bool any_funct3 = (format == instruction_format::u) ||
+                              (format == instruction_format::j);
+      result += any_funct3 ? funct3_count : 1;
+    }
+    return result;
+  }();
+
+  static constexpr auto slot_of(uint32_t word) noexcept -> size_t {
+    return bits(word, 2, 7, 3) | bits(word, 12, 15, 0);
+  }
+
+  constexpr decoding_table() {
+    // Overloads of a mnemonic are adjacent in the table.
+    std::array<size_t, entry_count> overloads{};
+    for (size_t first = 0, last = 0; first < entry_count; first = last) {
+      while ((last < entry_count) &&
+             (instruction_names[last] == instruction_names[first]))
+        ++last;
+      for (auto i = first; i < last; ++i) overloads[i] = last - first;
+    }
+
+    std::array<instruction_pattern, entry_count> sorted{};
+    std::array<size_t, entry_count> specificity{};
+    size_t n = 0;
+    for (size_t i = 0; i < entry_count; ++i) {
+      tied[i] = tied_field_count(instruction_table[i]);
+      if (instruction_table[i].compressed) continue;
+      sorted[n++] = instruction_pattern_of(i);
+      const auto fixed = size_t(std::popcount(sorted[n - 1].mask));
+      specificity[i] = ((fixed + 5 * tied[i]) << 8) - overloads[i];
+    }
+    const auto candidates = std::span{sorted}.first(n);
+    std::ranges::sort(candidates, [&](const auto& x, const auto& y) {
+      if (specificity[x.id] != specificity[y.id])
+        return specificity[x.id] > specificity[y.id];
+      return x.id < y.id;
+    });
+
+    // Stable counting sort of the candidates into their slots.
+    constexpr uint32_t funct3_mask = 0x00007000;
+    const auto for_each_slot = [&](const instruction_pattern& p, auto f) {
+      const auto slot = slot_of(p.value);
+      if (p.mask & funct3_mask) {
+        f(slot);
+        return;
+      }
+      for (size_t funct3 = 0; funct3 < funct3_count; ++funct3)
+        f((slot & ~size_t{7}) | funct3);
+    };
+    for (const auto& p : candidates)
+      for_each_slot(p, [&](size_t slot) { ++slots[slot].last; });
+    for (auto& slot : slots) {
+      slot.first = count;
+      count += slot.last;
+      slot.last = slot.first;
+    }
+    for (const auto& p : candidates)
+      for_each_slot(p, [&](size_t slot) { patterns[slots[slot].last++] = p; });
+  }
+
+  /// Returns the id of the instruction overload or 'none' if the word does
+  /// not encode any entry of 'instruction_table'.
+  constexpr auto find(uint32_t word) const noexcept -> size_t {
+    if ((word & 0b11) != 0b11) return none;
+    const auto [first, last] = slots[slot_of(word)];
+    for (auto i = first; i < last; ++i) {
+      const auto& p = patterns[i];
+      if ((word & p.mask) != p.value) continue;
+      if (!tied[p.id]) return p.id;
+      const auto& data = instruction_table[p.id];
+      const auto format = size_t(data.encoding.format);
+      if (ties_hold(data, format_unpackers[format](word))) return p.id;
+    }
+    return none;
+  }
+
+  static constexpr size_t none = -1;
+
+  std::array<range, opcode_count * funct3_count> slots{};
+  std::array<instruction_pattern, pattern_count> patterns{};
+  std::array<uint8_t, entry_count> tied{};
+  uint16_t count = 0;
+};
+
+inline constexpr decoding_table instruction_decoding_table{};
+
+/// Returns the id of the instruction overload encoded by the given word.
+/// Throws if the word encodes no known 32-bit instruction.
+inline auto decode_id(uint32_t word) -> size_t {
+  const auto id = instruction_decoding_table.find(word);
+  if (id == decoding_table::none)
+    throw std::runtime_error("Failed to decode unknown instruction word " +
+                             std::to_string(word) + ".");
+  return id;
+}
+
+/// Returns the id of the instruction of the C extension encoded by the
+/// given 16-bit parcel. Throws for unknown and reserved encodings, like
+/// the all-zero parcel that is defined to be illegal.
+inline auto decode_compressed_id(uint16_t parcel) -> size_t {
+  const auto id = instruction_compressed_table.find(parcel);
+  const auto fail = [parcel] {
+    throw std::runtime_error("Failed to decode unknown compressed parcel " +
+                             std::to_string(parcel) + ".");
+  };
+  if (id == compressed_decoding_table::none) fail();
+  const auto& layout = instruction_table[id].compressed;
+  instruction_fields f{};
+  unpack(layout, parcel, f);
+  if (layout.nonzero_imm && !f.imm) fail();
+  return id;
+}
+
+/// Returns the 32-bit instruction that the given 16-bit parcel of the
+/// C extension expands to. Fields that are tied to a field of the layout,
+/// like 'rs1' of 'c.addi', receive its value.
+inline auto expand(uint16_t parcel) -> uint32_t {
+  const auto id = decode_compressed_id(parcel);
+  const auto& data = instruction_table[id];
+  const auto& e = data.encoding;
+  instruction_fields f{e.opcode, e.rd,     e.funct3, e.rs1,
+                       e.rs2,    e.funct7, e.imm,    e.rs3};
+  unpack(data.compressed, parcel, f);
+  std::array<uint32_t*, 3> fields{&f.rd, &f.rs1, &f.rs2};
+  for (const auto& operand : data.operands) {
+    size_t source = fields.size();
+    for (size_t k = 0; k < fields.size(); ++k)
+      if ((operand.fields & field_bit(instruction_field(k))) &&
+          data.compressed.contains(instruction_field(k)))
+        source = k;
+    if (source == fields.size()) continue;
+    for (size_t k = 0; k < fields.size(); ++k)
+      if (operand.fields & field_bit(instruction_field(k)))
+        *fields[k] = *fields[source];
+  }
+  return format_packers[size_t(e.format)](f);
+}
+
+/// Name of the label that is generated for the given branch target.
+/// The target is given as signed byte offset relative to the text section.
+inline auto decoded_label_name(immediate target) -> std::string {
+  std::array<char, 24> buffer{'.', 'L'};
+  const auto [end, error] =
+      std::to_chars(buffer.data() + 2, buffer.data() + buffer.size(), target);
+  return {buffer.data(), end};
+}
+
+/// Decodes one word located at instruction index 'pc' and appends it to
+/// the program. Branch and jump targets become labels that are named by
+/// 'decoded_label_name' and interned into the symbol table of the program.
+/// Their addresses are not defined here.
+inline void decode(uint32_t word, size_t pc, program& prog) {
+  using enum instruction_field;
+  const auto id = decode_id(word);
+  const auto& data = instruction_table[id];
+  const auto f = format_unpackers[size_t(data.encoding.format)](word);
+
+  // Tied fields are equal. Hence, the first one is sufficient.
+  const auto code = [&f](field_set fields) {
+    for (size_t k = 0; k < 4; ++k)
+      if (fields & field_bit(instruction_field(k)))
+        return uint8_t(register_field_value(f, k));
+    return uint8_t{0};
+  };
+
+  instruction result{id};
+  for (const auto& operand : data.operands) {
+    const bool has_imm = operand.fields & field_bit(imm);
+    switch (operand.type) {
+      case operand_type::int_register:
+        result.operands.push_back(int_register{code(operand.fields)});
+        break;
+      case operand_type::float_register:
+        result.operands.push_back(float_register{code(operand.fields)});
+        break;
+      case operand_type::int_literal:
+        result.operands.push_back(has_imm ? f.imm
+                                          : immediate(code(operand.fields)));
+        break;
+      case operand_type::memory_address:
+        result.operands.push_back(memory_address{
+            int_register{code(operand.fields)}, has_imm ? f.imm : 0});
+        break;
+      case operand_type::label: {
+        const auto target = immediate(pc * instruction_size) + f.imm;
+        result.operands.push_back(
+            prog.symbols.label_id(decoded_label_name(target)));
+        break;
+      }
+    }
+  }
+  prog.instructions.push_back(result);
+}
+
+/// Decodes a whole text section into a program.
+/// Labels are generated for all branch and jump targets. Targets inside
+/// the section, including its end, are defined at their instruction.
+/// Targets outside the section stay undefined. Re-encoding the program by
+/// 'encode_relocatable' gives zero offsets and a relocation for each of
+/// them. The relocations applied to their targets yield the same text.
+inline auto decode(std::span<const uint32_t> text) -> program {
+  program result{};
+  result.instructions.reserve(text.size(), 3 * text.size());
+  for (size_t pc = 0; pc < text.size(); ++pc) {
+    try {
+      decode(text[pc], pc, result);
+    } catch (const std::exception& e) {
+      throw std::runtime_error("At byte offset " +
+                               std::to_string(pc * instruction_size) + ": " +
+                               e.what());
+    }
+  }
+
+  // Label names encode their target. Hence, they need not be stored.
+  auto& symbols = result.symbols;
+  for (size_t label = 0; label < symbols.labels.size(); ++label) {
+    const auto name = symbols.label_names[label].substr(2);
+    immediate target = 0;
+    std::from_chars(name.data(), name.data() + name.size(), target);
+    if ((target < 0) || (target % instruction_size) ||
+        (size_t(target) / instruction_size > text.size()))
+      continue;
+    symbols.labels[label].address = size_t(target) / instruction_size;
+  }
+  return result;
+}
+
+}  // namespace lyrahgames::riscv
@@ -1,6 +1,7 @@
 #pragma once
 #include <optional>
 //
+#include <lyrahgames/riscv/assembler/int_literal.hpp>
 #include <lyrahgames/riscv/assembler/token.hpp>
 #include <lyrahgames/riscv/assembler/utility.hpp>
 
@@ -74,7 +75,7 @@ constexpr auto ignore_space(czstring str) -> czstring {
 /// stopped. It may be used to further parse other elements or do some error
 /// handling.
 constexpr auto int_literal_match(czstring_iterator str, czstring_iterator& end)
-    -> std::optional<int>;
+    -> std::optional<immediate>;
 
 /// Parses given string into an identifier.
 /// If successful, the optional result contains a 'string_view'
@@ -116,62 +117,12 @@ inline auto scan(czstring str, czstring_iterator& next) -> token_list {
 namespace lyrahgames::riscv {
 
 constexpr auto int_literal_match(czstring_iterator str, czstring_iterator& it)
-    -> std::optional<int> {
+    -> std::optional<immediate> {
+  auto last = str;
+  while (!is_lexeme_end(*last)) ++last;
   it = str;
-
-  // Sign Extension
-  bool sign = false;
-  if (*it == '+')
-    ++it;
-  else if (*it == '-') {
-    sign = true;
-    ++it;
-  }
-
-  // First Digit
-  if (!is_digit(*it)) return {};
-  int result = digit(*it++);
-
-  // Number Base Decision
-  int base = 10;
-  auto base_digit = decimal_digit;
-  bool started = true;
-  if (!result) {
-    if ((*it == 'x') || (*it == 'X')) {
-      base = 16;
-      base_digit = hexadecimal_digit;
-      ++it;
-      started = false;
-    } else if ((*it == 'b') || (*it == 'B')) {
-      base = 2;
-      base_digit = binary_digit;
-      ++it;
-      started = false;
-    } else if ((*it == 'o') || (*it == 'O')) {
-      base = 8;
-      base_digit = octal_digit;
-      ++it;
-      started = false;
-    }
-  }
-
-  // The break condition could be generalized.
-  while (!started || !is_lexeme_end(*it)) {
-    // Allow simple prime character to separate numbers anywhere.
-    if (*it == '\'') {
-      ++it;
-      started = false;
-      continue;
-    }
-    // Get the digit and calculate the number.
-    const auto digit = base_digit(*it);
-    if (!digit) return {};
-    result = base * result + digit.value();
-    ++it;
-    started = true;
-  }
-  result = sign ? -result : result;
-
+  const auto result = parse_int_literal(it, last);
+  if (!result || (it != last)) return {};
   return result;
 }
 
@@ -0,0 +1,334 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+//
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+//
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/program.hpp>
+
+namespace lyrahgames::riscv {
+
+// Headers and tables are written in host byte order.
+static_assert(std::endian::native == std::endian::little,
+              "ELF objects for RISC-V can only be written on little-endian "
+              "hosts.");
+
+enum class elf_class : uint8_t { elf32 = ELFCLASS32, elf64 = ELFCLASS64 };
+
+template <elf_class c>
+struct elf_types;
+
+template <>
+struct elf_types<elf_class::elf32> {
+  using header = Elf32_Ehdr;
+  using section_header = Elf32_Shdr;
+  using symbol = Elf32_Sym;
+  using relocation = Elf32_Rela;
+  static constexpr size_t alignment = 4;
+  static constexpr uint32_t flags = EF_RISCV_FLOAT_ABI_SOFT;
+  static constexpr auto relocation_info(uint32_t symbol, uint32_t type) {
+    return ELF32_R_INFO(symbol, type);
+  }
+};
+
+template <>
+struct elf_types<elf_class::elf64> {
+  using header = Elf64_Ehdr;
+  using section_header = Elf64_Shdr;
+  using symbol = Elf64_Sym;
+  using relocation = Elf64_Rela;
+  static constexpr size_t alignment = 8;
+  // Objects follow the LP64D calling convention of RV64GC toolchains.
+  static constexpr uint32_t flags = EF_RISCV_FLOAT_ABI_DOUBLE;
+  static constexpr auto relocation_info(uint32_t symbol, uint32_t type) {
+    return ELF64_R_INFO(symbol, type);
+  }
+};
+
+/// Relocation type of the RISC-V psABI for the format of the instruction.
+inline auto elf_relocation_type(instruction_format format) -> uint32_t {
+  switch (format) {
+    case instruction_format::b:
+      return R_RISCV_BRANCH;
+    case instruction_format::j:
+      return R_RISCV_JAL;
+    default:
+      throw std::runtime_error(
+          "Unsupported instruction format for label relocation.");
+  }
+}
+
+/// Relocatable ELF object ('ET_REL') of one assembly unit.
+/// It consists of the sections '.text', '.data', '.rela.text', '.symtab',
+/// '.strtab' and '.shstrtab'. The constructor computes all tables and file
+/// offsets. The file is then written by 'writev' calls without any
+/// copies of the text and data section, which therefore have to outlive
+/// the object.
+///
+/// There are no visibility directives yet. Defined labels starting with
+/// '.L' are local symbols. All other labels are global symbols and labels
+/// that are not defined become undefined symbols to be resolved by the linker.
+template <elf_class c = elf_class::elf64>
+class elf_object {
+ public:
+  using types = elf_types<c>;
+
+  enum section_index : uint16_t {
+    null_section = 0,
+    text_section,
+    data_section,
+    rela_text_section,
+    symtab_section,
+    strtab_section,
+    shstrtab_section,
+    section_count
+  };
+
+  elf_object(const symbol_table& symbols,
+             const relocatable_code& code,
+             const riscv::data_section& data = {}) {
+    build_symbol_table(symbols);
+    build_relocations(code);
+    build_section_names();
+    build_layout(code, data);
+  }
+
+  // Segments point into the object itself.
+  elf_object(const elf_object&) = delete;
+  elf_object& operator=(const elf_object&) = delete;
+
+  /// Size of the whole file in bytes.
+  auto size() const noexcept -> size_t { return file_size; }
+
+  /// Consecutive pieces of the file including padding.
+  auto segments() const noexcept -> std::span<const iovec> { return iov; }
+
+  auto bytes() const -> std::vector<char> {
+    std::vector<char> result{};
+    result.reserve(file_size);
+    for (const auto& v : iov) {
+      const auto data = static_cast<const char*>(v.iov_base);
+      result.insert(result.end(), data, data + v.iov_len);
+    }
+    return result;
+  }
+
+  void write(int fd) const {
+    auto pieces = iov;
+    size_t i = 0;
+    while (i < pieces.size()) {
+      // One call must not get more than 'IOV_MAX' pieces.
+      const auto count = std::min(pieces.size() - i, size_t{IOV_MAX});
+      const auto n = ::writev(fd, pieces.data() + i, count);
+      if (n == -1) {
+        if (errno == EINTR) continue;
+        throw std::runtime_error("Failed to write ELF object.");
+      }
+      // Skip completely written pieces and continue partial writes.
+      auto written = size_t(n);
+      for (; (i < pieces.size()) && (written >= pieces[i].iov_len); ++i)
+        written -= pieces[i].iov_len;
+      if (written) {
+        pieces[i].iov_base = static_cast<char*>(pieces[i].iov_base) + written;
+        pieces[i].iov_len -= written;
+      }
+    }
+  }
+
+  void write(const std::filesystem::path& path) const {
+    const auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+      throw std::runtime_error("Failed to open file '" + path.string() +
+                               "' for writing.");
+    try {
+      write(fd);
+    } catch (...) {
+      ::close(fd);
+      throw;
+    }
+    if (::close(fd) == -1)
+      throw std::runtime_error("Failed to write file '" + path.string() +
+                               "'.");
+  }
+
+ private:
+  static constexpr auto align(size_t x, size_t a) noexcept -> size_t {
+    return (x + a - 1) & ~(a - 1);
+  }
+
+  auto add_string(std::string& table, std::string_view str) -> uint32_t {
+    const auto result = static_cast<uint32_t>(table.size());
+    table += str;
+    table += '\0';
+    return result;
+  }
+
+  void build_symbol_table(const symbol_table& symbols) {
+    constexpr auto invalid = symbol_table::label_data::invalid;
+    const auto& names = symbols.label_names;
+    strtab.assign(1, '\0');
+    symbol_indices.assign(symbols.labels.size(), 0);
+
+    // Null symbol and section symbol of '.text'.
+    table.push_back({});
+    typename types::symbol section_symbol{};
+    section_symbol.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    section_symbol.st_shndx = text_section;
+    table.push_back(section_symbol);
+
+    // Local symbols have to precede all global symbols.
+    const auto is_local = [&](size_t label) {
+      return (symbols.labels[label].address != invalid) &&
+             names[label].starts_with(".L");
+    };
+    for (int pass = 0; pass < 2; ++pass) {
+      if (pass) first_global = table.size();
+      for (size_t label = 0; label < symbols.labels.size(); ++label) {
+        if (is_local(label) != !pass) continue;
+        const auto address = symbols.labels[label].address;
+        typename types::symbol s{};
+        s.st_name = add_string(strtab, names[label]);
+        const auto data = symbols.labels[label].data;
+        s.st_info = ELF64_ST_INFO(pass ? STB_GLOBAL : STB_LOCAL,
+                                  data ? STT_OBJECT : STT_NOTYPE);
+        if (address != invalid) {
+          s.st_shndx = data ? data_section : text_section;
+          s.st_value = data ? address : address * instruction_size;
+        }
+        symbol_indices[label] = table.size();
+        table.push_back(s);
+      }
+    }
+  }
+
+  void build_relocations(const relocatable_code& code) {
+    relocations.reserve(code.relocations.size());
+    for (const auto& r : code.relocations) {
+      typename types::relocation x{};
+      x.r_offset = r.offset;
+      x.r_info = types::relocation_info(symbol_indices[r.label],
+                                        elf_relocation_type(r.format));
+      relocations.push_back(x);
+    }
+  }
+
+  void build_section_names() {
+    shstrtab.assign(1, '\0');
+    names[text_section] = add_string(shstrtab, ".text");
+    names[data_section] = add_string(shstrtab, ".data");
+    names[rela_text_section] = add_string(shstrtab, ".rela.text");
+    names[symtab_section] = add_string(shstrtab, ".symtab");
+    names[strtab_section] = add_string(shstrtab, ".strtab");
+    names[shstrtab_section] = add_string(shstrtab, ".shstrtab");
+  }
+
+  void add_piece(const void* data, size_t size) {
+    iov.push_back({const_cast<void*>(data), size});
+    file_size += size;
+  }
+
+  void pad_to(size_t alignment) {
+    static constexpr std::array<char, 8> zeros{};
+    const auto size = align(file_size, alignment) - file_size;
+    if (size) add_piece(zeros.data(), size);
+  }
+
+  void add_section(section_index i,
+                   uint32_t type,
+                   std::span<const iovec> pieces,
+                   size_t alignment,
+                   size_t entry_size = 0) {
+    pad_to(alignment);
+    auto& h = sections[i];
+    h.sh_name = names[i];
+    h.sh_type = type;
+    h.sh_offset = file_size;
+    h.sh_addralign = alignment;
+    h.sh_entsize = entry_size;
+    for (const auto& piece : pieces) add_piece(piece.iov_base, piece.iov_len);
+    h.sh_size = file_size - h.sh_offset;
+  }
+
+  void add_section(section_index i,
+                   uint32_t type,
+                   const void* data,
+                   size_t size,
+                   size_t alignment,
+                   size_t entry_size = 0) {
+    const iovec piece{const_cast<void*>(data), size};
+    add_section(i, type, std::span{&piece, 1}, alignment, entry_size);
+  }
+
+  void build_layout(const relocatable_code& code,
+                    const riscv::data_section& data) {
+    constexpr auto a = types::alignment;
+    add_piece(&header, sizeof(header));
+    add_section(text_section, SHT_PROGBITS, code.text.data(),
+                code.text.size() * sizeof(code.text[0]), instruction_size);
+    add_section(data_section, SHT_PROGBITS, data.segments(), 8);
+    add_section(rela_text_section, SHT_RELA, relocations.data(),
+                relocations.size() * sizeof(relocations[0]), a,
+                sizeof(relocations[0]));
+    add_section(symtab_section, SHT_SYMTAB, table.data(),
+                table.size() * sizeof(table[0]), a, sizeof(table[0]));
+    add_section(strtab_section, SHT_STRTAB, strtab.data(), strtab.size(), 1);
+    add_section(shstrtab_section, SHT_STRTAB, shstrtab.data(),
+                shstrtab.size(), 1);
+
+    sections[text_section].sh_flags = SHF_ALLOC | SHF_EXECINSTR;
+    sections[data_section].sh_flags = SHF_ALLOC | SHF_WRITE;
+    sections[rela_text_section].sh_flags = SHF_INFO_LINK;
+    sections[rela_text_section].sh_link = symtab_section;
+    sections[rela_text_section].sh_info = text_section;
+    sections[symtab_section].sh_link = strtab_section;
+    sections[symtab_section].sh_info = first_global;
+
+    pad_to(a);
+    const auto section_offset = file_size;
+    add_piece(sections.data(), sizeof(sections));
+
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = uint8_t(c);
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_REL;
+    header.e_machine = EM_RISCV;
+    header.e_version = EV_CURRENT;
+    header.e_flags = types::flags;
+    header.e_shoff = section_offset;
+    header.e_ehsize = sizeof(header);
+    header.e_shentsize = sizeof(sections[0]);
+    header.e_shnum = section_count;
+    header.e_shstrndx = shstrtab_section;
+  }
+
+  typename types::header header{};
+  std::array<typename types::section_header, section_count> sections{};
+  std::array<uint32_t, section_count> names{};
+  std::vector<typename types::symbol> table{};
+  std::vector<typename types::relocation> relocations{};
+  std::vector<uint32_t> symbol_indices{};
+  std::string strtab{};
+  std::string shstrtab{};
+  size_t first_global = 0;
+  std::vector<iovec> iov{};
+  size_t file_size = 0;
+};
+
+}  // namespace lyrahgames::riscv
@@ -0,0 +1,616 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+//
+#include <lyrahgames/riscv/assembler/program.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Machine code of a text section. Every instruction is one 32-bit word.
+/// Hence, the address of an instruction in bytes is four times its index.
+using machine_code = std::vector<uint32_t>;
+
+constexpr size_t instruction_size = 4;
+
+/// Unpacked bit fields of one instruction.
+/// The immediate is stored unshifted and is scattered by the format.
+struct instruction_fields {
+  uint32_t opcode = 0;
+  uint32_t rd = 0;
+  uint32_t funct3 = 0;
+  uint32_t rs1 = 0;
+  uint32_t rs2 = 0;
+  uint32_t funct7 = 0;
+  immediate imm = 0;
+  uint32_t rs3 = 0;
+};
+
+/// Returns the given bits [first, last) of 'x' shifted to position 'pos'.
+constexpr auto bits(uint64_t x, size_t first, size_t last, size_t pos)
+    -> uint32_t {
+  return ((x >> first) & ((uint64_t{1} << (last - first)) - 1)) << pos;
+}
+
+constexpr bool fits_signed(immediate x, size_t bit_count) {
+  const auto limit = immediate{1} << (bit_count - 1);
+  return (-limit <= x) && (x < limit);
+}
+
+/// Packs the bit fields of an instruction of the given format.
+/// Every format is a separate specialization such that the bit
+/// scattering is a fixed sequence of shifts and masks.
+template <instruction_format format>
+constexpr auto pack(const instruction_fields& f) -> uint32_t;
+
+template <>
+constexpr auto pack<instruction_format::r>(const instruction_fields& f)
+    -> uint32_t {
+  return f.opcode | (f.rd << 7) | (f.funct3 << 12) | (f.rs1 << 15) |
+         (f.rs2 << 20) | (f.funct7 << 25);
+}
+
+template <>
+constexpr auto pack<instruction_format::i>(const instruction_fields& f)
+    -> uint32_t {
+  if (!fits_signed(f.imm, 12))
+    throw std::runtime_error("Immediate " + std::to_string(f.imm) +
+                             " does not fit into 12 bits.");
+  return f.opcode | (f.rd << 7) | (f.funct3 << 12) | (f.rs1 << 15) |
+         bits(f.imm, 0, 12, 20);
+}
+
+template <>
+constexpr auto pack<instruction_format::s>(const instruction_fields& f)
+    -> uint32_t {
+  if (!fits_signed(f.imm, 12))
+    throw std::runtime_error("Offset " + std::to_string(f.imm) +
+                             " does not fit into 12 bits.");
+  return f.opcode | bits(f.imm, 0, 5, 7) | (f.funct3 << 12) | (f.rs1 << 15) |
+         (f.rs2 << 20) | bits(f.imm, 5, 12, 25);
+}
+
+template <>
+constexpr auto pack<instruction_format::b>(const instruction_fields& f)
+    -> uint32_t {
+  if (!fits_signed(f.imm, 13) || (f.imm & 1))
+    throw std::runtime_error("Branch offset " + std::to_string(f.imm) +
+                             " is out of range.");
+  return f.opcode | bits(f.imm, 11, 12, 7) | bits(f.imm, 1, 5, 8) |
+         (f.funct3 << 12) | (f.rs1 << 15) | (f.rs2 << 20) |
+         bits(f.imm, 5, 11, 25) | bits(f.imm, 12, 13, 31);
+}
+
+template <>
+constexpr auto pack<instruction_format::u>(const instruction_fields& f)
+    -> uint32_t {
+  // The immediate is given as the upper 20 bits like in 'lui a0, 0x12345'.
+  if ((f.imm < -(immediate{1} << 19)) || (f.imm >= (immediate{1} << 20)))
+    throw std::runtime_error("Upper immediate " + std::to_string(f.imm) +
+                             " does not fit into 20 bits.");
+  return f.opcode | (f.rd << 7) | bits(f.imm, 0, 20, 12);
+}
+
+template <>
+constexpr auto pack<instruction_format::j>(const instruction_fields& f)
+    -> uint32_t {
+  if (!fits_signed(f.imm, 21) || (f.imm & 1))
+    throw std::runtime_error("Jump offset " + std::to_string(f.imm) +
+                             " is out of range.");
+  return f.opcode | (f.rd << 7) | bits(f.imm, 12, 20, 12) |
+         bits(f.imm, 11, 12, 20) | bits(f.imm, 1, 11, 21) |
+         bits(f.imm, 20, 21, 31);
+}
+
+template <>
+constexpr auto pack<instruction_format::r4>(const instruction_fields& f)
+    -> uint32_t {
+  return f.opcode | (f.rd << 7) | (f.funct3 << 12) | (f.rs1 << 15) |
+         (f.rs2 << 20) | (f.funct7 << 25) | (f.rs3 << 27);
+}
+
+template <>
+constexpr auto pack<instruction_format::sh>(const instruction_fields& f)
+    -> uint32_t {
+  if ((f.imm < 0) || (f.imm >= 64))
+    throw std::runtime_error("Shift amount " + std::to_string(f.imm) +
+                             " does not fit into 6 bits.");
+  return f.opcode | (f.rd << 7) | (f.funct3 << 12) | (f.rs1 << 15) |
+         bits(f.imm, 0, 6, 20) | (f.funct7 << 25);
+}
+
+template <>
+constexpr auto pack<instruction_format::shw>(const instruction_fields& f)
+    -> uint32_t {
+  if ((f.imm < 0) || (f.imm >= 32))
+    throw std::runtime_error("Shift amount " + std::to_string(f.imm) +
+                             " does not fit into 5 bits.");
+  return f.opcode | (f.rd << 7) | (f.funct3 << 12) | (f.rs1 << 15) |
+         bits(f.imm, 0, 5, 20) | (f.funct7 << 25);
+}
+
+template <>
+constexpr auto pack<instruction_format::csr>(const instruction_fields& f)
+    -> uint32_t {
+  if ((f.imm < 0) || (f.imm >= 4096))
+    throw std::runtime_error("CSR number " + std::to_string(f.imm) +
+                             " does not fit into 12 bits.");
+  return f.opcode | (f.rd << 7) | (f.funct3 << 12) | (f.rs1 << 15) |
+         bits(f.imm, 0, 12, 20);
+}
+
+/// Packing function for every format indexed by 'instruction_format'.
+inline constexpr std::array format_packers{
+    pack<instruction_format::r>,   pack<instruction_format::i>,
+    pack<instruction_format::s>,   pack<instruction_format::b>,
+    pack<instruction_format::u>,   pack<instruction_format::j>,
+    pack<instruction_format::r4>,  pack<instruction_format::sh>,
+    pack<instruction_format::shw>, pack<instruction_format::csr>,
+};
+
+static_assert(format_packers.size() == instruction_format_count);
+
+/// Assigns the operands of an instruction to its bit fields.
+/// Labels are resolved to byte offsets relative to the instruction at 'pc',
+/// given as instruction index. Undefined labels and labels of data are an
+/// error unless 'unresolved_label' is given. Then, it receives the label and
+/// the immediate is left zero to be patched later on.
+inline auto instruction_fields_of(instruction_view instr,
+                                  size_t pc,
+                                  const symbol_table& symbols,
+                                  size_t* unresolved_label = nullptr)
+    -> instruction_fields {
+  const auto& data = symbols.instructions[instr.id];
+  const auto& e = data.encoding;
+  instruction_fields result{e.opcode, e.rd,     e.funct3, e.rs1,
+                            e.rs2,    e.funct7, e.imm,    e.rs3};
+  struct {
+    void assign(uint32_t code) {
+      using enum instruction_field;
+      if (fields & field_bit(rd)) result.rd = code;
+      if (fields & field_bit(rs1)) result.rs1 = code;
+      if (fields & field_bit(rs2)) result.rs2 = code;
+      if (fields & field_bit(rs3)) result.rs3 = code;
+    }
+    bool has_imm() const {
+      return fields & field_bit(instruction_field::imm);
+    }
+    void operator()(int_register r) { assign(r.code); }
+    void operator()(float_register r) { assign(r.code); }
+    void operator()(immediate n) {
+      if (has_imm()) {
+        result.imm = n;
+        return;
+      }
+      // Literals in register fields, like the 'zimm' of 'csrrwi'.
+      if ((n < 0) || (n >= 32))
+        throw std::runtime_error("Immediate " + std::to_string(n) +
+                                 " does not fit into 5 bits.");
+      assign(n);
+    }
+    void operator()(memory_address m) {
+      assign(m.base.code);
+      if (has_imm())
+        result.imm = m.offset;
+      else if (m.offset)
+        throw std::runtime_error("Memory address with offset " +
+                                 std::to_string(m.offset) +
+                                 " is not allowed.");
+    }
+    void operator()(size_t label) {
+      const auto [address, data] = symbols.labels[label];
+      // Labels of data are in another section and left to the linker.
+      if (data || (address == symbol_table::label_data::invalid)) {
+        if (!unresolved_label)
+          throw std::runtime_error(
+              (data ? "Label of data '" : "Undefined label '") +
+              std::string(symbols.label_names[label]) + "'.");
+        *unresolved_label = label;
+        return;
+      }
+      result.imm = (immediate(address) - immediate(pc)) *
+                   immediate(instruction_size);
+    }
+    instruction_fields& result;
+    size_t pc;
+    const symbol_table& symbols;
+    size_t* unresolved_label;
+    field_set fields = 0;
+  } visitor{result, pc, symbols, unresolved_label};
+
+  for (size_t i = 0; i < instr.operands.size(); ++i) {
+    visitor.fields = data.operands[i].fields;
+    std::visit(visitor, instr.operands[i]);
+  }
+  return result;
+}
+
+/// Scatters the fields of an instruction of the C extension into its
+/// 16-bit layout. Bits of the fields that are not part of the layout are
+/// dropped. Use 'compress' to encode with range checks.
+constexpr auto pack(const compressed_layout& layout,
+                    const instruction_fields& f) -> uint16_t {
+  uint16_t result = 0;
+  for (size_t i = 0; i < layout.bits.size(); ++i) {
+    const auto [source, index] = layout.bits[i];
+    uint64_t x = 0;
+    switch (source) {
+      case parcel_source::zero:
+        break;
+      case parcel_source::one:
+        x = 1;
+        break;
+      case parcel_source::imm:
+        x = uint64_t(f.imm) >> index;
+        break;
+      case parcel_source::rd:
+      case parcel_source::rd_c:
+        x = f.rd >> index;
+        break;
+      case parcel_source::rs1:
+      case parcel_source::rs1_c:
+        x = f.rs1 >> index;
+        break;
+      case parcel_source::rs2:
+      case parcel_source::rs2_c:
+        x = f.rs2 >> index;
+        break;
+    }
+    result |= (x & 1) << i;
+  }
+  return result;
+}
+
+/// Gathers the fields of the layout from a 16-bit instruction into 'f'.
+/// Other fields of 'f' are left unchanged. Compact registers are mapped
+/// to x8 to x15 and signed immediates are sign-extended.
+constexpr void unpack(const compressed_layout& layout,
+                      uint16_t parcel,
+                      instruction_fields& f) {
+  // Compact register fields are stored without their offset of eight.
+  std::array<uint32_t, 3> registers{};
+  std::array<bool, 3> present{};
+  std::array<bool, 3> compact{};
+  uint64_t imm = 0;
+  for (size_t i = 0; i < layout.bits.size(); ++i) {
+    const auto [source, index] = layout.bits[i];
+    const uint64_t x = (parcel >> i) & 1;
+    if (source == parcel_source::imm) {
+      imm |= x << index;
+      continue;
+    }
+    if (source < parcel_source::rd) continue;
+    const auto k = (size_t(source) - size_t(parcel_source::rd)) % 3;
+    registers[k] |= x << index;
+    present[k] = true;
+    compact[k] = (source >= parcel_source::rd_c);
+  }
+  for (size_t k = 0; k < 3; ++k)
+    if (present[k] && compact[k]) registers[k] += 8;
+  if (present[0]) f.rd = registers[0];
+  if (present[1]) f.rs1 = registers[1];
+  if (present[2]) f.rs2 = registers[2];
+  if (layout.contains(instruction_field::imm)) {
+    const auto shift = 64 - layout.imm_width;
+    f.imm = layout.signed_imm ? (immediate(imm << shift) >> shift)
+                              : immediate(imm);
+  }
+}
+
+/// Two-level decoding table of all instructions of the C extension.
+/// Every instruction fixes its quadrant in bits [0, 2) and 'funct3' in bits
+/// [13, 16). Both select the range of candidates that is sorted by the
+/// number of fixed bits. Hence, reserved cases and special registers, like
+/// 'c.addi16sp' in place of 'c.lui sp', are matched first.
+struct compressed_decoding_table {
+  struct pattern {
+    uint16_t mask;
+    uint16_t value;
+    uint16_t id;
+  };
+
+  struct range {
+    uint16_t first = 0;
+    uint16_t last = 0;
+  };
+
+  static constexpr size_t none = -1;
+
+  static constexpr size_t pattern_count = [] {
+    size_t result = 0;
+    for (const auto& data : instruction_table) result += bool(data.compressed);
+    return result;
+  }();
+
+  static constexpr auto slot_of(uint16_t parcel) noexcept -> size_t {
+    return ((parcel >> 13) << 2) | (parcel & 0b11);
+  }
+
+  constexpr compressed_decoding_table() {
+    std::array<pattern, pattern_count> sorted{};
+    size_t k = 0;
+    for (size_t id = 0; id < std::size(instruction_table); ++id) {
+      const auto& layout = instruction_table[id].compressed;
+      if (!layout) continue;
+      sorted[k++] = {layout.mask(), layout.value(), uint16_t(id)};
+    }
+    std::ranges::sort(sorted, [](const auto& x, const auto& y) {
+      const auto p = std::popcount(x.mask);
+      const auto q = std::popcount(y.mask);
+      return (p != q) ? (p > q) : (x.id < y.id);
+    });
+    k = 0;
+    for (size_t slot = 0; slot < slots.size(); ++slot) {
+      slots[slot].first = k;
+      for (const auto& p : sorted)
+        if (slot_of(p.value) == slot) patterns[k++] = p;
+      slots[slot].last = k;
+    }
+  }
+
+  /// Returns the id of the instruction or 'none' if the parcel encodes no
+  /// instruction of the C extension.
+  constexpr auto find(uint16_t parcel) const noexcept -> size_t {
+    const auto [first, last] = slots[slot_of(parcel)];
+    for (auto i = first; i < last; ++i)
+      if ((parcel & patterns[i].mask) == patterns[i].value)
+        return patterns[i].id;
+    return none;
+  }
+
+  std::array<range, 32> slots{};
+  std::array<pattern, pattern_count> patterns{};
+};
+
+inline constexpr compressed_decoding_table instruction_compressed_table{};
+
+/// Returns the 16-bit encoding of an instruction of the C extension with
+/// the given fields of its 32-bit expansion. Throws if the fields cannot be
+/// represented, like registers outside of x8 to x15 in compact register
+/// fields, immediates out of range, or fields that would turn the parcel
+/// into another instruction, like 'c.mv' with 'zero' as source.
+inline auto compress(size_t id, instruction_fields f) -> uint16_t {
+  using enum instruction_field;
+  const auto& data = instruction_table[id];
+  // Upper immediates may be given unsigned like in 'c.lui a0, 0xfffe1'.
+  if ((data.encoding.format == instruction_format::u) &&
+      (f.imm >= (immediate{1} << 19)))
+    f.imm -= immediate{1} << 20;
+  const auto& layout = data.compressed;
+  const auto fail = [&] {
+    throw std::runtime_error("Operands of '" +
+                             std::string(instruction_names[id]) +
+                             "' do not fit into 16 bits.");
+  };
+  if (!layout) fail();
+
+  // Register operands that are not part of the layout are implied.
+  const std::array<uint32_t, 4> values{f.rd, f.rs1, f.rs2, f.rs3};
+  const std::array<uint32_t, 4> fixed{data.encoding.rd, data.encoding.rs1,
+                                      data.encoding.rs2, data.encoding.rs3};
+  for (const auto& operand : data.operands) {
+    bool stored = false;
+    for (size_t k = 0; k < 3; ++k)
+      if (operand.fields & field_bit(instruction_field(k)))
+        stored = stored || layout.contains(instruction_field(k));
+    if (stored) continue;
+    for (size_t k = 0; k < 4; ++k)
+      if ((operand.fields & field_bit(instruction_field(k))) &&
+          (values[k] != fixed[k]))
+        fail();
+  }
+
+  const auto parcel = pack(layout, f);
+  instruction_fields check = f;
+  unpack(layout, parcel, check);
+  if ((check.rd != f.rd) || (check.rs1 != f.rs1) || (check.rs2 != f.rs2) ||
+      (check.imm != f.imm) || (layout.nonzero_imm && !f.imm))
+    fail();
+  if (instruction_compressed_table.find(parcel) != id) fail();
+  return parcel;
+}
+
+/// Returns the 16-bit encoding of an instruction of the C extension that
+/// is located at instruction index 'pc'.
+inline auto compress(instruction_view instr,
+                     size_t pc,
+                     const symbol_table& symbols) -> uint16_t {
+  return compress(instr.id, instruction_fields_of(instr, pc, symbols));
+}
+
+/// Packs the fields of the given overload into its 32-bit word.
+/// Every instruction occupies one word of the text section. Hence,
+/// instructions of the C extension are checked to be representable in 16
+/// bits but emitted as their 32-bit expansion.
+inline auto encode_word(size_t id, const instruction_fields& f) -> uint32_t {
+  const auto& data = instruction_table[id];
+  if (data.compressed) compress(id, f);
+  return format_packers[size_t(data.encoding.format)](f);
+}
+
+/// Encodes a single instruction located at instruction index 'pc'.
+inline auto encode(instruction_view instr,
+                   size_t pc,
+                   const symbol_table& symbols) -> uint32_t {
+  return encode_word(instr.id, instruction_fields_of(instr, pc, symbols));
+}
+
+/// Encodes all instructions of a program into its text section.
+inline auto encode(const program& prog) -> machine_code {
+  machine_code result(prog.instructions.size());
+  for (size_t pc = 0; pc < prog.instructions.size(); ++pc)
+    result[pc] = encode(prog.instructions[pc], pc, prog.symbols);
+  return result;
+}
+
+/// Reference to a label that is not defined in the same unit.
+/// The offset is given in bytes relative to the start of the text section.
+/// The format of the instruction determines the kind of relocation.
+struct relocation {
+  friend constexpr bool operator==(const relocation&,
+                                   const relocation&) noexcept = default;
+
+  size_t offset;
+  label_id label;
+  instruction_format format;
+};
+
+/// Text section with zero immediates for all references to undefined
+/// labels and the relocations that have to be applied by the linker.
+struct relocatable_code {
+  machine_code text{};
+  std::vector<relocation> relocations{};
+};
+
+/// Encodes all instructions of a program and keeps references to
+/// undefined labels and labels of data as relocations instead of
+/// reporting an error.
+inline auto encode_relocatable(const program& prog) -> relocatable_code {
+  relocatable_code result{};
+  result.text.resize(prog.instructions.size());
+  for (size_t pc = 0; pc < prog.instructions.size(); ++pc) {
+    const auto instr = prog.instructions[pc];
+    const auto format = prog.symbols.instructions[instr.id].encoding.format;
+    label_id label = -1;
+    result.text[pc] = encode_word(
+        instr.id, instruction_fields_of(instr, pc, prog.symbols, &label));
+    if (label != label_id(-1))
+      result.relocations.push_back({pc * instruction_size, label, format});
+  }
+  return result;
+}
+
+/// Encoder that emits machine code in the same pass as the parser.
+/// It is used as sink of 'parser::parse'. References to labels that are
+/// not yet defined are encoded with a zero offset and recorded in a per-label
+/// list of patch sites. The sites are patched in place as soon as the label
+/// gets defined. Instructions are never stored.
+struct single_pass_encoder {
+  static constexpr size_t none = -1;
+
+  struct fixup {
+    size_t pc;
+    size_t next;
+    // Overload of the instruction to check and patch.
+    size_t id;
+  };
+
+  /// Patch lists are allocated from the given resource.
+  /// The returned machine code always uses the default allocator.
+  single_pass_encoder(
+      symbol_table& s,
+      std::pmr::memory_resource* r = std::pmr::get_default_resource())
+      : symbols{s}, fixups{r}, pending{r} {}
+
+  void define_label(size_t label) {
+    auto& address = symbols.labels[label].address;
+    if (address != symbol_table::label_data::invalid)
+      throw std::runtime_error("Redefinition of label '" +
+                               std::string(symbols.label_names[label]) +
+                               "'.");
+    address = code.size();
+    if (label >= pending.size()) return;
+
+    // Patch all sites and move their nodes to the free list.
+    auto i = std::exchange(pending[label], none);
+    while (i != none) {
+      auto& f = fixups[i];
+      const auto offset = (immediate(address) - immediate(f.pc)) *
+                          immediate(instruction_size);
+      if (instruction_table[f.id].compressed)
+        check_compressed(f.id, code[f.pc], offset);
+      code[f.pc] |= format_packers[size_t(format_of(f.id))]({.imm = offset});
+      --pending_count;
+      const auto next = f.next;
+      f.next = free_fixups;
+      free_fixups = i;
+      i = next;
+    }
+  }
+
+  void emit(instruction_view instr) {
+    const auto pc = code.size();
+    size_t label = none;
+    code.push_back(encode_word(
+        instr.id, instruction_fields_of(instr, pc, symbols, &label)));
+    if (label != none) add_fixup(label, pc, instr.id);
+  }
+
+  /// Checks that no reference to an undefined label or a label of data
+  /// remains and returns the text section.
+  auto finish() -> machine_code& {
+    if (pending_count)
+      for (size_t label = 0; label < pending.size(); ++label)
+        if (pending[label] != none)
+          throw std::runtime_error(
+              (symbols.labels[label].data ? "Label of data '"
+                                          : "Undefined label '") +
+              std::string(symbols.label_names[label]) + "'.");
+    return code;
+  }
+
+  /// Turns all references to undefined labels and labels of data into
+  /// relocations and moves the text section into the result.
+  auto finish_relocatable() -> relocatable_code {
+    relocatable_code result{};
+    result.relocations.reserve(pending_count);
+    for (size_t label = 0; label < pending.size(); ++label)
+      for (auto i = pending[label]; i != none; i = fixups[i].next)
+        result.relocations.push_back(
+            {fixups[i].pc * instruction_size, label,
+             format_of(fixups[i].id)});
+    std::ranges::sort(result.relocations, {}, &relocation::offset);
+    result.text = std::move(code);
+    return result;
+  }
+
+  symbol_table& symbols;
+  machine_code code{};
+
+ private:
+  static auto format_of(size_t id) noexcept -> instruction_format {
+    return instruction_table[id].encoding.format;
+  }
+
+  /// Compressed instructions have only been checked with a zero offset.
+  /// Their register fields are still in the word because labels are only
+  /// referenced by the 'B' and 'J' formats.
+  static void check_compressed(size_t id, uint32_t word, immediate offset) {
+    instruction_fields f{.imm = offset};
+    if (format_of(id) == instruction_format::j) {
+      f.rd = (word >> 7) & 0x1f;
+    } else {
+      f.rs1 = (word >> 15) & 0x1f;
+      f.rs2 = (word >> 20) & 0x1f;
+    }
+    compress(id, f);
+  }
+
+  void add_fixup(size_t label, size_t pc, size_t id) {
+    if (label >= pending.size()) pending.resize(label + 1, none);
+    auto i = free_fixups;
+    if (i != none) {
+      free_fixups = fixups[i].next;
+      fixups[i] = {pc, pending[label], id};
+    } else {
+      i = fixups.size();
+      fixups.push_back({pc, pending[label], id});
+    }
+    pending[label] = i;
+    ++pending_count;
+  }
+
+  std::pmr::vector<fixup> fixups;
+  std::pmr::vector<size_t> pending;
+  size_t free_fixups = none;
+  size_t pending_count = 0;
+};
+
+}  // namespace lyrahgames::riscv
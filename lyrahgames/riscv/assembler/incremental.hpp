@@ -0,0 +1,307 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/parallel_parser.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+#include <lyrahgames/riscv/assembler/program.hpp>
+#include <lyrahgames/riscv/assembler/string_pool.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Assembler for a source that is assembled again after every edit, like
+/// the buffer of an editor. It keeps the lines, the program and the text
+/// section of the previous source. Lines in front of the first and behind
+/// the last changed byte are reused. Changed lines are looked up in a cache
+/// that maps the content of every line seen so far to its label definition
+/// and instruction. Only lines that are not in the cache are lexed and
+/// parsed. Afterwards, labels behind the change are shifted and only
+/// changed instructions and instructions whose distance to their target
+/// has changed are encoded again. The result equals 'encode' of the whole
+/// source if every label is defined at most once. Lines are split like in
+/// 'split_lines' and therefore never separate a multiline comment. Data
+/// directives are not supported. Cached lines that are no longer part of
+/// the source are dropped as soon as they outnumber the lines of the
+/// source. Hence, the cache does not grow during long editing sessions.
+class incremental_assembler {
+ public:
+  /// Work done by the last call to 'assemble'.
+  struct statistics {
+    size_t lines = 0;
+    size_t reused_lines = 0;
+    size_t cached_lines = 0;
+    size_t parsed_lines = 0;
+    size_t encoded_instructions = 0;
+  };
+
+  /// Assembles the given source and returns its text section.
+  /// If an error occurs, all state is dropped and the exception is rethrown.
+  /// The next call then assembles the whole source again.
+  auto assemble(std::string_view source) -> const machine_code& {
+    try {
+      update(source.substr(0, source.find('\0')));
+    } catch (...) {
+      clear();
+      throw;
+    }
+    return text;
+  }
+
+  /// Drops the previous source and the cache of line results.
+  void clear() {
+    previous.clear();
+    lines.clear();
+    line_texts.clear();
+    results.clear();
+    result = program{};
+    text.clear();
+  }
+
+  /// Number of distinct lines whose results are cached.
+  auto cache_size() const noexcept { return line_texts.size(); }
+
+  auto code() const noexcept -> const machine_code& { return text; }
+  auto prog() const noexcept -> const program& { return result; }
+
+  statistics stats{};
+
+ private:
+  using label_data = symbol_table::label_data;
+
+  static constexpr size_t none = -1;
+  static constexpr size_t min_cache_size = 256;
+
+  /// Label definition and instruction of one line.
+  /// Both only depend on the content of the line because labels are
+  /// interned by name into the symbol table that is kept across calls.
+  struct line_result {
+    size_t label = none;
+    bool has_instruction = false;
+    instruction instr{0};
+  };
+
+  struct line {
+    size_t offset;
+    size_t instruction;
+    symbol content;
+  };
+
+  /// Returns the result of the given line and parses it if its content has
+  /// not been seen before.
+  auto line_result_of(std::string_view str) -> symbol {
+    const auto hash = string_hash(str);
+    if (const auto s = line_texts.find(str, hash)) {
+      ++stats.cached_lines;
+      return *s;
+    }
+
+    line_result r{};
+    buffer_lexer lexer{str};
+    parser parser{lexer};
+    callback_sink sink{[&r](size_t label) { r.label = label; },
+                       [&r](instruction_view instr) {
+                         r.instr.id = instr.id;
+                         for (const auto& op : instr.operands)
+                           r.instr.operands.push_back(op);
+                         r.has_instruction = true;
+                       }};
+    parser.parse(result, sink);
+    ++stats.parsed_lines;
+    // Lines are only cached with their label and instruction.
+    if (!result.data.empty())
+      throw std::runtime_error(
+          "Data directives are not supported by incremental assembly.");
+
+    const auto [s, inserted] = line_texts.insert(str, hash);
+    results.push_back(r);
+    return s;
+  }
+
+  void update(std::string_view source) {
+    stats = {};
+    const std::string_view old = previous;
+    auto& labels = result.symbols.labels;
+    const auto line_begin = [&](size_t i) {
+      return (i < lines.size()) ? lines[i].offset : old.size();
+    };
+    const auto instruction_begin = [&](size_t i) {
+      return (i < lines.size()) ? lines[i].instruction
+                                : result.instructions.size();
+    };
+
+    // Bytes in front of the first and behind the last change.
+    const auto n = std::min(old.size(), source.size());
+    const auto prefix = size_t(
+        std::mismatch(old.begin(), old.begin() + n, source.begin()).first -
+        old.begin());
+    const auto suffix =
+        size_t(std::mismatch(old.rbegin(), old.rbegin() + (n - prefix),
+                             source.rbegin())
+                   .first -
+               old.rbegin());
+
+    // Unchanged lines in front end with a newline before the first change.
+    const auto indices = std::views::iota(size_t{0}, lines.size());
+    auto first = *std::ranges::partition_point(
+        indices, [&](size_t i) { return line_begin(i + 1) <= prefix; });
+    if (first && (old[line_begin(first) - 1] != '\n')) --first;
+
+    // Unchanged lines at the back start behind the last change.
+    auto last = *std::ranges::partition_point(indices, [&](size_t i) {
+      return line_begin(i) < old.size() - suffix;
+    });
+    last = std::max(last, first);
+
+    // Split the changed part into lines until a split point reaches the
+    // start of an unchanged line. New multiline comments may swallow
+    // unchanged lines such that they have to be split again.
+    const auto shift = ptrdiff_t(source.size()) - ptrdiff_t(old.size());
+    std::vector<line> changed{};
+    const auto source_first = source.data();
+    const auto source_last = source_first + source.size();
+    auto position = source_first + line_begin(first);
+    auto next_instruction = instruction_begin(first);
+    while (true) {
+      const auto offset = size_t(position - source_first);
+      while ((last < lines.size()) &&
+             (ptrdiff_t(lines[last].offset) + shift < ptrdiff_t(offset)))
+        ++last;
+      if ((last < lines.size()) &&
+          (ptrdiff_t(lines[last].offset) + shift == ptrdiff_t(offset)))
+        break;
+      if (position == source_last) break;
+
+      const auto split = next_split_point(position, position, source_last);
+      symbol content{};
+      try {
+        content = line_result_of({position, size_t(split - position)});
+      } catch (const std::exception& e) {
+        const auto line_number = std::count(source_first, position, '\n');
+        throw std::runtime_error("At line " + std::to_string(line_number) +
+                                 ": " + e.what());
+      }
+      changed.push_back({offset, next_instruction, content});
+      next_instruction += results[content].has_instruction;
+      position = split;
+    }
+
+    const auto old_first = instruction_begin(first);
+    const auto old_last = instruction_begin(last);
+    const auto new_last = next_instruction;
+    const auto delta = ptrdiff_t(new_last) - ptrdiff_t(old_last);
+
+    // Update label addresses and remember the previous ones.
+    std::vector<size_t> addresses(labels.size());
+    for (size_t i = 0; i < labels.size(); ++i)
+      addresses[i] = labels[i].address;
+    for (auto i = first; i < last; ++i) {
+      const auto label = results[lines[i].content].label;
+      if (label != none) labels[label].address = label_data::invalid;
+    }
+    for (const auto& l : changed) {
+      const auto label = results[l.content].label;
+      if (label != none) labels[label].address = l.instruction;
+    }
+    if (delta) {
+      for (auto i = last; i < lines.size(); ++i) {
+        const auto label = results[lines[i].content].label;
+        if (label != none) labels[label].address += delta;
+      }
+    }
+
+    // Instructions and lines of the new source.
+    instruction_list instructions{};
+    instructions.reserve(result.instructions.size() + delta);
+    for (size_t pc = 0; pc < old_first; ++pc)
+      instructions.push_back(result.instructions[pc]);
+    for (const auto& l : changed)
+      if (results[l.content].has_instruction)
+        instructions.push_back(results[l.content].instr);
+    for (auto pc = old_last; pc < result.instructions.size(); ++pc)
+      instructions.push_back(result.instructions[pc]);
+    result.instructions = std::move(instructions);
+
+    std::vector<line> updated{};
+    updated.reserve(first + changed.size() + lines.size() - last);
+    updated.insert(updated.end(), lines.begin(), lines.begin() + first);
+    updated.insert(updated.end(), changed.begin(), changed.end());
+    for (auto i = last; i < lines.size(); ++i)
+      updated.push_back({lines[i].offset + shift,
+                         lines[i].instruction + delta, lines[i].content});
+    stats.lines = updated.size();
+    stats.reused_lines = updated.size() - changed.size();
+    lines = std::move(updated);
+    previous.assign(source);
+    evict_unused_lines();
+
+    // Encode changed instructions.
+    text.erase(text.begin() + old_first, text.begin() + old_last);
+    text.insert(text.begin() + old_first, new_last - old_first, 0);
+    for (auto pc = old_first; pc < new_last; ++pc) encode_at(pc);
+
+    // Encode unchanged instructions whose target distance has changed.
+    bool moved = delta;
+    for (size_t i = 0; !moved && (i < addresses.size()); ++i)
+      moved = (addresses[i] != labels[i].address);
+    if (!moved) return;
+    for (size_t pc = 0; pc < text.size(); ++pc) {
+      if (pc == old_first) pc = new_last;
+      if (pc == text.size()) break;
+      const auto old_pc = ptrdiff_t(pc) - ((pc < old_first) ? 0 : delta);
+      for (const auto& op : result.instructions.operands(pc)) {
+        const auto label = std::get_if<label_id>(&op);
+        if (!label) continue;
+        const auto before = addresses[*label];
+        const auto after = labels[*label].address;
+        if ((before != label_data::invalid) &&
+            (after != label_data::invalid) &&
+            (ptrdiff_t(before) - old_pc == ptrdiff_t(after) - ptrdiff_t(pc)))
+          continue;
+        encode_at(pc);
+        break;
+      }
+    }
+  }
+
+  /// Rebuilds the cache with the lines of the current source only.
+  void evict_unused_lines() {
+    if (line_texts.size() <= 2 * lines.size() + min_cache_size) return;
+    constexpr auto unused = symbol(-1);
+    std::vector<symbol> symbols(line_texts.size(), unused);
+    string_pool texts{};
+    std::vector<line_result> kept{};
+    for (auto& l : lines) {
+      auto& s = symbols[l.content];
+      if (s == unused) {
+        s = texts.insert(line_texts[l.content], line_texts.hash(l.content))
+                .first;
+        kept.push_back(results[l.content]);
+      }
+      l.content = s;
+    }
+    line_texts = std::move(texts);
+    results = std::move(kept);
+  }
+
+  void encode_at(size_t pc) {
+    text[pc] = encode(result.instructions[pc], pc, result.symbols);
+    ++stats.encoded_instructions;
+  }
+
+  std::string previous{};
+  std::vector<line> lines{};
+  string_pool line_texts{};
+  std::vector<line_result> results{};
+  program result{};
+  machine_code text{};
+};
+
+}  // namespace lyrahgames::riscv
@@ -0,0 +1,186 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory_resource>
+#include <string_view>
+
+namespace lyrahgames::riscv {
+
+/// Memory resource that counts all allocations that are passed through to
+/// its upstream resource. Put it between an arena and the parser to see how
+/// often and how much the parsed program allocates.
+class counting_resource : public std::pmr::memory_resource {
+ public:
+  explicit counting_resource(
+      std::pmr::memory_resource* r = std::pmr::get_default_resource())
+      : upstream{r} {}
+
+  auto allocations() const noexcept { return allocation_count; }
+  auto deallocations() const noexcept { return deallocation_count; }
+  auto allocated_bytes() const noexcept { return byte_count; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++allocation_count;
+    byte_count += bytes;
+    return upstream->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    ++deallocation_count;
+    upstream->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream;
+  size_t allocation_count = 0;
+  size_t deallocation_count = 0;
+  size_t byte_count = 0;
+};
+
+/// Stages of the parser whose wall time is measured separately.
+/// Times are exclusive. For example, tokens that are pulled from the lexer
+/// while operands are matched count as lexing and not as operand matching.
+enum class parse_stage : uint8_t {
+  lexing,
+  operand_matching,
+  overload_resolution,
+  emission,
+  other,
+};
+
+inline constexpr std::string_view parse_stage_names[]{
+    "lexing", "operand_matching", "overload_resolution", "emission", "other",
+};
+
+/// Kinds of hash map lookups done by the parser.
+enum class parse_lookup : uint8_t {
+  mnemonic,
+  overload,
+  int_register,
+  float_register,
+  label,
+};
+
+inline constexpr std::string_view parse_lookup_names[]{
+    "mnemonic", "overload", "int_register", "float_register", "label",
+};
+
+/// Default instrumentation of the parser that records nothing.
+/// All members are empty and inlined such that the parser compiles
+/// to the same code as without any instrumentation.
+struct no_instrumentation {
+  static constexpr bool enabled = false;
+
+  struct timer {};
+
+  constexpr auto time(parse_stage) noexcept -> timer { return {}; }
+  constexpr void count_token() noexcept {}
+  constexpr void count_line() noexcept {}
+  constexpr void count_lookup(parse_lookup) noexcept {}
+  constexpr void count_failed_overload() noexcept {}
+  constexpr void start() noexcept {}
+  constexpr void finish() noexcept {}
+};
+
+/// Instrumentation of the parser that records wall times per stage and
+/// counts tokens, lines, hash map lookups and failed overload lookups for
+/// operand types that no overload of the mnemonic accepts. If 'memory' is
+/// set, its allocation counts are reported as well. At the end of
+/// 'parser::parse', all values are written as one JSON object to
+/// 'report' unless it is null.
+struct parse_statistics {
+  using clock = std::chrono::steady_clock;
+
+  static constexpr bool enabled = true;
+  static constexpr size_t stage_count = std::size(parse_stage_names);
+  static constexpr size_t lookup_count = std::size(parse_lookup_names);
+
+  /// Measures the time until its destruction and removes it from the
+  /// stage that was active before.
+  class timer {
+   public:
+    timer(parse_statistics& s, parse_stage stage)
+        : stats{s}, previous{s.current}, start{clock::now()} {
+      s.current = stage;
+    }
+
+    timer(const timer&) = delete;
+    timer& operator=(const timer&) = delete;
+
+    ~timer() {
+      const auto t = clock::now() - start;
+      stats.times[size_t(stats.current)] += t;
+      stats.times[size_t(previous)] -= t;
+      stats.current = previous;
+    }
+
+   private:
+    parse_statistics& stats;
+    parse_stage previous;
+    clock::time_point start;
+  };
+
+  auto time(parse_stage stage) -> timer { return {*this, stage}; }
+  void count_token() noexcept { ++tokens; }
+  void count_line() noexcept { ++lines; }
+  void count_lookup(parse_lookup l) noexcept { ++lookups[size_t(l)]; }
+  void count_failed_overload() noexcept { ++failed_overloads; }
+
+  void start() {
+    current = parse_stage::other;
+    start_time = clock::now();
+  }
+
+  void finish() {
+    const auto t = clock::now() - start_time;
+    times[size_t(parse_stage::other)] += t;
+    total += t;
+    if (report) *report << *this << '\n';
+  }
+
+  auto seconds(parse_stage stage) const noexcept {
+    return std::chrono::duration<double>(times[size_t(stage)]).count();
+  }
+
+  friend std::ostream& operator<<(std::ostream& os,
+                                  const parse_statistics& s) {
+    using std::chrono::duration;
+    os << "{\"seconds\":{\"total\":" << duration<double>(s.total).count();
+    for (size_t i = 0; i < stage_count; ++i)
+      os << ",\"" << parse_stage_names[i]
+         << "\":" << duration<double>(s.times[i]).count();
+    os << "},\"tokens\":" << s.tokens << ",\"lines\":" << s.lines
+       << ",\"lookups\":{";
+    for (size_t i = 0; i < lookup_count; ++i)
+      os << (i ? "," : "") << '"' << parse_lookup_names[i]
+         << "\":" << s.lookups[i];
+    os << "},\"failed_overloads\":" << s.failed_overloads;
+    if (s.memory)
+      os << ",\"allocations\":" << s.memory->allocations()
+         << ",\"allocated_bytes\":" << s.memory->allocated_bytes();
+    return os << '}';
+  }
+
+  std::ostream* report = &std::clog;
+  const counting_resource* memory = nullptr;
+
+  std::array<clock::duration, stage_count> times{};
+  clock::duration total{};
+  size_t tokens = 0;
+  size_t lines = 0;
+  std::array<size_t, lookup_count> lookups{};
+  size_t failed_overloads = 0;
+
+ private:
+  parse_stage current = parse_stage::other;
+  clock::time_point start_time{};
+};
+
+}  // namespace lyrahgames::riscv
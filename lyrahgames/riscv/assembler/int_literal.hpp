@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+//
+#include <lyrahgames/riscv/assembler/utility.hpp>
+
+// Parsing of integer literals with 64-bit range.
+// Digits are classified and converted eight at a time inside one 64-bit
+// word (SWAR). A run of up to eight digits costs one load, one range check
+// and three multiplications. Digit separators only end a run and are
+// skipped once per run instead of being tested for every character.
+
+namespace lyrahgames::riscv {
+
+namespace swar {
+
+constexpr uint64_t ones = 0x0101'0101'0101'0101u;
+constexpr uint64_t high_bits = 0x8080'8080'8080'8080u;
+
+/// Loads up to eight characters of [first, last) into one word such that
+/// the first character is the lowest byte. Missing characters are zero.
+constexpr auto load(czstring_iterator first, czstring_iterator last)
+    -> uint64_t {
+  const auto n = size_t(std::min<ptrdiff_t>(last - first, 8));
+  uint64_t x = 0;
+  if (std::is_constant_evaluated() ||
+      (std::endian::native != std::endian::little)) {
+    for (size_t i = 0; i < n; ++i)
+      x |= uint64_t(uint8_t(first[i])) << (8 * i);
+    return x;
+  }
+  std::memcpy(&x, first, n);
+  return x;
+}
+
+/// Sets the highest bit of every byte of 'x' that lies inside [lo, hi].
+/// Bytes with their highest bit set are never inside.
+constexpr auto in_range(uint64_t x, uint8_t lo, uint8_t hi) -> uint64_t {
+  const auto low = x & ~high_bits;
+  const auto at_least_lo = low + ones * (0x80 - lo);
+  const auto above_hi = low + ones * (0x7f - hi);
+  return at_least_lo & ~above_hi & ~x & high_bits;
+}
+
+/// Marks every byte of 'x' that is a digit of the given base.
+template <unsigned base>
+constexpr auto digits(uint64_t x) -> uint64_t {
+  if constexpr (base == 16)
+    return in_range(x, '0', '9') | in_range(x | (ones * 0x20), 'a', 'f');
+  else
+    return in_range(x, '0', '0' + base - 1);
+}
+
+/// Returns the number given by the eight digit characters in 'x'.
+/// The first character is the most significant digit.
+template <unsigned base>
+constexpr auto number(uint64_t x) -> uint64_t {
+  // Letters have their seventh bit set and start with 'a' & 0xf == 1.
+  auto v = (x & (ones * 0x0f)) + 9 * ((x >> 6) & ones);
+  v = (v * base + (v >> 8)) & 0x00ff'00ff'00ff'00ffu;
+  v = (v * (base * base) + (v >> 16)) & 0x0000'ffff'0000'ffffu;
+  v = (v * (base * base * base * base) + (v >> 32)) & 0xffff'ffffu;
+  return v;
+}
+
+/// Powers of the base for up to eight digits.
+template <unsigned base>
+constexpr auto powers = [] {
+  std::array<uint64_t, 9> result{1};
+  for (size_t i = 1; i < result.size(); ++i)
+    result[i] = result[i - 1] * base;
+  return result;
+}();
+
+}  // namespace swar
+
+/// Parses digits of the given base and digit separators into 'value' and
+/// advances 'it' behind them. Returns false if there are no digits or the
+/// last character is a separator. Values that do not fit into 64 bits
+/// throw an exception.
+template <unsigned base>
+constexpr bool parse_digits(czstring_iterator& it,
+                            czstring_iterator last,
+                            uint64_t& value) {
+  bool matched = false;
+  bool separated = false;
+  while (true) {
+    const auto x = swar::load(it, last);
+    const auto mask = swar::digits<base>(x);
+    // Number of leading digits in 'x'.
+    const auto n = size_t(std::countr_zero(~mask & swar::high_bits)) / 8;
+    if (n) {
+      const auto v = swar::number<base>(x << (8 * (8 - n)));
+      if (__builtin_mul_overflow(value, swar::powers<base>[n], &value) ||
+          __builtin_add_overflow(value, v, &value))
+        throw std::runtime_error(
+            "Failed to match integer literal out of 64-bit range.");
+      it += n;
+      matched = true;
+      separated = false;
+      if (n == 8) continue;
+    }
+    if ((it == last) || (*it != '\'')) break;
+    ++it;
+    separated = true;
+  }
+  return matched && !separated;
+}
+
+/// Parses an integer literal at the beginning of [it, last) and advances
+/// 'it' behind it. The caller has to check that the literal ends there.
+/// Literals consist of an optional sign, an optional base prefix '0x',
+/// '0o' or '0b' in any case, and digits that may be separated by '.
+/// Decimal literals have to be inside the range of 'immediate'. Literals
+/// with a prefix give the 64-bit two's complement representation and may
+/// therefore reach 2^64 - 1. Negated literals of any base may reach -2^63.
+/// Literals outside these ranges throw an exception. Returns nothing if
+/// there is no valid literal.
+constexpr auto parse_int_literal(czstring_iterator& it, czstring_iterator last)
+    -> std::optional<immediate> {
+  // Sign Extension
+  bool sign = false;
+  if ((it != last) && ((*it == '+') || (*it == '-'))) sign = (*it++ == '-');
+
+  // First Digit
+  if ((it == last) || (*it < '0') || ('9' < *it)) return {};
+
+  // Number Base Decision
+  unsigned base = 10;
+  if ((*it == '0') && (last - it > 1)) {
+    switch (it[1] | 0x20) {
+      case 'x':
+        base = 16;
+        break;
+      case 'o':
+        base = 8;
+        break;
+      case 'b':
+        base = 2;
+        break;
+    }
+    if (base != 10) it += 2;
+  }
+
+  uint64_t value = 0;
+  bool matched = false;
+  switch (base) {
+    case 2:
+      matched = parse_digits<2>(it, last, value);
+      break;
+    case 8:
+      matched = parse_digits<8>(it, last, value);
+      break;
+    case 16:
+      matched = parse_digits<16>(it, last, value);
+      break;
+    default:
+      matched = parse_digits<10>(it, last, value);
+  }
+  if (!matched) return {};
+  if (((base == 10) || sign) && (value > uint64_t(INT64_MAX) + sign))
+    throw std::runtime_error(
+        "Failed to match integer literal out of 64-bit range.");
+  return immediate(sign ? -value : value);
+}
+
+}  // namespace lyrahgames::riscv
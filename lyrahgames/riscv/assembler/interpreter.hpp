@@ -0,0 +1,469 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+//
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/jit.hpp>
+#include <lyrahgames/riscv/assembler/micro_op.hpp>
+#include <lyrahgames/riscv/assembler/program.hpp>
+
+// Use labels as values for direct-threaded dispatch if available.
+#if defined(__GNUC__)
+#define LYRAHGAMES_RISCV_COMPUTED_GOTO
+#endif
+
+namespace lyrahgames::riscv {
+
+/// Interpreter for the RV64I base integer instructions.
+/// Loads, stores, branches, jumps, 'lui', 'auipc' and all register and
+/// immediate operations of OP, OP-IMM, OP-32 and OP-IMM-32 are supported.
+/// 'fence', 'ecall', 'ebreak' and instructions of other extensions fail to
+/// be decoded. Compressed instructions run as their expansion.
+/// Instructions are lowered into micro-ops once when their basic block is
+/// executed for the first time. Blocks end at the first branch or jump and
+/// are cached by the index of their first instruction. Execution then
+/// jumps from handler to handler without looking at operand variants or
+/// overload ids. The program has to outlive the interpreter.
+///
+/// The guest memory is one flat zero-initialized array starting at address
+/// zero. The stack pointer starts at its end and the return address points
+/// to a halting instruction behind the program.
+///
+/// On x86-64 Linux, blocks that have been entered 'jit_threshold()' times
+/// are translated into native code by the 'jit_compiler'. Native code runs
+/// until it reaches a dynamic jump, a memory fault or a block that has not
+/// been translated. Only blocks consisting of 'add', 'addi', 'bne', 'ld',
+/// 'jal' and 'jalr' are translated. All other blocks are interpreted.
+/// Results and step counts are the same as without it.
+class interpreter {
+ public:
+  static constexpr size_t default_memory_size = size_t{1} << 20;
+  static constexpr uint32_t none = -1;
+  static constexpr uint32_t default_jit_threshold = 50;
+
+  struct block {
+    uint32_t pc;
+    uint32_t first;
+    uint32_t size;
+    // Number of entries or 'none' if translation has already been tried.
+    uint32_t count = 0;
+    const void* native = nullptr;
+  };
+
+  explicit interpreter(const program& p,
+                       size_t memory_size = default_memory_size)
+      : prog{p},
+        block_at(p.instructions.size() + 1, none),
+        guest_memory(memory_size) {
+    if (p.instructions.size() >= size_t(INT32_MAX))
+      throw std::runtime_error("Program is too large to be interpreted.");
+    reset();
+  }
+
+  interpreter(program&&, size_t = default_memory_size) = delete;
+
+  /// Resets all registers and starts execution at the given instruction.
+  /// Cached blocks stay valid.
+  void reset(size_t entry = 0) {
+    x.fill(0);
+    x[sp.code] = guest_memory.size() & ~uint64_t{15};
+    x[ra.code] = halt_address();
+    jump(entry);
+  }
+
+  void jump(size_t entry) {
+    if (entry > prog.instructions.size())
+      throw std::runtime_error("Entry point is out of range.");
+    pc = entry;
+  }
+
+  /// Address of the instruction that stops execution.
+  auto halt_address() const noexcept -> uint64_t {
+    return prog.instructions.size() * instruction_size;
+  }
+
+  bool halted() const noexcept { return pc == prog.instructions.size(); }
+
+  /// Index of the next instruction to be executed.
+  auto program_counter() const noexcept { return pc; }
+
+  auto registers() noexcept -> std::array<uint64_t, 32>& { return x; }
+  auto registers() const noexcept -> const std::array<uint64_t, 32>& {
+    return x;
+  }
+  auto operator[](int_register r) noexcept -> uint64_t& { return x[r.code]; }
+
+  auto memory() noexcept -> std::vector<uint8_t>& { return guest_memory; }
+  auto memory() const noexcept -> const std::vector<uint8_t>& {
+    return guest_memory;
+  }
+
+  auto blocks() const noexcept -> const std::vector<block>& {
+    return block_cache;
+  }
+
+  auto micro_ops() const noexcept -> const std::vector<micro_op>& {
+    return ops;
+  }
+
+  /// Number of entries after which a block is translated into native code.
+  /// Zero disables translation.
+  auto jit_threshold() const noexcept { return threshold; }
+  void set_jit_threshold(uint32_t n) noexcept { threshold = n; }
+
+  /// Executes at most 'max_steps' instructions or until the program halts.
+  /// Returns the number of executed instructions.
+  auto run(size_t max_steps = -1) -> size_t {
+    size_t steps = 0;
+
+#ifdef LYRAHGAMES_RISCV_COMPUTED_GOTO
+    static const void* const handlers[]{
+        &&handle_add,   &&handle_sub,   &&handle_sll,   &&handle_slt,
+        &&handle_sltu,  &&handle_xor_,  &&handle_srl,   &&handle_sra,
+        &&handle_or_,   &&handle_and_,  &&handle_addi,  &&handle_slti,
+        &&handle_sltiu, &&handle_xori,  &&handle_ori,   &&handle_andi,
+        &&handle_slli,  &&handle_srli,  &&handle_srai,  &&handle_addw,
+        &&handle_subw,  &&handle_sllw,  &&handle_srlw,  &&handle_sraw,
+        &&handle_addiw, &&handle_slliw, &&handle_srliw, &&handle_sraiw,
+        &&handle_lui,   &&handle_auipc, &&handle_lb,    &&handle_lh,
+        &&handle_lw,    &&handle_ld,    &&handle_lbu,   &&handle_lhu,
+        &&handle_lwu,   &&handle_sb,    &&handle_sh,    &&handle_sw,
+        &&handle_sd,    &&handle_beq,   &&handle_bne,   &&handle_blt,
+        &&handle_bge,   &&handle_bltu,  &&handle_bgeu,  &&handle_jal,
+        &&handle_jalr,  &&handle_halt,
+    };
+    static_assert(std::size(handlers) == operation_count);
+#else
+    static constexpr const void* const* handlers = nullptr;
+#endif
+
+    // Entering a block may decode it and invalidate all micro-op pointers.
+    const block* b = nullptr;
+    const micro_op* base = nullptr;
+    const micro_op* ip = nullptr;
+    const auto enter = [&](size_t target) {
+#ifdef LYRAHGAMES_RISCV_X86_JIT
+      target = run_native(target, handlers, max_steps, steps);
+#endif
+      b = &block_cache[block_index(target, handlers)];
+      base = ops.data() + b->first;
+      ip = base;
+    };
+    // Index of the current instruction.
+    const auto current = [&] { return b->pc + size_t(ip - base); };
+    const auto check_access = [&](uint64_t address, size_t size) {
+      if ((guest_memory.size() >= size) &&
+          (address <= guest_memory.size() - size))
+        return;
+      pc = current();
+      throw std::runtime_error("Memory access at address " +
+                               std::to_string(address) +
+                               " is out of bounds.");
+    };
+
+    enter(pc);
+
+#ifdef LYRAHGAMES_RISCV_COMPUTED_GOTO
+#define LYRAHGAMES_RISCV_HANDLER(name) handle_##name
+#define LYRAHGAMES_RISCV_DISPATCH()    \
+  do {                                 \
+    if (steps == max_steps) goto stop; \
+    ++steps;                           \
+    goto* ip->handler;                 \
+  } while (false)
+    LYRAHGAMES_RISCV_DISPATCH();
+#else
+#define LYRAHGAMES_RISCV_HANDLER(name) case operation::name
+#define LYRAHGAMES_RISCV_DISPATCH() goto dispatch
+  dispatch:
+    if (steps == max_steps) goto stop;
+    ++steps;
+    switch (ip->op) {
+#endif
+
+// Operations on two registers 'a' and 'b' or a register and 'imm'.
+#define LYRAHGAMES_RISCV_OP(name, result) \
+  LYRAHGAMES_RISCV_HANDLER(name) : {      \
+    const uint64_t a = x[ip->rs1];        \
+    const uint64_t b = x[ip->rs2];        \
+    x[ip->rd] = (result);                 \
+    x[0] = 0;                             \
+    ++ip;                                 \
+    LYRAHGAMES_RISCV_DISPATCH();          \
+  }
+#define LYRAHGAMES_RISCV_OP_IMM(name, result)   \
+  LYRAHGAMES_RISCV_HANDLER(name) : {            \
+    const uint64_t a = x[ip->rs1];              \
+    const uint64_t imm = int64_t{ip->imm};      \
+    x[ip->rd] = (result);                       \
+    x[0] = 0;                                   \
+    ++ip;                                       \
+    LYRAHGAMES_RISCV_DISPATCH();                \
+  }
+#define LYRAHGAMES_RISCV_BRANCH(name, condition) \
+  LYRAHGAMES_RISCV_HANDLER(name) : {             \
+    const uint64_t a = x[ip->rs1];               \
+    const uint64_t b = x[ip->rs2];               \
+    if (condition)                               \
+      enter(ip->imm);                            \
+    else                                         \
+      enter(current() + 1);                      \
+    LYRAHGAMES_RISCV_DISPATCH();                 \
+  }
+// Loaded values are sign- or zero-extended by the conversion of 'type'.
+#define LYRAHGAMES_RISCV_LOAD(name, type)                             \
+  LYRAHGAMES_RISCV_HANDLER(name) : {                                  \
+    const auto address = x[ip->rs1] + ip->imm;                        \
+    check_access(address, sizeof(type));                              \
+    type value;                                                       \
+    std::memcpy(&value, guest_memory.data() + address, sizeof(type)); \
+    x[ip->rd] = uint64_t(value);                                      \
+    x[0] = 0;                                                         \
+    ++ip;                                                             \
+    LYRAHGAMES_RISCV_DISPATCH();                                      \
+  }
+#define LYRAHGAMES_RISCV_STORE(name, type)                            \
+  LYRAHGAMES_RISCV_HANDLER(name) : {                                  \
+    const auto address = x[ip->rs1] + ip->imm;                        \
+    check_access(address, sizeof(type));                              \
+    const auto value = type(x[ip->rs2]);                              \
+    std::memcpy(guest_memory.data() + address, &value, sizeof(type)); \
+    ++ip;                                                             \
+    LYRAHGAMES_RISCV_DISPATCH();                                      \
+  }
+
+    LYRAHGAMES_RISCV_OP(add, a + b)
+    LYRAHGAMES_RISCV_OP(sub, a - b)
+    LYRAHGAMES_RISCV_OP(sll, a << (b & 63))
+    LYRAHGAMES_RISCV_OP(slt, int64_t(a) < int64_t(b))
+    LYRAHGAMES_RISCV_OP(sltu, a < b)
+    LYRAHGAMES_RISCV_OP(xor_, a ^ b)
+    LYRAHGAMES_RISCV_OP(srl, a >> (b & 63))
+    LYRAHGAMES_RISCV_OP(sra, uint64_t(int64_t(a) >> (b & 63)))
+    LYRAHGAMES_RISCV_OP(or_, a | b)
+    LYRAHGAMES_RISCV_OP(and_, a & b)
+
+    LYRAHGAMES_RISCV_OP_IMM(addi, a + imm)
+    LYRAHGAMES_RISCV_OP_IMM(slti, int64_t(a) < int64_t(imm))
+    LYRAHGAMES_RISCV_OP_IMM(sltiu, a < imm)
+    LYRAHGAMES_RISCV_OP_IMM(xori, a ^ imm)
+    LYRAHGAMES_RISCV_OP_IMM(ori, a | imm)
+    LYRAHGAMES_RISCV_OP_IMM(andi, a & imm)
+    LYRAHGAMES_RISCV_OP_IMM(slli, a << (imm & 63))
+    LYRAHGAMES_RISCV_OP_IMM(srli, a >> (imm & 63))
+    LYRAHGAMES_RISCV_OP_IMM(srai, uint64_t(int64_t(a) >> (imm & 63)))
+
+    // Word operations use the lower 32 bits and sign-extend the result.
+    LYRAHGAMES_RISCV_OP(addw, sign_extend(uint32_t(a + b)))
+    LYRAHGAMES_RISCV_OP(subw, sign_extend(uint32_t(a - b)))
+    LYRAHGAMES_RISCV_OP(sllw, sign_extend(uint32_t(a) << (b & 31)))
+    LYRAHGAMES_RISCV_OP(srlw, sign_extend(uint32_t(a) >> (b & 31)))
+    LYRAHGAMES_RISCV_OP(sraw, sign_extend(int32_t(a) >> (b & 31)))
+    LYRAHGAMES_RISCV_OP_IMM(addiw, sign_extend(uint32_t(a + imm)))
+    LYRAHGAMES_RISCV_OP_IMM(slliw, sign_extend(uint32_t(a) << (imm & 31)))
+    LYRAHGAMES_RISCV_OP_IMM(srliw, sign_extend(uint32_t(a) >> (imm & 31)))
+    LYRAHGAMES_RISCV_OP_IMM(sraiw, sign_extend(int32_t(a) >> (imm & 31)))
+
+    LYRAHGAMES_RISCV_HANDLER(lui) : {
+      x[ip->rd] = int64_t{ip->imm};
+      x[0] = 0;
+      ++ip;
+      LYRAHGAMES_RISCV_DISPATCH();
+    }
+
+    LYRAHGAMES_RISCV_HANDLER(auipc) : {
+      x[ip->rd] = current() * instruction_size + int64_t{ip->imm};
+      x[0] = 0;
+      ++ip;
+      LYRAHGAMES_RISCV_DISPATCH();
+    }
+
+    LYRAHGAMES_RISCV_LOAD(lb, int8_t)
+    LYRAHGAMES_RISCV_LOAD(lh, int16_t)
+    LYRAHGAMES_RISCV_LOAD(lw, int32_t)
+    LYRAHGAMES_RISCV_LOAD(ld, uint64_t)
+    LYRAHGAMES_RISCV_LOAD(lbu, uint8_t)
+    LYRAHGAMES_RISCV_LOAD(lhu, uint16_t)
+    LYRAHGAMES_RISCV_LOAD(lwu, uint32_t)
+
+    LYRAHGAMES_RISCV_STORE(sb, uint8_t)
+    LYRAHGAMES_RISCV_STORE(sh, uint16_t)
+    LYRAHGAMES_RISCV_STORE(sw, uint32_t)
+    LYRAHGAMES_RISCV_STORE(sd, uint64_t)
+
+    LYRAHGAMES_RISCV_BRANCH(beq, a == b)
+    LYRAHGAMES_RISCV_BRANCH(bne, a != b)
+    LYRAHGAMES_RISCV_BRANCH(blt, int64_t(a) < int64_t(b))
+    LYRAHGAMES_RISCV_BRANCH(bge, int64_t(a) >= int64_t(b))
+    LYRAHGAMES_RISCV_BRANCH(bltu, a < b)
+    LYRAHGAMES_RISCV_BRANCH(bgeu, a >= b)
+
+    LYRAHGAMES_RISCV_HANDLER(jal) : {
+      x[ip->rd] = (current() + 1) * instruction_size;
+      x[0] = 0;
+      enter(ip->imm);
+      LYRAHGAMES_RISCV_DISPATCH();
+    }
+
+    LYRAHGAMES_RISCV_HANDLER(jalr) : {
+      const auto target = (x[ip->rs1] + ip->imm) & ~uint64_t{1};
+      if ((target % instruction_size) ||
+          (target / instruction_size > prog.instructions.size())) {
+        pc = current();
+        throw std::runtime_error("Jump to invalid address " +
+                                 std::to_string(target) + ".");
+      }
+      x[ip->rd] = (current() + 1) * instruction_size;
+      x[0] = 0;
+      enter(target / instruction_size);
+      LYRAHGAMES_RISCV_DISPATCH();
+    }
+
+    LYRAHGAMES_RISCV_HANDLER(halt) : {
+      // Reaching the end is not an executed instruction.
+      --steps;
+      goto stop;
+    }
+
+#ifndef LYRAHGAMES_RISCV_COMPUTED_GOTO
+    }
+#endif
+#undef LYRAHGAMES_RISCV_HANDLER
+#undef LYRAHGAMES_RISCV_DISPATCH
+#undef LYRAHGAMES_RISCV_OP
+#undef LYRAHGAMES_RISCV_OP_IMM
+#undef LYRAHGAMES_RISCV_BRANCH
+#undef LYRAHGAMES_RISCV_LOAD
+#undef LYRAHGAMES_RISCV_STORE
+
+  stop:
+    pc = current();
+    return steps;
+  }
+
+ private:
+  static constexpr auto sign_extend(uint32_t x) noexcept -> uint64_t {
+    return uint64_t(int64_t(int32_t(x)));
+  }
+
+  /// Returns the cached block starting at the given instruction
+  /// and decodes it on the first request.
+  auto block_index(size_t start, const void* const* handlers) -> uint32_t {
+    if (block_at[start] != none) return block_at[start];
+
+    const auto size = prog.instructions.size();
+    const auto first = ops.size();
+    auto pc = start;
+    for (; pc < size; ++pc) {
+      const auto op = decode(pc);
+      ops.push_back(op);
+      if (ends_block(op.op)) break;
+    }
+    // Falling through the end of the program halts.
+    if (pc == size) ops.push_back({nullptr, operation::halt, 0, 0, 0, 0});
+
+    if (handlers)
+      for (auto i = first; i < ops.size(); ++i)
+        ops[i].handler = handlers[size_t(ops[i].op)];
+
+    const auto index = uint32_t(block_cache.size());
+    block_cache.push_back(
+        {uint32_t(start), uint32_t(first), uint32_t(ops.size() - first)});
+    block_at[start] = index;
+    return index;
+  }
+
+#ifdef LYRAHGAMES_RISCV_X86_JIT
+  /// Runs translated blocks starting at the given instruction as long as
+  /// possible. Returns the instruction at which interpretation continues.
+  auto run_native(size_t target,
+                  const void* const* handlers,
+                  size_t max_steps,
+                  size_t& steps) -> size_t {
+    while (threshold) {
+      auto& b = block_cache[block_index(target, handlers)];
+      if (!b.native) {
+        if ((b.count == none) || (++b.count < threshold)) return target;
+        b.count = none;
+        b.native = jit.compile({ops.data() + b.first, b.size}, b.pc,
+                               prog.instructions.size(), guest_memory.size());
+        if (!b.native) return target;
+      }
+
+      const auto budget = max_steps - steps;
+      jit_state state{guest_memory.data(),
+                      (guest_memory.size() < 8) ? 0 : guest_memory.size() - 8,
+                      budget,
+                      jit_state::next,
+                      0,
+                      0};
+      const auto next = jit.run(b.native, x.data(), state);
+      steps += budget - state.budget;
+
+      if (state.status == jit_state::memory_fault) {
+        pc = next;
+        throw std::runtime_error("Memory access at address " +
+                                 std::to_string(state.address) +
+                                 " is out of bounds.");
+      }
+      if (state.status == jit_state::dynamic_jump) {
+        const auto address = state.address;
+        if ((address % instruction_size) ||
+            (address / instruction_size > prog.instructions.size())) {
+          pc = next;
+          throw std::runtime_error("Jump to invalid address " +
+                                   std::to_string(address) + ".");
+        }
+        x[state.link] = (next + 1) * instruction_size;
+        x[0] = 0;
+        target = address / instruction_size;
+        continue;
+      }
+      // Without progress, the budget does not suffice for the whole block.
+      if (budget == state.budget) return next;
+      target = next;
+    }
+    return target;
+  }
+#endif
+
+  auto decode(size_t pc) const -> micro_op {
+    const auto instr = prog.instructions[pc];
+    const auto& e = prog.symbols.instructions[instr.id].encoding;
+    const auto f = instruction_fields_of(instr, pc, prog.symbols);
+    // Immediates have to fit like for the encoder and then fit into 32 bits.
+    encode_word(instr.id, f);
+    micro_op result{nullptr,        operation_of(e), uint8_t(f.rd),
+                    uint8_t(f.rs1), uint8_t(f.rs2),  int32_t(f.imm)};
+    if ((result.op == operation::lui) || (result.op == operation::auipc))
+      result.imm = int32_t(uint32_t(f.imm) << 12);
+    if (is_branch(result.op) || (result.op == operation::jal)) {
+      // Targets are checked once such that execution does not have to.
+      const auto target = immediate(pc) + f.imm / immediate(instruction_size);
+      if ((target < 0) || (size_t(target) > prog.instructions.size()))
+        throw std::runtime_error("Jump target of instruction " +
+                                 std::to_string(pc) + " is out of range.");
+      result.imm = int32_t(target);
+    }
+    return result;
+  }
+
+  const program& prog;
+  std::vector<uint32_t> block_at;
+  std::vector<block> block_cache{};
+  std::vector<micro_op> ops{};
+  std::array<uint64_t, 32> x{};
+  std::vector<uint8_t> guest_memory;
+  size_t pc = 0;
+  uint32_t threshold = default_jit_threshold;
+#ifdef LYRAHGAMES_RISCV_X86_JIT
+  jit_compiler jit{};
+#endif
+};
+
+}  // namespace lyrahgames::riscv
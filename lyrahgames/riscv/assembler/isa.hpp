@@ -0,0 +1,931 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+//
+#include <lyrahgames/riscv/assembler/utility.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Types of operands in the order of the alternatives of 'operand_value'.
+enum class operand_type : size_t {
+  int_register = 0,
+  int_literal,
+  memory_address,
+  label,
+  float_register,
+};
+
+inline constexpr size_t operand_type_count = 5;
+
+/// Operand types of a whole operand list packed into one integer.
+/// Bits [12, 15) store the number of operands and every operand stores its
+/// 'operand_type', which equals its 'operand_value' index, in three bits
+/// starting at bit 0. Hence, equal signatures mean equal operand types.
+using operand_signature = uint16_t;
+
+inline constexpr size_t operand_type_bits = 3;
+inline constexpr size_t operand_count_shift = 12;
+
+/// Instruction formats of the RISC-V ISA.
+/// The six base formats are followed by variants that differ in their
+/// function or immediate fields: 'r4' for fused multiply-add with a third
+/// source register, 'sh' and 'shw' for shifts by 6-bit and 5-bit amounts
+/// and 'csr' for the unsigned CSR number of Zicsr.
+enum class instruction_format : uint8_t { r, i, s, b, u, j, r4, sh, shw, csr };
+
+inline constexpr size_t instruction_format_count = 10;
+
+/// Bit fields of an instruction that can receive operands.
+enum class instruction_field : uint8_t { rd, rs1, rs2, rs3, imm };
+
+/// Set of instruction fields with one bit per 'instruction_field'.
+using field_set = uint8_t;
+
+constexpr auto field_bit(instruction_field f) noexcept -> field_set {
+  return field_set(1) << size_t(f);
+}
+
+inline constexpr field_set register_fields =
+    field_bit(instruction_field::rd) | field_bit(instruction_field::rs1) |
+    field_bit(instruction_field::rs2) | field_bit(instruction_field::rs3);
+
+/// Fields that exist in every format indexed by 'instruction_format'.
+inline constexpr auto format_fields = [] {
+  using enum instruction_field;
+  std::array<field_set, instruction_format_count> result{};
+  const auto set = [&](instruction_format format, auto... fields) {
+    result[size_t(format)] = (field_bit(fields) | ...);
+  };
+  set(instruction_format::r, rd, rs1, rs2);
+  set(instruction_format::i, rd, rs1, imm);
+  set(instruction_format::s, rs1, rs2, imm);
+  set(instruction_format::b, rs1, rs2, imm);
+  set(instruction_format::u, rd, imm);
+  set(instruction_format::j, rd, imm);
+  set(instruction_format::r4, rd, rs1, rs2, rs3);
+  set(instruction_format::sh, rd, rs1, imm);
+  set(instruction_format::shw, rd, rs1, imm);
+  set(instruction_format::csr, rd, rs1, imm);
+  return result;
+}();
+
+/// Type of one operand and the fields that receive its value.
+/// Memory addresses write their base to 'rs1' and their offset to 'imm'.
+/// Registers may be tied to more than one field, like in 'c.add rd, rs2'
+/// whose destination is its first source as well.
+struct operand_spec {
+  operand_type type;
+  field_set fields;
+};
+
+/// Operand specifications of one instruction stored in place.
+class operand_spec_list {
+ public:
+  static constexpr size_t capacity = 4;
+
+  constexpr auto size() const noexcept -> size_t { return count; }
+  constexpr bool empty() const noexcept { return !count; }
+
+  constexpr void push_back(operand_spec x) {
+    if (count == capacity)
+      throw std::length_error("Too many operands for one instruction.");
+    values[count++] = x;
+  }
+
+  constexpr auto operator[](size_t i) const noexcept -> const operand_spec& {
+    return values[i];
+  }
+
+  constexpr auto begin() const noexcept { return values.begin(); }
+  constexpr auto end() const noexcept { return values.begin() + count; }
+
+ private:
+  std::array<operand_spec, capacity> values{};
+  uint8_t count = 0;
+};
+
+/// Parses the operand syntax of an instruction description.
+/// Operands are separated by commas and named by the field they are
+/// written to: 'rd', 'rs1' and 'rs2' for integer registers, 'fd', 'fs1',
+/// 'fs2' and 'fs3' for floating-point registers, 'imm' for integer
+/// literals, 'zimm' for 5-bit literals in the 'rs1' field, 'label' for
+/// branch and jump targets and 'imm(rs1)' or '(rs1)' for memory addresses.
+/// Names joined by '=' tie one operand to several fields.
+constexpr auto operand_specs_of(std::string_view syntax) -> operand_spec_list {
+  using enum instruction_field;
+  constexpr std::pair<std::string_view, operand_spec> names[]{
+      {"rd", {operand_type::int_register, field_bit(rd)}},
+      {"rs1", {operand_type::int_register, field_bit(rs1)}},
+      {"rs2", {operand_type::int_register, field_bit(rs2)}},
+      {"fd", {operand_type::float_register, field_bit(rd)}},
+      {"fs1", {operand_type::float_register, field_bit(rs1)}},
+      {"fs2", {operand_type::float_register, field_bit(rs2)}},
+      {"fs3", {operand_type::float_register, field_bit(rs3)}},
+      {"imm", {operand_type::int_literal, field_bit(imm)}},
+      {"zimm", {operand_type::int_literal, field_bit(rs1)}},
+      {"label", {operand_type::label, field_bit(imm)}},
+      {"imm(rs1)",
+       {operand_type::memory_address, field_bit(rs1) | field_bit(imm)}},
+      {"(rs1)", {operand_type::memory_address, field_bit(rs1)}},
+  };
+  const auto spec_of = [&](std::string_view name) {
+    for (const auto& [key, spec] : names)
+      if (key == name) return spec;
+    throw std::logic_error("Unknown operand in instruction syntax.");
+  };
+
+  operand_spec_list result{};
+  while (!syntax.empty()) {
+    const auto comma = std::min(syntax.find(','), syntax.size());
+    auto operand = syntax.substr(0, comma);
+    syntax.remove_prefix(std::min(comma + 1, syntax.size()));
+
+    const auto tie = std::min(operand.find('='), operand.size());
+    auto spec = spec_of(operand.substr(0, tie));
+    operand.remove_prefix(tie);
+    while (!operand.empty()) {
+      operand.remove_prefix(1);
+      const auto next = std::min(operand.find('='), operand.size());
+      const auto other = spec_of(operand.substr(0, next));
+      if (other.type != spec.type)
+        throw std::logic_error("Tied operand fields differ in their type.");
+      spec.fields |= other.fields;
+      operand.remove_prefix(next);
+    }
+    result.push_back(spec);
+  }
+  return result;
+}
+
+constexpr auto operand_signature_of(const operand_spec_list& operands)
+    -> operand_signature {
+  operand_signature result = operands.size() << operand_count_shift;
+  for (size_t i = 0; i < operands.size(); ++i)
+    result |= size_t(operands[i].type) << (operand_type_bits * i);
+  return result;
+}
+
+/// Values of register and immediate fields that are not given by operands,
+/// like the return address register of 'call' or the immediate of 'not'.
+struct fixed_fields {
+  uint8_t rd = 0;
+  uint8_t rs1 = 0;
+  uint8_t rs2 = 0;
+  uint8_t rs3 = 0;
+  int32_t imm = 0;
+};
+
+/// Fixed bit fields of an instruction overload.
+/// Register fields that are not given by an operand keep their value here.
+struct instruction_encoding {
+  instruction_format format;
+  uint8_t opcode;
+  uint8_t funct3 = 0;
+  uint8_t funct7 = 0;
+  uint8_t rd = 0;
+  uint8_t rs1 = 0;
+  uint8_t rs2 = 0;
+  uint8_t rs3 = 0;
+  int32_t imm = 0;
+};
+
+/// Source of one bit of a 16-bit instruction of the C extension.
+/// Compact registers, marked by '_c', encode x8 to x15 in three bits.
+enum class parcel_source : uint8_t {
+  zero,
+  one,
+  imm,
+  rd,
+  rs1,
+  rs2,
+  rd_c,
+  rs1_c,
+  rs2_c,
+};
+
+struct parcel_bit {
+  parcel_source source = parcel_source::zero;
+  uint8_t index = 0;
+};
+
+/// Bit layout of a 16-bit instruction of the C extension.
+/// The layout is written like the rows of the encoding tables of the
+/// specification from bit 15 down to bit 0, like
+/// '010 uimm[5] rd uimm[4:2|7:6] 10' for 'c.lwsp'. Binary digits are fixed
+/// bits, 'rd', 'rs1' and 'rs2' are 5-bit registers and a trailing "'"
+/// marks a compact 3-bit register. Immediates list their bits from left to
+/// right. The prefix 'u' makes them unsigned and 'nz' excludes zero.
+struct compressed_layout {
+  constexpr compressed_layout() = default;
+
+  constexpr compressed_layout(std::string_view layout) : present{true} {
+    int position = 16;
+    const auto next = [&](parcel_source source, size_t index) {
+      if (--position < 0)
+        throw std::logic_error("Compressed layout exceeds 16 bits.");
+      bits[position] = {source, uint8_t(index)};
+    };
+    const auto field = [&](std::string_view name, bool compact) {
+      constexpr std::pair<std::string_view, parcel_source> names[]{
+          {"rd", parcel_source::rd},
+          {"rs1", parcel_source::rs1},
+          {"rs2", parcel_source::rs2},
+      };
+      for (const auto& [key, source] : names) {
+        if (key != name) continue;
+        const auto count = compact ? 3 : 5;
+        const auto s =
+            compact ? parcel_source(size_t(source) + 3) : source;
+        for (int i = count - 1; i >= 0; --i) next(s, i);
+        return;
+      }
+      throw std::logic_error("Unknown field in compressed layout.");
+    };
+    const auto number = [](std::string_view digits) {
+      size_t result = 0;
+      for (auto c : digits) {
+        if ((c < '0') || (c > '9'))
+          throw std::logic_error("Invalid bit index in compressed layout.");
+        result = 10 * result + size_t(c - '0');
+      }
+      return result;
+    };
+
+    while (!layout.empty()) {
+      const auto space = std::min(layout.find(' '), layout.size());
+      auto token = layout.substr(0, space);
+      layout.remove_prefix(std::min(space + 1, layout.size()));
+
+      if ((token[0] == '0') || (token[0] == '1')) {
+        for (auto c : token)
+          next((c == '1') ? parcel_source::one : parcel_source::zero, 0);
+        continue;
+      }
+
+      const auto bracket = token.find('[');
+      if (bracket == std::string_view::npos) {
+        const bool compact = token.ends_with('\'');
+        if (compact) token.remove_suffix(1);
+        field(token, compact);
+        continue;
+      }
+
+      auto name = token.substr(0, bracket);
+      if (name.starts_with("nz")) {
+        nonzero_imm = true;
+        name.remove_prefix(2);
+      }
+      if (name.starts_with('u')) {
+        signed_imm = false;
+        name.remove_prefix(1);
+      }
+      if ((name != "imm") || !token.ends_with(']'))
+        throw std::logic_error("Invalid immediate in compressed layout.");
+      auto list = token.substr(bracket + 1, token.size() - bracket - 2);
+      while (!list.empty()) {
+        const auto bar = std::min(list.find('|'), list.size());
+        const auto range = list.substr(0, bar);
+        list.remove_prefix(std::min(bar + 1, list.size()));
+        const auto colon = std::min(range.find(':'), range.size());
+        const auto high = number(range.substr(0, colon));
+        const auto low = (colon < range.size())
+                             ? number(range.substr(colon + 1))
+                             : high;
+        for (auto i = high + 1; i-- > low;) {
+          next(parcel_source::imm, i);
+          imm_width = std::max(imm_width, uint8_t(i + 1));
+        }
+      }
+    }
+    if (position != 0)
+      throw std::logic_error("Compressed layout does not cover 16 bits.");
+  }
+
+  constexpr explicit operator bool() const noexcept { return present; }
+
+  /// Bits that are fixed by the layout and their values.
+  constexpr auto mask() const noexcept -> uint16_t {
+    uint16_t result = 0;
+    for (size_t i = 0; i < bits.size(); ++i)
+      if (bits[i].source <= parcel_source::one) result |= 1u << i;
+    return result;
+  }
+
+  constexpr auto value() const noexcept -> uint16_t {
+    uint16_t result = 0;
+    for (size_t i = 0; i < bits.size(); ++i)
+      if (bits[i].source == parcel_source::one) result |= 1u << i;
+    return result;
+  }
+
+  /// Returns whether the layout stores the given field.
+  constexpr bool contains(instruction_field f) const noexcept {
+    for (const auto& bit : bits) {
+      switch (bit.source) {
+        case parcel_source::imm:
+          if (f == instruction_field::imm) return true;
+          break;
+        case parcel_source::rd:
+        case parcel_source::rd_c:
+          if (f == instruction_field::rd) return true;
+          break;
+        case parcel_source::rs1:
+        case parcel_source::rs1_c:
+          if (f == instruction_field::rs1) return true;
+          break;
+        case parcel_source::rs2:
+        case parcel_source::rs2_c:
+          if (f == instruction_field::rs2) return true;
+          break;
+        default:
+          break;
+      }
+    }
+    return false;
+  }
+
+  std::array<parcel_bit, 16> bits{};
+  uint8_t imm_width = 0;
+  bool signed_imm = true;
+  bool nonzero_imm = false;
+  bool present = false;
+};
+
+/// Mnemonic stored in place such that variants, like the memory ordering
+/// suffixes of atomic instructions, can be generated at compile time.
+class mnemonic {
+ public:
+  static constexpr size_t capacity = 15;
+
+  constexpr mnemonic() noexcept = default;
+
+  constexpr mnemonic(std::string_view name) { *this += name; }
+
+  constexpr mnemonic(const char* name) : mnemonic{std::string_view{name}} {}
+
+  constexpr mnemonic& operator+=(std::string_view suffix) {
+    if (length + suffix.size() > capacity)
+      throw std::length_error("Mnemonic is too long.");
+    for (auto c : suffix) chars[length++] = c;
+    return *this;
+  }
+
+  friend constexpr auto operator+(mnemonic x, std::string_view suffix)
+      -> mnemonic {
+    return x += suffix;
+  }
+
+  constexpr operator std::string_view() const noexcept {
+    return {chars.data(), length};
+  }
+
+ private:
+  std::array<char, capacity> chars{};
+  uint8_t length = 0;
+};
+
+/// Declarative description of one instruction overload.
+/// Base instructions give their format and function fields. Aliases,
+/// i.e. pseudo instructions and instructions of the C extension, name the
+/// base instruction they expand to and only give their own operand syntax
+/// and fixed fields. Instructions of the C extension give their 16-bit
+/// layout in addition.
+struct instruction_spec {
+  mnemonic name;
+  std::string_view syntax;
+  instruction_encoding encoding;
+  mnemonic base{};
+  std::string_view layout{};
+};
+
+/// Fully resolved entry of an instruction table as it is used by the parser,
+/// the encoder and the decoder.
+struct instruction_data {
+  operand_spec_list operands;
+  operand_signature signature;
+  instruction_encoding encoding;
+  compressed_layout compressed;
+};
+
+/// Extensions of the RISC-V ISA with an instruction description.
+enum class extension : uint8_t { i, m, a, f, d, zicsr, zifencei, c };
+
+/// Instruction descriptions of one extension given by specializations.
+/// Every specialization provides the static span 'instructions'.
+/// Aliases may expand to instructions of the same or of other extensions.
+template <extension ext>
+struct isa_extension;
+
+/// Helpers and instruction lists of the extensions.
+namespace spec {
+
+using enum instruction_format;
+
+/// Major opcodes named like in the opcode map of the specification.
+enum opcode : uint8_t {
+  load = 0b0000011,
+  load_fp = 0b0000111,
+  misc_mem = 0b0001111,
+  op_imm = 0b0010011,
+  auipc = 0b0010111,
+  op_imm_32 = 0b0011011,
+  store = 0b0100011,
+  store_fp = 0b0100111,
+  amo = 0b0101111,
+  op = 0b0110011,
+  lui = 0b0110111,
+  op_32 = 0b0111011,
+  madd = 0b1000011,
+  msub = 0b1000111,
+  nmsub = 0b1001011,
+  nmadd = 0b1001111,
+  op_fp = 0b1010011,
+  branch = 0b1100011,
+  jalr = 0b1100111,
+  jal = 0b1101111,
+  system = 0b1110011,
+};
+
+/// Dynamic rounding mode in the 'funct3' field of floating-point operations.
+inline constexpr uint8_t dyn = 0b111;
+
+/// Rounding mode of conversions that are always exact, like 'fcvt.d.w'.
+/// It does not matter and is encoded as zero like by the GNU and LLVM
+/// assemblers.
+inline constexpr uint8_t exact = 0b000;
+
+constexpr auto base(mnemonic name,
+                    std::string_view syntax,
+                    instruction_format format,
+                    uint8_t opcode,
+                    uint8_t funct3 = 0,
+                    uint8_t funct7 = 0,
+                    fixed_fields fixed = {}) -> instruction_spec {
+  return {name,
+          syntax,
+          {format, opcode, funct3, funct7, fixed.rd, fixed.rs1, fixed.rs2,
+           fixed.rs3, fixed.imm}};
+}
+
+constexpr auto alias(mnemonic name,
+                     std::string_view syntax,
+                     mnemonic base,
+                     fixed_fields fixed = {}) -> instruction_spec {
+  return {name,
+          syntax,
+          {{}, 0, 0, 0, fixed.rd, fixed.rs1, fixed.rs2, fixed.rs3, fixed.imm},
+          base};
+}
+
+constexpr auto compressed(mnemonic name,
+                          std::string_view syntax,
+                          mnemonic base,
+                          std::string_view layout,
+                          fixed_fields fixed = {}) -> instruction_spec {
+  auto result = alias(name, syntax, base, fixed);
+  result.layout = layout;
+  return result;
+}
+
+template <typename T, size_t... N>
+constexpr auto concat(const std::array<T, N>&... lists) {
+  std::array<T, (N + ...)> result{};
+  size_t i = 0;
+  ((std::ranges::copy(lists, result.begin() + i), i += N), ...);
+  return result;
+}
+
+inline constexpr std::array rv64i{
+    base("add", "rd,rs1,rs2", r, op, 0b000, 0b0000000),
+    base("addi", "rd,rs1,imm", i, op_imm, 0b000),
+    base("sub", "rd,rs1,rs2", r, op, 0b000, 0b0100000),
+    base("sll", "rd,rs1,rs2", r, op, 0b001, 0b0000000),
+    base("slt", "rd,rs1,rs2", r, op, 0b010, 0b0000000),
+    base("sltu", "rd,rs1,rs2", r, op, 0b011, 0b0000000),
+    base("xor", "rd,rs1,rs2", r, op, 0b100, 0b0000000),
+    base("srl", "rd,rs1,rs2", r, op, 0b101, 0b0000000),
+    base("sra", "rd,rs1,rs2", r, op, 0b101, 0b0100000),
+    base("or", "rd,rs1,rs2", r, op, 0b110, 0b0000000),
+    base("and", "rd,rs1,rs2", r, op, 0b111, 0b0000000),
+    base("slti", "rd,rs1,imm", i, op_imm, 0b010),
+    base("sltiu", "rd,rs1,imm", i, op_imm, 0b011),
+    base("xori", "rd,rs1,imm", i, op_imm, 0b100),
+    base("ori", "rd,rs1,imm", i, op_imm, 0b110),
+    base("andi", "rd,rs1,imm", i, op_imm, 0b111),
+    base("slli", "rd,rs1,imm", sh, op_imm, 0b001, 0b0000000),
+    base("srli", "rd,rs1,imm", sh, op_imm, 0b101, 0b0000000),
+    base("srai", "rd,rs1,imm", sh, op_imm, 0b101, 0b0100000),
+    base("addw", "rd,rs1,rs2", r, op_32, 0b000, 0b0000000),
+    base("subw", "rd,rs1,rs2", r, op_32, 0b000, 0b0100000),
+    base("sllw", "rd,rs1,rs2", r, op_32, 0b001, 0b0000000),
+    base("srlw", "rd,rs1,rs2", r, op_32, 0b101, 0b0000000),
+    base("sraw", "rd,rs1,rs2", r, op_32, 0b101, 0b0100000),
+    base("addiw", "rd,rs1,imm", i, op_imm_32, 0b000),
+    base("slliw", "rd,rs1,imm", shw, op_imm_32, 0b001, 0b0000000),
+    base("srliw", "rd,rs1,imm", shw, op_imm_32, 0b101, 0b0000000),
+    base("sraiw", "rd,rs1,imm", shw, op_imm_32, 0b101, 0b0100000),
+    base("lui", "rd,imm", u, lui),
+    base("auipc", "rd,imm", u, auipc),
+    base("jal", "rd,label", j, jal),
+    base("jalr", "rd,imm(rs1)", i, jalr, 0b000),
+    base("beq", "rs1,rs2,label", b, branch, 0b000),
+    base("bne", "rs1,rs2,label", b, branch, 0b001),
+    base("blt", "rs1,rs2,label", b, branch, 0b100),
+    base("bge", "rs1,rs2,label", b, branch, 0b101),
+    base("bltu", "rs1,rs2,label", b, branch, 0b110),
+    base("bgeu", "rs1,rs2,label", b, branch, 0b111),
+    base("lb", "rd,imm(rs1)", i, load, 0b000),
+    base("lh", "rd,imm(rs1)", i, load, 0b001),
+    base("lw", "rd,imm(rs1)", i, load, 0b010),
+    base("ld", "rd,imm(rs1)", i, load, 0b011),
+    base("lbu", "rd,imm(rs1)", i, load, 0b100),
+    base("lhu", "rd,imm(rs1)", i, load, 0b101),
+    base("lwu", "rd,imm(rs1)", i, load, 0b110),
+    base("sb", "rs2,imm(rs1)", s, store, 0b000),
+    base("sh", "rs2,imm(rs1)", s, store, 0b001),
+    base("sw", "rs2,imm(rs1)", s, store, 0b010),
+    base("sd", "rs2,imm(rs1)", s, store, 0b011),
+    // Orders all device inputs and outputs and memory reads and writes.
+    base("fence", "", i, misc_mem, 0b000, 0, {.imm = 0x0ff}),
+    base("ecall", "", i, system, 0b000),
+    base("ebreak", "", i, system, 0b000, 0, {.imm = 1}),
+
+    // Pseudo instructions that expand to exactly one instruction.
+    // Immediates of 'li' have to fit into 12 bits.
+    alias("add", "rd,rs1,imm", "addi"),
+    alias("nop", "", "addi"),
+    alias("li", "rd,imm", "addi"),
+    alias("mv", "rd,rs1", "addi"),
+    alias("not", "rd,rs1", "xori", {.imm = -1}),
+    alias("neg", "rd,rs2", "sub"),
+    alias("negw", "rd,rs2", "subw"),
+    alias("sext.w", "rd,rs1", "addiw"),
+    alias("seqz", "rd,rs1", "sltiu", {.imm = 1}),
+    alias("snez", "rd,rs2", "sltu"),
+    alias("sltz", "rd,rs1", "slt"),
+    alias("sgtz", "rd,rs2", "slt"),
+    alias("beqz", "rs1,label", "beq"),
+    alias("bnez", "rs1,label", "bne"),
+    alias("blez", "rs2,label", "bge"),
+    alias("bgez", "rs1,label", "bge"),
+    alias("bltz", "rs1,label", "blt"),
+    alias("bgtz", "rs2,label", "blt"),
+    alias("bgt", "rs2,rs1,label", "blt"),
+    alias("ble", "rs2,rs1,label", "bge"),
+    alias("bgtu", "rs2,rs1,label", "bltu"),
+    alias("bleu", "rs2,rs1,label", "bgeu"),
+    alias("j", "label", "jal"),
+    alias("jal", "label", "jal", {.rd = 1}),
+    alias("jr", "rs1", "jalr"),
+    alias("jalr", "rs1", "jalr", {.rd = 1}),
+    alias("ret", "", "jalr", {.rs1 = 1}),
+    // Calls have to reach their target by one jump.
+    alias("call", "label", "jal", {.rd = 1}),
+};
+
+inline constexpr std::array rv64m{
+    base("mul", "rd,rs1,rs2", r, op, 0b000, 0b0000001),
+    base("mulh", "rd,rs1,rs2", r, op, 0b001, 0b0000001),
+    base("mulhsu", "rd,rs1,rs2", r, op, 0b010, 0b0000001),
+    base("mulhu", "rd,rs1,rs2", r, op, 0b011, 0b0000001),
+    base("div", "rd,rs1,rs2", r, op, 0b100, 0b0000001),
+    base("divu", "rd,rs1,rs2", r, op, 0b101, 0b0000001),
+    base("rem", "rd,rs1,rs2", r, op, 0b110, 0b0000001),
+    base("remu", "rd,rs1,rs2", r, op, 0b111, 0b0000001),
+    base("mulw", "rd,rs1,rs2", r, op_32, 0b000, 0b0000001),
+    base("divw", "rd,rs1,rs2", r, op_32, 0b100, 0b0000001),
+    base("divuw", "rd,rs1,rs2", r, op_32, 0b101, 0b0000001),
+    base("remw", "rd,rs1,rs2", r, op_32, 0b110, 0b0000001),
+    base("remuw", "rd,rs1,rs2", r, op_32, 0b111, 0b0000001),
+};
+
+/// Atomic instructions for words and double words in all four memory
+/// orderings. The ordering bits 'aq' and 'rl' are the lowest bits of
+/// 'funct7' below the 5-bit function.
+inline constexpr auto rv64a = [] {
+  constexpr std::pair<std::string_view, uint8_t> operations[]{
+      {"lr", 0b00010},      {"sc", 0b00011},      {"amoswap", 0b00001},
+      {"amoadd", 0b00000},  {"amoxor", 0b00100},  {"amoand", 0b01100},
+      {"amoor", 0b01000},   {"amomin", 0b10000},  {"amomax", 0b10100},
+      {"amominu", 0b11000}, {"amomaxu", 0b11100},
+  };
+  constexpr std::pair<std::string_view, uint8_t> widths[]{
+      {".w", 0b010},
+      {".d", 0b011},
+  };
+  constexpr std::pair<std::string_view, uint8_t> orderings[]{
+      {"", 0b00},
+      {".aq", 0b10},
+      {".rl", 0b01},
+      {".aqrl", 0b11},
+  };
+  std::array<instruction_spec, 2 * 11 * 4> result{};
+  size_t k = 0;
+  for (const auto& [name, funct5] : operations)
+    for (const auto& [width, funct3] : widths)
+      for (const auto& [ordering, bits] : orderings)
+        result[k++] = base(mnemonic{name} + width + ordering,
+                           (name == "lr") ? "rd,(rs1)" : "rd,rs2,(rs1)", r,
+                           amo, funct3, uint8_t((funct5 << 2) | bits));
+  return result;
+}();
+
+/// Instructions that F and D share for the given format suffix, 'fmt' field
+/// and memory access width. 'integer' is the width letter of loads, stores
+/// and the integer side of 'fmv', like 'w' in 'flw' and 'fmv.x.w'.
+constexpr auto floating_point(std::string_view suffix,
+                              uint8_t fmt,
+                              uint8_t width,
+                              std::string_view integer) {
+  const auto name = [&](std::string_view prefix) {
+    return mnemonic{prefix} + suffix;
+  };
+  const auto funct7 = [&](uint8_t funct5) {
+    return uint8_t((funct5 << 2) | fmt);
+  };
+  // Doubles represent all 32-bit integers.
+  const auto from_int32 = (fmt == 0b01) ? exact : dyn;
+  return std::array{
+      base(mnemonic{"fl"} + integer, "fd,imm(rs1)", i, load_fp, width),
+      base(mnemonic{"fs"} + integer, "fs2,imm(rs1)", s, store_fp, width),
+      base(name("fmadd."), "fd,fs1,fs2,fs3", r4, madd, dyn, fmt),
+      base(name("fmsub."), "fd,fs1,fs2,fs3", r4, msub, dyn, fmt),
+      base(name("fnmsub."), "fd,fs1,fs2,fs3", r4, nmsub, dyn, fmt),
+      base(name("fnmadd."), "fd,fs1,fs2,fs3", r4, nmadd, dyn, fmt),
+      base(name("fadd."), "fd,fs1,fs2", r, op_fp, dyn, funct7(0b00000)),
+      base(name("fsub."), "fd,fs1,fs2", r, op_fp, dyn, funct7(0b00001)),
+      base(name("fmul."), "fd,fs1,fs2", r, op_fp, dyn, funct7(0b00010)),
+      base(name("fdiv."), "fd,fs1,fs2", r, op_fp, dyn, funct7(0b00011)),
+      base(name("fsqrt."), "fd,fs1", r, op_fp, dyn, funct7(0b01011)),
+      base(name("fsgnj."), "fd,fs1,fs2", r, op_fp, 0b000, funct7(0b00100)),
+      base(name("fsgnjn."), "fd,fs1,fs2", r, op_fp, 0b001, funct7(0b00100)),
+      base(name("fsgnjx."), "fd,fs1,fs2", r, op_fp, 0b010, funct7(0b00100)),
+      base(name("fmin."), "fd,fs1,fs2", r, op_fp, 0b000, funct7(0b00101)),
+      base(name("fmax."), "fd,fs1,fs2", r, op_fp, 0b001, funct7(0b00101)),
+      base(mnemonic{"fcvt.w."} + suffix, "rd,fs1", r, op_fp, dyn,
+           funct7(0b11000), {.rs2 = 0}),
+      base(mnemonic{"fcvt.wu."} + suffix, "rd,fs1", r, op_fp, dyn,
+           funct7(0b11000), {.rs2 = 1}),
+      base(mnemonic{"fcvt.l."} + suffix, "rd,fs1", r, op_fp, dyn,
+           funct7(0b11000), {.rs2 = 2}),
+      base(mnemonic{"fcvt.lu."} + suffix, "rd,fs1", r, op_fp, dyn,
+           funct7(0b11000), {.rs2 = 3}),
+      base(name("fcvt.") + ".w", "fd,rs1", r, op_fp, from_int32,
+           funct7(0b11010), {.rs2 = 0}),
+      base(name("fcvt.") + ".wu", "fd,rs1", r, op_fp, from_int32,
+           funct7(0b11010), {.rs2 = 1}),
+      base(name("fcvt.") + ".l", "fd,rs1", r, op_fp, dyn, funct7(0b11010),
+           {.rs2 = 2}),
+      base(name("fcvt.") + ".lu", "fd,rs1", r, op_fp, dyn, funct7(0b11010),
+           {.rs2 = 3}),
+      base(name("feq."), "rd,fs1,fs2", r, op_fp, 0b010, funct7(0b10100)),
+      base(name("flt."), "rd,fs1,fs2", r, op_fp, 0b001, funct7(0b10100)),
+      base(name("fle."), "rd,fs1,fs2", r, op_fp, 0b000, funct7(0b10100)),
+      base(name("fclass."), "rd,fs1", r, op_fp, 0b001, funct7(0b11100)),
+      base(mnemonic{"fmv.x."} + integer, "rd,fs1", r, op_fp, 0b000,
+           funct7(0b11100)),
+      base(mnemonic{"fmv."} + integer + ".x", "fd,rs1", r, op_fp, 0b000,
+           funct7(0b11110)),
+
+      alias(name("fmv."), "fd,fs1=fs2", name("fsgnj.")),
+      alias(name("fneg."), "fd,fs1=fs2", name("fsgnjn.")),
+      alias(name("fabs."), "fd,fs1=fs2", name("fsgnjx.")),
+  };
+}
+
+inline constexpr auto rv64f = floating_point("s", 0b00, 0b010, "w");
+
+inline constexpr auto rv64d = concat(
+    floating_point("d", 0b01, 0b011, "d"),
+    std::array{
+        base("fcvt.s.d", "fd,fs1", r, op_fp, dyn, 0b0100000, {.rs2 = 1}),
+        base("fcvt.d.s", "fd,fs1", r, op_fp, exact, 0b0100001, {.rs2 = 0}),
+    });
+
+/// CSR numbers are given as integer literals.
+inline constexpr std::array zicsr{
+    base("csrrw", "rd,imm,rs1", csr, system, 0b001),
+    base("csrrs", "rd,imm,rs1", csr, system, 0b010),
+    base("csrrc", "rd,imm,rs1", csr, system, 0b011),
+    base("csrrwi", "rd,imm,zimm", csr, system, 0b101),
+    base("csrrsi", "rd,imm,zimm", csr, system, 0b110),
+    base("csrrci", "rd,imm,zimm", csr, system, 0b111),
+
+    alias("csrr", "rd,imm", "csrrs"),
+    alias("csrw", "imm,rs1", "csrrw"),
+    alias("csrs", "imm,rs1", "csrrs"),
+    alias("csrc", "imm,rs1", "csrrc"),
+    alias("csrwi", "imm,zimm", "csrrwi"),
+    alias("csrsi", "imm,zimm", "csrrsi"),
+    alias("csrci", "imm,zimm", "csrrci"),
+    // Counters and the floating-point control and status register.
+    alias("rdcycle", "rd", "csrrs", {.imm = 0xc00}),
+    alias("rdtime", "rd", "csrrs", {.imm = 0xc01}),
+    alias("rdinstret", "rd", "csrrs", {.imm = 0xc02}),
+    alias("frflags", "rd", "csrrs", {.imm = 0x001}),
+    alias("fsflags", "rd,rs1", "csrrw", {.imm = 0x001}),
+    alias("fsflags", "rs1", "csrrw", {.imm = 0x001}),
+    alias("frrm", "rd", "csrrs", {.imm = 0x002}),
+    alias("fsrm", "rd,rs1", "csrrw", {.imm = 0x002}),
+    alias("fsrm", "rs1", "csrrw", {.imm = 0x002}),
+    alias("frcsr", "rd", "csrrs", {.imm = 0x003}),
+    alias("fscsr", "rd,rs1", "csrrw", {.imm = 0x003}),
+    alias("fscsr", "rs1", "csrrw", {.imm = 0x003}),
+};
+
+inline constexpr std::array zifencei{
+    base("fence.i", "", i, misc_mem, 0b001),
+};
+
+/// Instructions of the C extension for RV64 with their 32-bit expansion.
+/// Stack-pointer relative instructions fix their base register to 'sp'.
+inline constexpr std::array rv64c{
+    // Quadrant 0
+    compressed("c.addi4spn", "rd,rs1,imm", "addi",
+               "000 nzuimm[5:4|9:6|2|3] rd' 00", {.rs1 = 2}),
+    compressed("c.fld", "fd,imm(rs1)", "fld",
+               "001 uimm[5:3] rs1' uimm[7:6] rd' 00"),
+    compressed("c.lw", "rd,imm(rs1)", "lw",
+               "010 uimm[5:3] rs1' uimm[2|6] rd' 00"),
+    compressed("c.ld", "rd,imm(rs1)", "ld",
+               "011 uimm[5:3] rs1' uimm[7:6] rd' 00"),
+    compressed("c.fsd", "fs2,imm(rs1)", "fsd",
+               "101 uimm[5:3] rs1' uimm[7:6] rs2' 00"),
+    compressed("c.sw", "rs2,imm(rs1)", "sw",
+               "110 uimm[5:3] rs1' uimm[2|6] rs2' 00"),
+    compressed("c.sd", "rs2,imm(rs1)", "sd",
+               "111 uimm[5:3] rs1' uimm[7:6] rs2' 00"),
+    // Quadrant 1
+    compressed("c.nop", "", "addi", "000 0 00000 00000 01"),
+    compressed("c.addi", "rd=rs1,imm", "addi", "000 imm[5] rd imm[4:0] 01"),
+    compressed("c.addiw", "rd=rs1,imm", "addiw",
+               "001 imm[5] rd imm[4:0] 01"),
+    compressed("c.li", "rd,imm", "addi", "010 imm[5] rd imm[4:0] 01"),
+    compressed("c.addi16sp", "rd=rs1,imm", "addi",
+               "011 nzimm[9] 00010 nzimm[4|6|8:7|5] 01", {.rd = 2, .rs1 = 2}),
+    // The immediate is the upper immediate of 'lui'.
+    compressed("c.lui", "rd,imm", "lui", "011 nzimm[5] rd nzimm[4:0] 01"),
+    compressed("c.srli", "rd=rs1,imm", "srli",
+               "100 nzuimm[5] 00 rd' nzuimm[4:0] 01"),
+    compressed("c.srai", "rd=rs1,imm", "srai",
+               "100 nzuimm[5] 01 rd' nzuimm[4:0] 01"),
+    compressed("c.andi", "rd=rs1,imm", "andi",
+               "100 imm[5] 10 rd' imm[4:0] 01"),
+    compressed("c.sub", "rd=rs1,rs2", "sub", "100 0 11 rd' 00 rs2' 01"),
+    compressed("c.xor", "rd=rs1,rs2", "xor", "100 0 11 rd' 01 rs2' 01"),
+    compressed("c.or", "rd=rs1,rs2", "or", "100 0 11 rd' 10 rs2' 01"),
+    compressed("c.and", "rd=rs1,rs2", "and", "100 0 11 rd' 11 rs2' 01"),
+    compressed("c.subw", "rd=rs1,rs2", "subw", "100 1 11 rd' 00 rs2' 01"),
+    compressed("c.addw", "rd=rs1,rs2", "addw", "100 1 11 rd' 01 rs2' 01"),
+    compressed("c.j", "label", "jal", "101 imm[11|4|9:8|10|6|7|3:1|5] 01"),
+    compressed("c.beqz", "rs1,label", "beq",
+               "110 imm[8|4:3] rs1' imm[7:6|2:1|5] 01"),
+    compressed("c.bnez", "rs1,label", "bne",
+               "111 imm[8|4:3] rs1' imm[7:6|2:1|5] 01"),
+    // Quadrant 2
+    compressed("c.slli", "rd=rs1,imm", "slli",
+               "000 nzuimm[5] rd nzuimm[4:0] 10"),
+    compressed("c.fldsp", "fd,imm(rs1)", "fld",
+               "001 uimm[5] rd uimm[4:3|8:6] 10", {.rs1 = 2}),
+    compressed("c.lwsp", "rd,imm(rs1)", "lw", "010 uimm[5] rd uimm[4:2|7:6] 10",
+               {.rs1 = 2}),
+    compressed("c.ldsp", "rd,imm(rs1)", "ld", "011 uimm[5] rd uimm[4:3|8:6] 10",
+               {.rs1 = 2}),
+    compressed("c.jr", "rs1", "jalr", "100 0 rs1 00000 10"),
+    compressed("c.mv", "rd,rs2", "add", "100 0 rd rs2 10"),
+    compressed("c.ebreak", "", "ebreak", "100 1 00000 00000 10", {.imm = 1}),
+    compressed("c.jalr", "rs1", "jalr", "100 1 rs1 00000 10", {.rd = 1}),
+    compressed("c.add", "rd=rs1,rs2", "add", "100 1 rd rs2 10"),
+    compressed("c.fsdsp", "fs2,imm(rs1)", "fsd", "101 uimm[5:3|8:6] rs2 10",
+               {.rs1 = 2}),
+    compressed("c.swsp", "rs2,imm(rs1)", "sw", "110 uimm[5:2|7:6] rs2 10",
+               {.rs1 = 2}),
+    compressed("c.sdsp", "rs2,imm(rs1)", "sd", "111 uimm[5:3|8:6] rs2 10",
+               {.rs1 = 2}),
+};
+
+}  // namespace spec
+
+template <>
+struct isa_extension<extension::i> {
+  static constexpr std::span<const instruction_spec> instructions{spec::rv64i};
+};
+
+template <>
+struct isa_extension<extension::m> {
+  static constexpr std::span<const instruction_spec> instructions{spec::rv64m};
+};
+
+template <>
+struct isa_extension<extension::a> {
+  static constexpr std::span<const instruction_spec> instructions{spec::rv64a};
+};
+
+template <>
+struct isa_extension<extension::f> {
+  static constexpr std::span<const instruction_spec> instructions{spec::rv64f};
+};
+
+template <>
+struct isa_extension<extension::d> {
+  static constexpr std::span<const instruction_spec> instructions{spec::rv64d};
+};
+
+template <>
+struct isa_extension<extension::zicsr> {
+  static constexpr std::span<const instruction_spec> instructions{spec::zicsr};
+};
+
+template <>
+struct isa_extension<extension::zifencei> {
+  static constexpr std::span<const instruction_spec> instructions{
+      spec::zifencei};
+};
+
+template <>
+struct isa_extension<extension::c> {
+  static constexpr std::span<const instruction_spec> instructions{spec::rv64c};
+};
+
+/// Instruction set that consists of the given extensions.
+/// All tables are generated at compile time. Overloads of the same mnemonic
+/// are stored consecutively in the order of their first appearance and
+/// aliases are resolved to the format and function fields of their base.
+template <extension... extensions>
+struct instruction_set {
+  static constexpr size_t size =
+      (isa_extension<extensions>::instructions.size() + ...);
+
+  static constexpr auto specs = [] {
+    std::array<instruction_spec, size> all{};
+    size_t k = 0;
+    ((std::ranges::copy(isa_extension<extensions>::instructions,
+                        all.begin() + k),
+      k += isa_extension<extensions>::instructions.size()),
+     ...);
+
+    // Sort by name first to find the first appearance of every mnemonic.
+    std::array<std::pair<std::string_view, size_t>, size> order{};
+    for (size_t i = 0; i < size; ++i) order[i] = {all[i].name, i};
+    std::ranges::sort(order);
+    std::array<std::pair<size_t, size_t>, size> groups{};
+    for (size_t i = 0, first = 0; i < size; ++i) {
+      if (order[i].first != order[first].first) first = i;
+      groups[i] = {order[first].second, order[i].second};
+    }
+    std::ranges::sort(groups);
+
+    std::array<instruction_spec, size> result{};
+    for (size_t i = 0; i < size; ++i) result[i] = all[groups[i].second];
+    return result;
+  }();
+
+  static constexpr auto table = [] {
+    std::array<instruction_data, size> result{};
+    for (size_t i = 0; i < size; ++i) {
+      const auto& s = specs[i];
+      auto& data = result[i];
+      data.operands = operand_specs_of(s.syntax);
+      data.signature = operand_signature_of(data.operands);
+      data.encoding = s.encoding;
+      if (!s.layout.empty()) data.compressed = s.layout;
+      if (std::string_view{s.base}.empty()) continue;
+
+      const auto base = std::ranges::find_if(specs, [&](const auto& x) {
+        return std::string_view{x.base}.empty() &&
+               (std::string_view{x.name} == std::string_view{s.base});
+      });
+      if (base == specs.end())
+        throw std::logic_error("Unknown base of instruction alias.");
+      data.encoding.format = base->encoding.format;
+      data.encoding.opcode = base->encoding.opcode;
+      data.encoding.funct3 = base->encoding.funct3;
+      data.encoding.funct7 = base->encoding.funct7;
+    }
+    return result;
+  }();
+
+  static constexpr auto names = [] {
+    std::array<std::string_view, size> result{};
+    for (size_t i = 0; i < size; ++i) result[i] = specs[i].name;
+    return result;
+  }();
+};
+
+/// RV64GC, i.e. RV64IMAFD with Zicsr, Zifencei and compressed instructions.
+using rv64gc = instruction_set<extension::i,
+                               extension::m,
+                               extension::a,
+                               extension::f,
+                               extension::d,
+                               extension::zicsr,
+                               extension::zifencei,
+                               extension::c>;
+
+}  // namespace lyrahgames::riscv
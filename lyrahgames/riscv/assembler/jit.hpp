@@ -0,0 +1,503 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+//
+#include <lyrahgames/riscv/assembler/micro_op.hpp>
+
+// Native code generation is only available for x86-64 Linux hosts.
+#if defined(__x86_64__) && defined(__linux__)
+#define LYRAHGAMES_RISCV_X86_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace lyrahgames::riscv {
+
+/// State shared between the interpreter and translated blocks.
+/// Native code returns the index of the next instruction. If the status is
+/// not 'next', the index is the one of the instruction that stopped it.
+struct jit_state {
+  enum status_type : uint64_t { next = 0, memory_fault, dynamic_jump };
+
+  const uint8_t* memory;
+  // Largest address of a valid 64-bit load.
+  uint64_t memory_limit;
+  // Number of instructions that may still be executed.
+  uint64_t budget;
+  uint64_t status;
+  // Faulting address or target address of a dynamic jump.
+  uint64_t address;
+  // Register that receives the return address of a dynamic jump.
+  uint64_t link;
+};
+
+#ifdef LYRAHGAMES_RISCV_X86_JIT
+
+/// Minimal x86-64 instruction emitter for the code of translated blocks.
+/// Only 64-bit operations with register, immediate and
+/// base plus 32-bit displacement operands are supported.
+struct x86_64_code {
+  enum reg : uint8_t {
+    rax = 0, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+    r8, r9, r10, r11, r12, r13, r14, r15
+  };
+  enum condition : uint8_t { below = 0x2, not_equal = 0x5, above = 0x7 };
+
+  void byte(uint8_t x) { bytes.push_back(x); }
+
+  void dword(uint32_t x) {
+    for (int i = 0; i < 4; ++i) byte(x >> (8 * i));
+  }
+
+  void rex(uint8_t r, uint8_t b) {
+    byte(0x48 | ((r >> 3) << 2) | (b >> 3));
+  }
+
+  void modrm(uint8_t mod, uint8_t r, uint8_t m) {
+    byte((mod << 6) | ((r & 7) << 3) | (m & 7));
+  }
+
+  // Operation with register and memory operand [base + disp32].
+  void op_rm(uint8_t opcode, uint8_t r, reg base, int32_t disp) {
+    rex(r, base);
+    byte(opcode);
+    modrm(0b10, r, base);
+    dword(disp);
+  }
+
+  // Operation with two register operands.
+  void op_rr(uint8_t opcode, uint8_t r, uint8_t m) {
+    rex(r, m);
+    byte(opcode);
+    modrm(0b11, r, m);
+  }
+
+  void load(reg dst, reg base, int32_t disp) { op_rm(0x8b, dst, base, disp); }
+  void store(reg base, int32_t disp, reg src) { op_rm(0x89, src, base, disp); }
+  void mov(reg dst, reg src) { op_rr(0x89, src, dst); }
+  void add(reg dst, reg src) { op_rr(0x01, src, dst); }
+  void cmp(reg a, reg b) { op_rr(0x39, b, a); }
+  void add(reg dst, reg base, int32_t disp) { op_rm(0x03, dst, base, disp); }
+  void cmp(reg a, reg base, int32_t disp) { op_rm(0x3b, a, base, disp); }
+
+  void zero(reg dst) {
+    if (dst >= r8) byte(0x45);
+    byte(0x31);
+    modrm(0b11, dst, dst);
+  }
+
+  // Immediate operations with the opcode extension 'ext'.
+  void op_ri(uint8_t ext, reg dst, int32_t imm) {
+    rex(0, dst);
+    byte(0x81);
+    modrm(0b11, ext, dst);
+    dword(imm);
+  }
+
+  void op_mi(uint8_t opcode, uint8_t ext, reg base, int32_t disp, int32_t imm) {
+    rex(0, base);
+    byte(opcode);
+    modrm(0b10, ext, base);
+    dword(disp);
+    dword(imm);
+  }
+
+  void add(reg dst, int32_t imm) { op_ri(0, dst, imm); }
+  void cmp(reg dst, int32_t imm) { op_ri(7, dst, imm); }
+
+  void mov(reg dst, int32_t imm) {
+    rex(0, dst);
+    byte(0xc7);
+    modrm(0b11, 0, dst);
+    dword(imm);
+  }
+
+  void mov(reg base, int32_t disp, int32_t imm) {
+    op_mi(0xc7, 0, base, disp, imm);
+  }
+  void cmp(reg base, int32_t disp, int32_t imm) {
+    op_mi(0x81, 7, base, disp, imm);
+  }
+  void sub(reg base, int32_t disp, int32_t imm) {
+    op_mi(0x81, 5, base, disp, imm);
+  }
+
+  void and_(reg dst, int8_t imm) {
+    rex(0, dst);
+    byte(0x83);
+    modrm(0b11, 4, dst);
+    byte(imm);
+  }
+
+  void test(reg dst, int32_t imm) {
+    rex(0, dst);
+    byte(0xf7);
+    modrm(0b11, 0, dst);
+    dword(imm);
+  }
+
+  void shr(reg dst, uint8_t imm) {
+    rex(0, dst);
+    byte(0xc1);
+    modrm(0b11, 5, dst);
+    byte(imm);
+  }
+
+  // mov dst, [base] with a base that needs neither SIB nor displacement.
+  void load_indirect(reg dst, reg base) {
+    rex(dst, base);
+    byte(0x8b);
+    modrm(0b00, dst, base);
+  }
+
+  void mov_eax(uint32_t imm) {
+    byte(0xb8);
+    dword(imm);
+  }
+
+  void push(reg r) {
+    if (r >= r8) byte(0x41);
+    byte(0x50 + (r & 7));
+  }
+
+  void pop(reg r) {
+    if (r >= r8) byte(0x41);
+    byte(0x58 + (r & 7));
+  }
+
+  void jmp(reg r) {
+    if (r >= r8) byte(0x41);
+    byte(0xff);
+    modrm(0b11, 4, r);
+  }
+
+  void ret() { byte(0xc3); }
+
+  /// Emits a jump with 32-bit displacement and returns
+  /// the offset of the displacement for patching.
+  auto jmp() -> size_t {
+    byte(0xe9);
+    dword(0);
+    return bytes.size() - 4;
+  }
+
+  auto jcc(condition c) -> size_t {
+    byte(0x0f);
+    byte(0x80 | c);
+    dword(0);
+    return bytes.size() - 4;
+  }
+
+  /// Lets the jump with displacement at 'site' target 'offset'.
+  void patch(size_t site, size_t offset) {
+    const auto disp = int32_t(offset - (site + 4));
+    std::memcpy(bytes.data() + site, &disp, sizeof(disp));
+  }
+
+  auto size() const noexcept { return bytes.size(); }
+
+  std::vector<uint8_t> bytes{};
+};
+
+/// Translates hot basic blocks into native x86-64 code.
+/// Translated blocks keep the guest registers they use in host registers.
+/// They are loaded on entry and written back on every exit. Exits to
+/// blocks with known targets, like branches and 'jal', are chained by
+/// patching their jump to the native code of the target block as soon as
+/// it gets translated. All other exits return to the interpreter.
+/// The code buffer is never writable and executable at the same time.
+/// Pages are only made writable while code is placed or patched.
+class jit_compiler {
+ public:
+  static constexpr size_t capacity = size_t{1} << 24;
+
+  using x86 = x86_64_code;
+
+  /// Host registers available for guest registers.
+  /// 'rdi' points to the guest registers, 'rsi' to the 'jit_state',
+  /// and 'r10' and 'r11' are used as scratch registers.
+  static constexpr std::array host_registers{
+      x86::rax, x86::rcx, x86::rdx, x86::rbx, x86::rbp, x86::r8,
+      x86::r9,  x86::r12, x86::r13, x86::r14, x86::r15,
+  };
+
+  jit_compiler() {
+    auto ptr = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) return;
+    buffer = static_cast<uint8_t*>(ptr);
+    emit_trampoline();
+    if (::mprotect(buffer, capacity, PROT_READ | PROT_EXEC) == -1) {
+      ::munmap(buffer, capacity);
+      buffer = nullptr;
+    }
+  }
+
+  jit_compiler(const jit_compiler&) = delete;
+  jit_compiler& operator=(const jit_compiler&) = delete;
+
+  ~jit_compiler() {
+    if (buffer) ::munmap(buffer, capacity);
+  }
+
+  /// Native code cannot be generated if the executable memory is missing.
+  bool available() const noexcept { return buffer != nullptr; }
+
+  /// Runs translated code starting at the given entry.
+  auto run(const void* entry, uint64_t* x, jit_state& state) const
+      -> uint64_t {
+    using function = uint64_t (*)(uint64_t*, jit_state*, const void*);
+    return reinterpret_cast<function>(buffer)(x, &state, entry);
+  }
+
+  /// Translates the block of micro-ops starting at instruction 'start'.
+  /// Returns 'nullptr' if the block cannot be translated.
+  /// Static targets equal to 'program_size' let the program halt.
+  auto compile(std::span<const micro_op> ops,
+               size_t start,
+               size_t program_size,
+               size_t memory_size) -> const void* {
+    if (!available()) return nullptr;
+    if (program_size * 4 > size_t(INT32_MAX)) return nullptr;
+
+    // The trailing halting micro-op is not an instruction.
+    size_t count = ops.size();
+    if (count && (ops.back().op == operation::halt)) --count;
+    if (!count) return nullptr;
+
+    // Assign host registers to all used guest registers.
+    std::array<int8_t, 32> host{};
+    host.fill(-1);
+    uint32_t dirty = 0;
+    size_t used = 0;
+    const auto use = [&](uint8_t r) {
+      if (!r || (host[r] != -1)) return true;
+      if (used == host_registers.size()) return false;
+      host[r] = used++;
+      return true;
+    };
+    for (size_t i = 0; i < count; ++i) {
+      const auto& op = ops[i];
+      switch (op.op) {
+        case operation::add:
+          if (!use(op.rs2)) return nullptr;
+          [[fallthrough]];
+        case operation::addi:
+        case operation::ld:
+        case operation::jalr:
+          if (!use(op.rs1)) return nullptr;
+          [[fallthrough]];
+        case operation::jal:
+          if (!use(op.rd)) return nullptr;
+          if (op.rd) dirty |= uint32_t{1} << op.rd;
+          break;
+        case operation::bne:
+          if (!use(op.rs1) || !use(op.rs2)) return nullptr;
+          break;
+        default:
+          return nullptr;
+      }
+      if ((op.op == operation::ld) && (memory_size < 8)) return nullptr;
+    }
+
+    x86 c{};
+    const auto base = buffer + size;
+    const auto reg = [&](uint8_t r) { return host_registers[host[r]]; };
+    const auto read = [&](x86::reg dst, uint8_t r) {
+      if (r)
+        c.mov(dst, reg(r));
+      else
+        c.zero(dst);
+    };
+    const auto write = [&](uint8_t r, x86::reg src) {
+      if (r) c.mov(reg(r), src);
+    };
+    const auto write_back = [&] {
+      for (uint8_t r = 1; r < 32; ++r)
+        if (dirty & (uint32_t{1} << r))
+          c.store(x86::rdi, 8 * r, reg(r));
+    };
+    // Jumps to the epilogue are patched after the code has been placed.
+    std::vector<size_t> epilogue_sites{};
+    std::vector<std::pair<size_t, size_t>> chain_sites{};
+    const auto exit_to = [&](size_t target) {
+      write_back();
+      chain_sites.push_back({c.jmp(), target});
+      c.mov_eax(target);
+      epilogue_sites.push_back(c.jmp());
+    };
+    const auto stop = [&](jit_state::status_type status, size_t pc) {
+      c.mov(x86::rsi, offsetof(jit_state, status), status);
+      c.mov_eax(pc);
+      epilogue_sites.push_back(c.jmp());
+    };
+
+    // Leave the block to the interpreter if the budget is not sufficient.
+    c.cmp(x86::rsi, offsetof(jit_state, budget), count);
+    const auto bail_site = c.jcc(x86::below);
+    c.sub(x86::rsi, offsetof(jit_state, budget), count);
+    for (uint8_t r = 1; r < 32; ++r)
+      if (host[r] != -1) c.load(reg(r), x86::rdi, 8 * r);
+
+    std::vector<std::pair<size_t, size_t>> fault_sites{};
+    for (size_t i = 0; i < count; ++i) {
+      const auto& op = ops[i];
+      const auto pc = start + i;
+      switch (op.op) {
+        case operation::add:
+          read(x86::r11, op.rs1);
+          if (op.rs2) c.add(x86::r11, reg(op.rs2));
+          write(op.rd, x86::r11);
+          break;
+        case operation::addi:
+          read(x86::r11, op.rs1);
+          if (op.imm) c.add(x86::r11, op.imm);
+          write(op.rd, x86::r11);
+          break;
+        case operation::ld:
+          read(x86::r11, op.rs1);
+          if (op.imm) c.add(x86::r11, op.imm);
+          c.cmp(x86::r11, x86::rsi, offsetof(jit_state, memory_limit));
+          fault_sites.push_back({c.jcc(x86::above), pc});
+          c.add(x86::r11, x86::rsi, offsetof(jit_state, memory));
+          c.load_indirect(x86::r11, x86::r11);
+          write(op.rd, x86::r11);
+          break;
+        case operation::bne: {
+          read(x86::r10, op.rs1);
+          read(x86::r11, op.rs2);
+          c.cmp(x86::r10, x86::r11);
+          const auto taken = c.jcc(x86::not_equal);
+          exit_to(pc + 1);
+          c.patch(taken, c.size());
+          exit_to(op.imm);
+          break;
+        }
+        case operation::jal:
+          if (op.rd) c.mov(reg(op.rd), int32_t((pc + 1) * 4));
+          exit_to(op.imm);
+          break;
+        case operation::jalr:
+          // The interpreter checks the target and writes the link.
+          read(x86::r11, op.rs1);
+          if (op.imm) c.add(x86::r11, op.imm);
+          c.and_(x86::r11, -2);
+          c.store(x86::rsi, offsetof(jit_state, address), x86::r11);
+          c.mov(x86::rsi, offsetof(jit_state, link), op.rd);
+          write_back();
+          stop(jit_state::dynamic_jump, pc);
+          break;
+        default:
+          break;
+      }
+    }
+    // Blocks without jump at the end fall through to the halting address.
+    const auto last = ops[count - 1].op;
+    if ((last != operation::bne) && (last != operation::jal) &&
+        (last != operation::jalr))
+      exit_to(start + count);
+
+    c.patch(bail_site, c.size());
+    c.mov_eax(start);
+    epilogue_sites.push_back(c.jmp());
+
+    for (auto [site, pc] : fault_sites) {
+      c.patch(site, c.size());
+      c.store(x86::rsi, offsetof(jit_state, address), x86::r11);
+      write_back();
+      stop(jit_state::memory_fault, pc);
+    }
+
+    if (size + c.size() > capacity) return nullptr;
+
+    // Place the code and resolve jumps to the epilogue and chained blocks.
+    const auto offset = size_t(base - buffer);
+    const auto waiting = pending.find(start);
+    auto first = offset;
+    if (waiting != pending.end())
+      for (auto site : waiting->second) first = std::min(first, site);
+    if (!unprotect(first, offset + c.size())) return nullptr;
+    for (auto site : epilogue_sites) c.patch(site, epilogue - offset);
+    std::memcpy(base, c.bytes.data(), c.size());
+    size += c.size();
+    for (auto [site, target] : chain_sites) {
+      const auto it = entries.find(target);
+      if (it != entries.end())
+        patch(offset + site, it->second);
+      else
+        pending[target].push_back(offset + site);
+    }
+
+    // Chain all blocks that have been waiting for this one.
+    entries[start] = offset;
+    if (waiting != pending.end()) {
+      for (auto site : waiting->second) patch(site, offset);
+      pending.erase(waiting);
+    }
+    protect(first, offset + c.size());
+    return base;
+  }
+
+ private:
+  /// Page range of the buffer that contains the bytes [first, last).
+  static auto pages(size_t first, size_t last) -> std::pair<size_t, size_t> {
+    static const auto page_size = size_t(::sysconf(_SC_PAGESIZE));
+    const auto begin = first & ~(page_size - 1);
+    const auto end = (last + page_size - 1) & ~(page_size - 1);
+    return {begin, std::min(end, capacity) - begin};
+  }
+
+  /// Makes the bytes [first, last) writable and not executable.
+  bool unprotect(size_t first, size_t last) {
+    const auto [offset, length] = pages(first, last);
+    return ::mprotect(buffer + offset, length, PROT_READ | PROT_WRITE) == 0;
+  }
+
+  /// Makes the bytes [first, last) executable and not writable.
+  void protect(size_t first, size_t last) {
+    const auto [offset, length] = pages(first, last);
+    if (::mprotect(buffer + offset, length, PROT_READ | PROT_EXEC) == -1)
+      throw std::runtime_error(
+          "Failed to make native code of the JIT compiler executable.");
+  }
+
+  void patch(size_t site, size_t target) {
+    const auto disp = int32_t(target - (site + 4));
+    std::memcpy(buffer + site, &disp, sizeof(disp));
+  }
+
+  /// Entry code saves callee-saved registers and jumps to the block given
+  /// as third argument. All blocks return through the shared epilogue.
+  void emit_trampoline() {
+    x86 c{};
+    constexpr std::array saved{x86::rbx, x86::rbp, x86::r12,
+                               x86::r13, x86::r14, x86::r15};
+    for (auto r : saved) c.push(r);
+    c.jmp(x86::rdx);
+    epilogue = c.size();
+    for (auto it = saved.rbegin(); it != saved.rend(); ++it) c.pop(*it);
+    c.ret();
+    std::memcpy(buffer, c.bytes.data(), c.size());
+    size = c.size();
+  }
+
+  uint8_t* buffer = nullptr;
+  size_t size = 0;
+  size_t epilogue = 0;
+  // Offsets of translated blocks by their first instruction.
+  std::unordered_map<size_t, size_t> entries{};
+  // Chain sites waiting for the translation of their target block.
+  std::unordered_map<size_t, std::vector<size_t>> pending{};
+};
+
+#endif
+
+}  // namespace lyrahgames::riscv
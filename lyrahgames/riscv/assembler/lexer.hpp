@@ -2,6 +2,7 @@
 #include <cstdint>
 //
 #include <map>
+#include <memory_resource>
 #include <optional>
 #include <stdexcept>
 #include <string>
@@ -12,6 +13,7 @@
 #include <iomanip>
 #include <iostream>
 //
+#include <lyrahgames/riscv/assembler/int_literal.hpp>
 #include <lyrahgames/riscv/assembler/token.hpp>
 #include <lyrahgames/riscv/assembler/utility.hpp>
 
@@ -22,15 +24,21 @@ struct lexer {
   using char_type = char;
   using char_traits = stream::traits_type;
   using int_type = typename char_traits::int_type;
-  using identifier = std::string;
-  using int_literal = int;
-  using separator = char;
-  using token = std::variant<std::monostate, char, std::string, int>;
+  using identifier = riscv::identifier;
+  using int_literal = riscv::int_literal;
+  using separator = riscv::separator;
+  using token = riscv::token;
 
-  lexer(std::istream& s) : source{s} {}
+  lexer(std::istream& s,
+        std::pmr::memory_resource* r = std::pmr::get_default_resource())
+      : source{s}, text_buffer{r}, text_storage{r} {}
 
   operator bool() { return !eof_reached; }
 
+  /// Frees the characters of all identifiers returned so far.
+  /// Their views must not be used afterwards.
+  void release_identifiers() noexcept { text_storage.release(); }
+
   static constexpr bool is_null(int_type c) { return c == int_type('\0'); }
 
   static constexpr bool is_eof(int_type c) { return c == char_traits::eof(); }
@@ -133,6 +141,8 @@ struct lexer {
     return c == int_type('\'');
   }
 
+  static constexpr bool is_quote(int_type c) { return c == int_type('"'); }
+
   static constexpr bool is_line_comment_start(int_type first, int_type second) {
     return (first == int_type('/')) && (second == int_type('/'));
   }
@@ -195,73 +205,54 @@ struct lexer {
     return true;
   }
 
-  auto identifier_match() -> std::optional<std::string> {
+  /// Matches an identifier and copies its characters into the storage of
+  /// the lexer. The returned view stays valid for the lifetime of the lexer.
+  auto identifier_match() -> std::optional<identifier> {
     // First character must not be a digit and string should not be empty.
     if (!is_identifier_start(source.peek())) return {};
-    std::string result{};
-    result += char(source.get());
+    text_buffer.clear();
+    text_buffer += char(source.get());
     // Following characters can also include digits.
     while (!is_lexeme_end(source.peek())) {
       if (!is_identifier_tail(source.peek())) return {};
-      result += char(source.get());
+      text_buffer += char(source.get());
     }
-    return result;
+    if (text_buffer.size() > token::max_identifier_size)
+      throw std::runtime_error("Failed to match too long identifier.");
+    const auto data =
+        static_cast<char*>(text_storage.allocate(text_buffer.size(), 1));
+    text_buffer.copy(data, text_buffer.size());
+    return identifier{data, text_buffer.size()};
   }
 
-  auto int_literal_match() -> std::optional<int> {
-    // Sign Extension
-    bool sign = false;
-    if (is_plus(source.peek()))
-      source.ignore();
-    else if (is_minus(source.peek())) {
-      sign = true;
-      source.ignore();
-    }
-
-    // First Digit
-    if (!is_digit(source.peek())) return {};
-    int result = digit(source.get());
-
-    // Number Base Decision
-    int base = 10;
-    auto base_digit = decimal_digit;
-    bool started = true;
-    if (!result) {
-      if (is_hexadecimal_prefix(source.peek())) {
-        base = 16;
-        base_digit = hexadecimal_digit;
-        source.ignore();
-        started = false;
-      } else if (is_binary_prefix(source.peek())) {
-        base = 2;
-        base_digit = binary_digit;
-        source.ignore();
-        started = false;
-      } else if (is_octal_prefix(source.peek())) {
-        base = 8;
-        base_digit = octal_digit;
-        source.ignore();
-        started = false;
-      }
-    }
-
-    // The break condition could be generalized.
-    while (!started || !is_lexeme_end(source.peek())) {
-      // Allow simple prime character to separate numbers anywhere.
-      if (is_number_separator(source.peek())) {
-        source.ignore();
-        started = false;
-        continue;
-      }
-      // Get the digit and calculate the number.
-      const auto digit = base_digit(source.peek());
-      if (!digit) return {};
-      result = base * result + digit.value();
-      source.ignore();
-      started = true;
-    }
-    result = sign ? -result : result;
+  /// Matches a string literal that ends at the next double quote on the
+  /// same line and copies its characters like for identifiers.
+  auto string_literal_match() -> std::optional<string_literal> {
+    if (!is_quote(source.peek())) return {};
+    source.ignore();
+    text_buffer.clear();
+    while (!is_quote(source.peek()) && !is_line_comment_end(source.peek()))
+      text_buffer += char(source.get());
+    if (!is_quote(source.peek()))
+      throw std::runtime_error("Failed to match end of string literal.");
+    source.ignore();
+    if (text_buffer.size() > token::max_identifier_size)
+      throw std::runtime_error("Failed to match too long string literal.");
+    const auto data =
+        static_cast<char*>(text_storage.allocate(text_buffer.size(), 1));
+    text_buffer.copy(data, text_buffer.size());
+    return string_literal{{data, text_buffer.size()}};
+  }
 
+  /// Matches an integer literal by copying the characters of the lexeme
+  /// into a buffer that is parsed as a whole.
+  auto int_literal_match() -> std::optional<int_literal> {
+    text_buffer.clear();
+    while (!is_lexeme_end(source.peek())) text_buffer += char(source.get());
+    czstring_iterator it = text_buffer.data();
+    const auto last = it + text_buffer.size();
+    const auto result = parse_int_literal(it, last);
+    if (!result || (it != last)) return {};
     return result;
   }
 
@@ -284,8 +275,9 @@ struct lexer {
         return token{'\n'};
       }
       newline_started = false;
-      if (is_separator(source.peek())) return token{char(source.get())};
+      if (is_separator(source.peek())) return token{separator(source.get())};
       if (const auto m = identifier_match()) return m.value();
+      if (const auto m = string_literal_match()) return m.value();
       if (const auto m = int_literal_match()) return m.value();
       return {};
     }
@@ -294,29 +286,10 @@ struct lexer {
   bool newline_started = true;
   bool eof_reached = false;
   stream& source;
-  std::string line_buffer;
-  std::vector<token> token_buffer;
+  std::pmr::string text_buffer;
+  std::pmr::monotonic_buffer_resource text_storage;
 };
 
-inline std::ostream& operator<<(std::ostream& os, const lexer::token& t) {
-  using namespace std;
-  struct {
-    void operator()(std::monostate s) const { os << "end"; }
-    void operator()(std::string id) const { os << "id: " << id; }
-    void operator()(int n) const { os << "int: " << n; }
-    void operator()(char c) const {
-      if (c == '\n')
-        os << "\\n";
-      else
-        os << c;
-    }
-    std::ostream& os;
-  } printer{os};
-  os << " [";
-  visit(printer, t);
-  return os << "] ";
-}
-
 }  // namespace lyrahgames::riscv
 
 #include <lyrahgames/riscv/assembler/lexer.ipp>
@@ -0,0 +1,79 @@
+#pragma once
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+//
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lyrahgames::riscv {
+
+/// Read-only memory mapping of a whole file.
+/// The content can be accessed as one contiguous character buffer
+/// and is meant to be handed to 'buffer_lexer' without any copies.
+class mapped_file {
+ public:
+  mapped_file() = default;
+
+  explicit mapped_file(const std::filesystem::path& path) {
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+      throw std::runtime_error("Failed to open file '" + path.string() +
+                               "' for memory mapping.");
+
+    struct stat info {};
+    if (::fstat(fd, &info) == -1) {
+      ::close(fd);
+      throw std::runtime_error("Failed to get size of file '" +
+                               path.string() + "'.");
+    }
+    size = info.st_size;
+
+    // Empty files cannot be mapped but are valid input.
+    if (size) {
+      auto ptr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Failed to memory map file '" +
+                                 path.string() + "'.");
+      }
+      data = static_cast<const char*>(ptr);
+      // The source will be read sequentially from front to back.
+      ::madvise(ptr, size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+  }
+
+  ~mapped_file() noexcept { unmap(); }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  mapped_file(mapped_file&& x) noexcept
+      : data{std::exchange(x.data, nullptr)}, size{std::exchange(x.size, 0)} {}
+
+  mapped_file& operator=(mapped_file&& x) noexcept {
+    std::swap(data, x.data);
+    std::swap(size, x.size);
+    return *this;
+  }
+
+  auto view() const noexcept -> std::string_view { return {data, size}; }
+  operator std::string_view() const noexcept { return view(); }
+
+ private:
+  void unmap() noexcept {
+    if (data) ::munmap(const_cast<char*>(data), size);
+    data = nullptr;
+    size = 0;
+  }
+
+  const char* data = nullptr;
+  size_t size = 0;
+};
+
+}  // namespace lyrahgames::riscv
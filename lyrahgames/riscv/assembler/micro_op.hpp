@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+//
+#include <lyrahgames/riscv/assembler/program.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Semantic operation of an instruction independent of its mnemonic.
+/// Overloads and pseudo instructions with the same encoding, like 'addi'
+/// and 'nop', are executed by the same operation. Branches, 'jal' and
+/// 'jalr' are the last operations before 'halt' such that they can be
+/// recognized by comparison.
+enum class operation : uint8_t {
+  // OP and OP-IMM
+  add, sub, sll, slt, sltu, xor_, srl, sra, or_, and_,
+  addi, slti, sltiu, xori, ori, andi, slli, srli, srai,
+  // OP-32 and OP-IMM-32
+  addw, subw, sllw, srlw, sraw, addiw, slliw, srliw, sraiw,
+  lui, auipc,
+  lb, lh, lw, ld, lbu, lhu, lwu,
+  sb, sh, sw, sd,
+  beq, bne, blt, bge, bltu, bgeu,
+  jal, jalr,
+  halt
+};
+
+constexpr auto operation_count = size_t(operation::halt) + 1;
+
+/// Conditional branches whose immediate is a static target.
+constexpr bool is_branch(operation op) noexcept {
+  return (operation::beq <= op) && (op <= operation::bgeu);
+}
+
+/// Operations after which execution does not continue with the next one.
+constexpr bool ends_block(operation op) noexcept {
+  return (operation::beq <= op) && (op <= operation::jalr);
+}
+
+/// Returns the operation that executes instructions with the given encoding.
+/// Only the instructions of the RV64I base are supported.
+inline auto operation_of(const instruction_encoding& e) -> operation {
+  using enum operation;
+  constexpr auto none = halt;
+  const auto pick = [&](std::initializer_list<operation> ops) {
+    return (e.funct3 < ops.size()) ? ops.begin()[e.funct3] : none;
+  };
+  auto result = none;
+  switch (e.opcode) {
+    case 0b0110011:
+      if (e.funct7 == 0)
+        result = pick({add, sll, slt, sltu, xor_, srl, or_, and_});
+      else if (e.funct7 == 0b0100000)
+        result = pick({sub, none, none, none, none, sra});
+      break;
+    case 0b0010011:
+      result = pick({addi, slli, slti, sltiu, xori,
+                     (e.funct7 == 0b0100000) ? srai : srli, ori, andi});
+      break;
+    case 0b0111011:
+      if (e.funct7 == 0)
+        result = pick({addw, sllw, none, none, none, srlw});
+      else if (e.funct7 == 0b0100000)
+        result = pick({subw, none, none, none, none, sraw});
+      break;
+    case 0b0011011:
+      result = pick({addiw, slliw, none, none, none,
+                     (e.funct7 == 0b0100000) ? sraiw : srliw});
+      break;
+    case 0b0110111:
+      result = lui;
+      break;
+    case 0b0010111:
+      result = auipc;
+      break;
+    case 0b0000011:
+      result = pick({lb, lh, lw, ld, lbu, lhu, lwu});
+      break;
+    case 0b0100011:
+      result = pick({sb, sh, sw, sd});
+      break;
+    case 0b1100011:
+      result = pick({beq, bne, none, none, blt, bge, bltu, bgeu});
+      break;
+    case 0b1101111:
+      result = jal;
+      break;
+    case 0b1100111:
+      if (e.funct3 == 0) result = jalr;
+      break;
+  }
+  if (result == none)
+    throw std::runtime_error("Instruction with opcode " +
+                             std::to_string(e.opcode) +
+                             " is not supported by the interpreter.");
+  return result;
+}
+
+/// Pre-decoded instruction of fixed size.
+/// Register operands are plain indices and the immediate is sign-extended.
+/// For branches and jumps, the immediate is the target instruction index.
+/// For 'lui' and 'auipc', it is already shifted into the upper bits.
+/// The handler is the address of the code that executes the operation.
+struct micro_op {
+  const void* handler;
+  operation op;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  int32_t imm;
+};
+
+static_assert(sizeof(micro_op) == 16);
+
+}  // namespace lyrahgames::riscv
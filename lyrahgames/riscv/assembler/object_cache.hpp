@@ -0,0 +1,324 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+//
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+//
+#include <lyrahgames/riscv/assembler/mapped_file.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Identifies the output of the assembler for a given source.
+/// It is part of every cache key and has to be changed whenever the same
+/// source and options may result in another object file.
+inline constexpr std::string_view object_cache_version =
+    "lyrahgames-riscv 0.1.0 rv64gc elf 2";
+
+/// Fast 64-bit hash of a byte sequence for content-addressed storage.
+/// Four independent lanes consume 32 bytes per step with one multiplication
+/// per eight bytes. The lanes are combined and mixed by the finalizer of
+/// SplitMix64. It is not meant to withstand deliberate collisions.
+inline auto content_hash(std::string_view bytes, uint64_t seed = 0) noexcept
+    -> uint64_t {
+  constexpr uint64_t k0 = 0x9e3779b97f4a7c15u;
+  constexpr uint64_t k1 = 0xbf58476d1ce4e5b9u;
+  constexpr uint64_t k2 = 0x94d049bb133111ebu;
+  const auto load = [](const char* p) {
+    uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    return x;
+  };
+  const auto round = [](uint64_t h, uint64_t x) {
+    return std::rotl(h ^ (x * k1), 31) * k0;
+  };
+
+  std::array<uint64_t, 4> lanes{seed, seed ^ k0, seed ^ k1, seed ^ k2};
+  auto p = bytes.data();
+  const auto last = p + bytes.size();
+  for (; last - p >= 32; p += 32)
+    for (size_t i = 0; i < lanes.size(); ++i)
+      lanes[i] = round(lanes[i], load(p + 8 * i));
+
+  uint64_t h = bytes.size() * k0;
+  for (auto lane : lanes) h = round(h, lane);
+  for (; last - p >= 8; p += 8) h = round(h, load(p));
+  if (p != last) {
+    uint64_t x = 0;
+    std::memcpy(&x, p, last - p);
+    h = round(h, x);
+  }
+
+  h ^= h >> 30;
+  h *= k1;
+  h ^= h >> 27;
+  h *= k2;
+  h ^= h >> 31;
+  return h;
+}
+
+/// Key of one cache entry given by the hash and the size of the source.
+/// The hash is seeded by 'object_cache_version' and the options that
+/// influence the output, like the ELF class.
+struct object_cache_key {
+  friend constexpr bool operator==(const object_cache_key&,
+                                   const object_cache_key&) noexcept = default;
+
+  /// Name of the entry in the cache directory.
+  auto file_name() const -> std::string {
+    constexpr auto digits = "0123456789abcdef";
+    std::string result(2 * 16 + 1, '-');
+    for (size_t i = 0; i < 16; ++i) {
+      result[15 - i] = digits[(hash >> (4 * i)) & 15];
+      result[32 - i] = digits[(size >> (4 * i)) & 15];
+    }
+    return result + ".o";
+  }
+
+  uint64_t hash;
+  uint64_t size;
+};
+
+inline auto object_cache_key_of(std::string_view source,
+                                std::string_view options = {})
+    -> object_cache_key {
+  const auto seed = content_hash(options, content_hash(object_cache_version));
+  return {content_hash(source, seed), source.size()};
+}
+
+/// Persistent content-addressed cache of assembled object files in one
+/// directory on a local file system. Several processes may share the same
+/// directory. Every entry is written to a unique temporary file that is
+/// renamed to its final name. Hence, readers either see a whole entry or
+/// none. Entries start with a header that repeats the key and the size of
+/// the object. Truncated or foreign files are ignored and removed.
+///
+/// Entries are memory-mapped when they are found. A hit updates the
+/// modification time of the entry. After every insertion, least recently
+/// used entries are removed until the total size of all entries does not
+/// exceed the given limit. Stale temporary files are removed as well.
+class object_cache {
+ public:
+  struct header {
+    char magic[8];
+    uint64_t hash;
+    uint64_t size;
+    uint64_t object_size;
+  };
+
+  static constexpr char magic[8] = {'r', 'v', 'o', 'b', 'j', 'c', '0', '1'};
+
+  /// Age after which temporary files are no longer written by anyone.
+  static constexpr auto stale_time = std::chrono::minutes{10};
+
+  /// Memory-mapped entry of the cache.
+  class entry {
+   public:
+    explicit entry(mapped_file f) : file{std::move(f)} {}
+
+    /// Bytes of the cached object file without the header.
+    auto object() const noexcept -> std::string_view {
+      return file.view().substr(sizeof(header));
+    }
+
+   private:
+    mapped_file file;
+  };
+
+  explicit object_cache(std::filesystem::path directory,
+                        uint64_t max_size = uint64_t{1} << 30)
+      : root{std::move(directory)}, limit{max_size} {
+    std::filesystem::create_directories(root);
+  }
+
+  auto directory() const noexcept -> const std::filesystem::path& {
+    return root;
+  }
+
+  auto max_size() const noexcept { return limit; }
+
+  /// Returns the mapped entry of the key if it exists and is valid.
+  auto find(const object_cache_key& key) const -> std::optional<entry> {
+    const auto path = root / key.file_name();
+    std::error_code error{};
+    if (!std::filesystem::is_regular_file(path, error)) return {};
+    try {
+      mapped_file file{path};
+      const auto bytes = file.view();
+      header h{};
+      if (bytes.size() >= sizeof(h)) std::memcpy(&h, bytes.data(), sizeof(h));
+      if ((bytes.size() < sizeof(h)) ||
+          (std::memcmp(h.magic, magic, sizeof(magic)) != 0) ||
+          (h.hash != key.hash) || (h.size != key.size) ||
+          (h.object_size != bytes.size() - sizeof(h))) {
+        std::filesystem::remove(path, error);
+        return {};
+      }
+      // Entries that are used stay in the cache.
+      std::filesystem::last_write_time(
+          path, std::filesystem::file_time_type::clock::now(), error);
+      return entry{std::move(file)};
+    } catch (const std::runtime_error&) {
+      // The entry may have been evicted by another process.
+      return {};
+    }
+  }
+
+  /// Stores the object given as consecutive pieces, like the segments of
+  /// an 'elf_object', under the given key and evicts old entries.
+  void insert(const object_cache_key& key,
+              std::span<const iovec> object) const {
+    uint64_t object_size = 0;
+    for (const auto& piece : object) object_size += piece.iov_len;
+    header h{};
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.hash = key.hash;
+    h.size = key.size;
+    h.object_size = object_size;
+
+    std::vector<iovec> pieces{};
+    pieces.reserve(object.size() + 1);
+    pieces.push_back({&h, sizeof(h)});
+    pieces.insert(pieces.end(), object.begin(), object.end());
+
+    const auto path = root / key.file_name();
+    const auto temporary = temporary_path(path);
+    write_file(temporary, pieces);
+    std::error_code error{};
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+      std::filesystem::remove(temporary, error);
+      throw std::runtime_error("Failed to store cache entry '" +
+                               path.string() + "'.");
+    }
+    evict();
+  }
+
+  void insert(const object_cache_key& key, std::string_view object) const {
+    const iovec piece{const_cast<char*>(object.data()), object.size()};
+    insert(key, std::span{&piece, 1});
+  }
+
+  /// Returns the total size of all entries in bytes.
+  auto size() const -> uint64_t {
+    uint64_t result = 0;
+    for (const auto& e : entries()) result += e.size;
+    return result;
+  }
+
+  /// Removes least recently used entries until the total size of all
+  /// entries does not exceed the limit. Entries that are concurrently
+  /// removed by other processes are skipped. Temporary files that have
+  /// been left behind by interrupted insertions are removed as well.
+  void evict() const {
+    auto list = entries(true);
+    uint64_t total = 0;
+    for (const auto& e : list) total += e.size;
+    if (total <= limit) return;
+    std::ranges::sort(list, {}, &entry_info::time);
+    for (const auto& e : list) {
+      if (total <= limit) break;
+      std::error_code error{};
+      std::filesystem::remove(e.path, error);
+      total -= e.size;
+    }
+  }
+
+ private:
+  struct entry_info {
+    std::filesystem::path path;
+    uint64_t size;
+    std::filesystem::file_time_type time;
+  };
+
+  /// Returns all entries without temporary files of unfinished insertions.
+  /// Temporary files older than 'stale_time' belong to insertions that
+  /// have been interrupted. They are removed if 'remove_stale' is set.
+  auto entries(bool remove_stale = false) const -> std::vector<entry_info> {
+    std::vector<entry_info> result{};
+    std::error_code error{};
+    const auto now = std::filesystem::file_time_type::clock::now();
+    for (const auto& e : std::filesystem::directory_iterator{root, error}) {
+      const auto temporary =
+          e.path().filename().native().find(".tmp-") != std::string::npos;
+      if (!temporary && (e.path().extension() != ".o")) continue;
+      const auto time = e.last_write_time(error);
+      if (error) continue;
+      if (temporary) {
+        if (remove_stale && (now - time > stale_time))
+          std::filesystem::remove(e.path(), error);
+        continue;
+      }
+      const auto size = e.file_size(error);
+      if (error) continue;
+      result.push_back({e.path(), size, time});
+    }
+    return result;
+  }
+
+  /// Unique name in the same directory such that renaming is atomic.
+  static auto temporary_path(const std::filesystem::path& path)
+      -> std::filesystem::path {
+    static std::atomic<uint64_t> counter = 0;
+    const auto time =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    auto result = path;
+    result += ".tmp-" + std::to_string(::getpid()) + "-" +
+              std::to_string(counter++) + "-" + std::to_string(time);
+    return result;
+  }
+
+  static void write_file(const std::filesystem::path& path,
+                         std::vector<iovec> pieces) {
+    const auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd == -1)
+      throw std::runtime_error("Failed to create cache entry '" +
+                               path.string() + "'.");
+    size_t i = 0;
+    while (i < pieces.size()) {
+      // One call must not get more than 'IOV_MAX' pieces.
+      const auto count = std::min(pieces.size() - i, size_t{IOV_MAX});
+      const auto n = ::writev(fd, pieces.data() + i, count);
+      if (n == -1) {
+        if (errno == EINTR) continue;
+        ::close(fd);
+        std::error_code error{};
+        std::filesystem::remove(path, error);
+        throw std::runtime_error("Failed to write cache entry '" +
+                                 path.string() + "'.");
+      }
+      // Skip completely written pieces and continue partial writes.
+      auto written = size_t(n);
+      for (; (i < pieces.size()) && (written >= pieces[i].iov_len); ++i)
+        written -= pieces[i].iov_len;
+      if (written) {
+        pieces[i].iov_base = static_cast<char*>(pieces[i].iov_base) + written;
+        pieces[i].iov_len -= written;
+      }
+    }
+    if (::close(fd) == -1)
+      throw std::runtime_error("Failed to write cache entry '" +
+                               path.string() + "'.");
+  }
+
+  std::filesystem::path root;
+  uint64_t limit;
+};
+
+}  // namespace lyrahgames::riscv
@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <latch>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+#include <lyrahgames/riscv/assembler/program.hpp>
+#include <lyrahgames/riscv/assembler/scan_kernel.hpp>
+#include <lyrahgames/riscv/assembler/thread_pool.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Returns the position behind the first newline at or after 'target'
+/// that is not part of a multiline comment. Scanning starts at 'first',
+/// which must not be inside a comment, and only stops at slashes.
+inline auto next_split_point(czstring_iterator first,
+                             czstring_iterator target,
+                             czstring_iterator last) -> czstring_iterator {
+  while (first < last) {
+    auto slash = static_cast<czstring_iterator>(
+        std::memchr(first, '/', last - first));
+    if (!slash) slash = last;
+    const auto start = std::max(first, target);
+    if (start < slash) {
+      const auto newline = static_cast<czstring_iterator>(
+          std::memchr(start, '\n', slash - start));
+      if (newline) return newline + 1;
+    }
+    if (slash == last) break;
+
+    if ((slash + 1 < last) && (slash[1] == '*')) {
+      first = scan_comment_end(slash + 2, last);
+      first = std::min(first + 2, last);
+    } else if ((slash + 1 < last) && (slash[1] == '/')) {
+      // The terminating newline is a valid split point.
+      first = scan_line_end(slash + 2, last);
+    } else
+      first = slash + 1;
+  }
+  return last;
+}
+
+/// Returns false if the given line is empty or only defines a label.
+/// Such lines refer to the directive of a following line.
+inline bool has_directive(std::string_view line) {
+  try {
+    buffer_lexer lexer{line};
+    auto t = lexer.next_token();
+    if (t.is_identifier()) {
+      const auto next = lexer.next_token();
+      if (!next.is_separator(':')) return true;
+      t = lexer.next_token();
+    }
+    return !t.is_end() && !t.is_separator('\n');
+  } catch (const std::runtime_error&) {
+    // The error is reported by the parser of the chunk.
+    return true;
+  }
+}
+
+/// Splits the source into at most 'chunk_count' chunks of roughly the
+/// same size. Chunks always end behind a newline and never split
+/// a multiline comment. Hence, every chunk can be lexed on its own.
+/// Chunks end behind an instruction or data directive such that labels
+/// on their own line stay in the chunk of the directive they refer to.
+inline auto split_lines(std::string_view source, size_t chunk_count)
+    -> std::vector<std::string_view> {
+  // The lexers stop at the first null character.
+  source = source.substr(0, source.find('\0'));
+  chunk_count = std::max(chunk_count, size_t{1});
+
+  std::vector<std::string_view> result{};
+  const auto first = source.data();
+  const auto last = first + source.size();
+  auto chunk_first = first;
+  for (size_t k = 1; k < chunk_count; ++k) {
+    const auto target = first + k * source.size() / chunk_count;
+    if (target <= chunk_first) continue;
+    auto split = next_split_point(chunk_first, target, last);
+    while (split != last) {
+      const auto line_last = next_split_point(split, split, last);
+      const auto line = std::string_view(split, line_last - split);
+      split = line_last;
+      if (has_directive(line)) break;
+    }
+    if (split == last) break;
+    result.emplace_back(chunk_first, split - chunk_first);
+    chunk_first = split;
+  }
+  result.emplace_back(chunk_first, last - chunk_first);
+  return result;
+}
+
+/// Appends a program that has been parsed independently to another one.
+/// Label addresses of the chunk are rebased by the number of instructions
+/// or the size of the data section that is already in the program and
+/// chunk-local label indices in operands are replaced by the indices of
+/// the program. Therefore, references across chunks are resolved by name.
+/// Like for sequential parsing, labels of data must not be defined before.
+inline void append(program& prog, const program& chunk) {
+  const auto base = prog.instructions.size();
+  const auto data_base = prog.data.size();
+
+  std::vector<label_id> ids(chunk.symbols.label_names.size());
+  for (symbol s = 0; s < ids.size(); ++s) {
+    ids[s] = prog.symbols.label_id(chunk.symbols.label_names[s],
+                                   chunk.symbols.label_names.hash(s));
+    const auto [address, data] = chunk.symbols.labels[s];
+    if (address == symbol_table::label_data::invalid) continue;
+    auto& label = prog.symbols.labels[ids[s]];
+    if (data && (label.address != symbol_table::label_data::invalid))
+      throw std::runtime_error("Redefinition of label '" +
+                               std::string(chunk.symbols.label_names[s]) +
+                               "'.");
+    label = {(data ? data_base : base) + address, data};
+  }
+  prog.data.append(chunk.data);
+
+  for (const auto instr : chunk.instructions) {
+    instruction result{instr.id};
+    for (auto op : instr.operands) {
+      if (const auto label = std::get_if<label_id>(&op)) *label = ids[*label];
+      result.operands.push_back(op);
+    }
+    prog.instructions.push_back(result);
+  }
+}
+
+/// Parses a contiguous source on multiple threads.
+/// The source is split at line boundaries and every chunk is parsed into
+/// its own program by one task of the pool. The chunks are then appended
+/// to the given program in source order. The result is the same as for
+/// sequential parsing. It must not be called from a task of the same pool.
+/// By default, every thread of the pool gets at least one chunk.
+inline void parallel_parse(std::string_view source,
+                           program& prog,
+                           thread_pool& pool,
+                           size_t chunk_count = 0) {
+  if (!chunk_count) chunk_count = pool.size();
+  const auto chunks = split_lines(source, chunk_count);
+
+  std::vector<program> results(chunks.size());
+  std::vector<size_t> lines(chunks.size());
+  std::vector<std::exception_ptr> errors(chunks.size());
+  std::latch finished{std::ptrdiff_t(chunks.size())};
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    pool.submit([&, i] {
+      try {
+        buffer_lexer lexer{chunks[i]};
+        parser parser{lexer};
+        lines[i] = parser.parse(results[i]);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+      finished.count_down();
+    });
+  }
+  finished.wait();
+
+  // Append chunks in source order such that the first error is reported
+  // like by sequential parsing. Lines of a failing chunk are counted from
+  // its start. All chunks in front of it have been parsed completely and
+  // provide the offset.
+  size_t line_offset = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (errors[i]) {
+      try {
+        std::rethrow_exception(errors[i]);
+      } catch (const parse_error& e) {
+        throw parse_error{line_offset + e.line};
+      }
+    }
+    append(prog, results[i]);
+    line_offset += lines[i];
+  }
+}
+
+}  // namespace lyrahgames::riscv
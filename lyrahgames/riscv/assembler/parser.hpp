@@ -1,29 +1,238 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
 //
+#include <lyrahgames/riscv/assembler/instrumentation.hpp>
 #include <lyrahgames/riscv/assembler/lexer.hpp>
+#include <lyrahgames/riscv/assembler/mapped_file.hpp>
 #include <lyrahgames/riscv/assembler/program.hpp>
 
 namespace lyrahgames::riscv {
 
+/// Default destination of parsed directives.
+/// It stores every instruction in the program and uses the instruction
+/// index as address of labels. Other sinks, like 'single_pass_encoder',
+/// provide the same two member functions.
+struct program_sink {
+  void define_label(size_t id) {
+    prog.symbols.labels[id] = {prog.instructions.size(), false};
+  }
+
+  void emit(instruction_view instr) { prog.instructions.push_back(instr); }
+
+  program& prog;
+};
+
+/// Sink that forwards label definitions and instructions to callbacks.
+/// Instructions are only valid during the call and have to be copied
+/// or encoded immediately.
+template <typename label_callback, typename instruction_callback>
+struct callback_sink {
+  void define_label(size_t id) { on_label(id); }
+  void emit(instruction_view instr) { on_instruction(instr); }
+
+  label_callback on_label;
+  instruction_callback on_instruction;
+};
+
+template <typename label_callback, typename instruction_callback>
+callback_sink(label_callback, instruction_callback)
+    -> callback_sink<label_callback, instruction_callback>;
+
+/// Directives that append data to the data section.
+enum class data_directive : uint8_t { none, byte, word, dword, incbin };
+
+/// Returns the data directive named by the given token.
+/// All directive names start with a dot like local labels.
+inline auto data_directive_of(const token& t) noexcept -> data_directive {
+  if (!t.is_identifier()) return data_directive::none;
+  const auto name = t.as_identifier();
+  if (!name.starts_with('.')) return data_directive::none;
+  if (name == ".byte") return data_directive::byte;
+  if (name == ".word") return data_directive::word;
+  if (name == ".dword") return data_directive::dword;
+  if (name == ".incbin") return data_directive::incbin;
+  return data_directive::none;
+}
+
+/// Number of bytes of every value of the data directive.
+constexpr auto data_size(data_directive d) noexcept -> size_t {
+  switch (d) {
+    case data_directive::byte:
+      return 1;
+    case data_directive::word:
+      return 4;
+    case data_directive::dword:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+/// Error of a line that does not match any directive.
+/// Lines are counted from zero without empty lines and lines that only
+/// contain comments.
+struct parse_error : std::runtime_error {
+  explicit parse_error(size_t l)
+      : std::runtime_error("Failed to parse directive at line " +
+                           std::to_string(l)),
+        line{l} {}
+
+  size_t line;
+};
+
+/// Fixed lookahead window over the tokens of the current line.
+/// Tokens are pulled from the lexer only when a matcher dereferences them.
+/// The window never reads beyond the end of the current line. Positions
+/// behind the terminating newline or end token yield that token again.
+/// Hence, memory use does not depend on the size of the input.
+/// Pulled tokens and the time spent in the lexer are recorded by the
+/// given instrumentation. Without instrumentation, the window does not
+/// store a pointer to it.
+template <typename lexer_type,
+          typename instrumentation_type = no_instrumentation>
+class token_window {
+ public:
+  static constexpr size_t capacity = 32;
+
+  class iterator {
+   public:
+    using value_type = token;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    iterator(token_window* w, size_t i) : window{w}, index{i} {}
+
+    auto operator*() const -> const token& { return window->at(index); }
+    auto operator->() const -> const token* { return &window->at(index); }
+
+    iterator& operator++() {
+      ++index;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      auto result = *this;
+      ++index;
+      return result;
+    }
+
+    friend iterator operator+(iterator it, difference_type n) {
+      it.index += n;
+      return it;
+    }
+
+    friend bool operator==(const iterator& x, const iterator& y) {
+      return x.index == y.index;
+    }
+
+   private:
+    friend class token_window;
+
+    token_window* window = nullptr;
+    size_t index = 0;
+  };
+
+  explicit token_window(lexer_type& l, instrumentation_type* s = nullptr)
+      : lex{l}, stats{s} {}
+
+  /// Drops the tokens of the current line.
+  /// The lexer then continues with the first token of the next line.
+  void next_line() noexcept { count = 0; }
+
+  auto begin() noexcept { return iterator{this, 0}; }
+
+  /// Drops the token at the given position and all tokens behind it.
+  /// Dereferencing the position then pulls the next token from the lexer.
+  /// Hence, lines of any length can be read through a single position.
+  void drop(iterator it) noexcept { count = std::min(count, it.index); }
+
+  auto at(size_t i) -> const token& {
+    while (count <= i) {
+      if (count && line_terminated()) return tokens[count - 1];
+      if (count == capacity)
+        throw std::runtime_error("Line exceeds lookahead window of " +
+                                 std::to_string(capacity) + " tokens.");
+      if constexpr (instrumentation_type::enabled) {
+        if (stats) {
+          [[maybe_unused]] const auto timer = stats->time(parse_stage::lexing);
+          tokens[count++] = lex.next_token();
+          stats->count_token();
+          continue;
+        }
+      }
+      tokens[count++] = lex.next_token();
+    }
+    return tokens[i];
+  }
+
+ private:
+  bool line_terminated() const noexcept {
+    const auto& t = tokens[count - 1];
+    return t.is_end() || t.is_separator('\n');
+  }
+
+  /// Empty replacement of the pointer to disabled instrumentation.
+  struct no_stats {
+    constexpr no_stats(instrumentation_type*) noexcept {}
+  };
+  using stats_pointer = std::conditional_t<instrumentation_type::enabled,
+                                           instrumentation_type*,
+                                           no_stats>;
+
+  lexer_type& lex;
+  [[no_unique_address]] stats_pointer stats;
+  std::array<token, capacity> tokens{};
+  size_t count = 0;
+};
+
+/// Parser for the token stream of any lexer front end, like 'lexer' for
+/// standard streams or 'buffer_lexer' for contiguous character buffers.
+/// Tokens are pulled from the lexer through a 'token_window' and every
+/// finished line is handed over to a sink.
+///
+/// The instrumentation is chosen at compile time. By default, nothing is
+/// recorded and no code is generated for it. With 'parse_statistics',
+/// the parser records where the time goes and reports it after parsing.
+template <typename lexer_type = lexer,
+          typename instrumentation_type = no_instrumentation>
 struct parser {
-  // using lexer = lexer;
-  using token = lexer::token;
-  using token_list = std::vector<token>;
-  using token_iterator = typename token_list::iterator;
-  using identifier = std::string;
-  using int_literal = int;
+  using token = riscv::token;
+  using window_type = token_window<lexer_type, instrumentation_type>;
+  using token_iterator = typename window_type::iterator;
+
+  parser(lexer_type& l) : lex{l}, window{l, &stats} {}
 
-  parser(lexer& l) : lex{l} {}
+  // The token window refers to the instrumentation of the parser.
+  parser(const parser&) = delete;
+  parser& operator=(const parser&) = delete;
 
   auto int_register_match(token_iterator it, token_iterator& last,
                           symbol_table& symbols)
       -> std::optional<int_register> {
-    if (!std::holds_alternative<identifier>(*it)) return {};
-    auto e = symbols.int_register_map.find(std::string(get<identifier>(*it)));
-    if (e == end(symbols.int_register_map)) return {};
+    if (!it->is_identifier()) return {};
+    stats.count_lookup(parse_lookup::int_register);
+    const auto r = symbols.find_int_register(it->as_identifier(), it->hash);
+    if (!r) return {};
     last = ++it;
-    return e->second;
+    return r;
+  }
+
+  auto float_register_match(token_iterator it, token_iterator& last,
+                            symbol_table& symbols)
+      -> std::optional<float_register> {
+    if (!it->is_identifier()) return {};
+    stats.count_lookup(parse_lookup::float_register);
+    const auto r = symbols.find_float_register(it->as_identifier(), it->hash);
+    if (!r) return {};
+    last = ++it;
+    return r;
   }
 
   auto memory_address_match(token_iterator it, token_iterator& last,
@@ -32,17 +241,16 @@ struct parser {
     memory_address result{};
     last = it;
 
-    if (holds_alternative<int_literal>(*last))
-      result.offset = get<int_literal>(*last++);
+    if (last->is_int_literal()) result.offset = (last++)->as_int_literal();
 
-    if (*last != token{'('}) return {};
+    if (!last->is_separator('(')) return {};
     ++last;
 
     const auto r = int_register_match(last, last, symbols);
     if (!r) return {};
     result.base = r.value();
 
-    if (*last != token{')'}) return {};
+    if (!last->is_separator(')')) return {};
     ++last;
 
     return result;
@@ -55,15 +263,19 @@ struct parser {
       return m.value();
     // Integer Register
     if (const auto m = int_register_match(it, last, symbols)) return m.value();
+    // Floating-Point Register
+    if (const auto m = float_register_match(it, last, symbols))
+      return m.value();
     // Integer Literal
-    if (holds_alternative<int_literal>(*it)) {
+    if (it->is_int_literal()) {
       last = it + 1;
-      return immediate(get<int_literal>(*it));
+      return immediate(it->as_int_literal());
     }
     // Label
-    if (holds_alternative<identifier>(*it)) {
+    if (it->is_identifier()) {
       last = it + 1;
-      return symbols.label_id(get<identifier>(*it));
+      stats.count_lookup(parse_lookup::label);
+      return symbols.label_id(it->as_identifier(), it->hash);
     }
 
     return {};
@@ -72,6 +284,8 @@ struct parser {
   auto operand_list_match(token_iterator it, token_iterator& last,
                           symbol_table& symbols)
       -> std::optional<operand_value_list> {
+    [[maybe_unused]] const auto timer =
+        stats.time(parse_stage::operand_matching);
     operand_value_list result{};
     // Try to match first operand.
     auto m = operand_match(it, last, symbols);
@@ -83,9 +297,10 @@ struct parser {
     // Loop for possible successive operands.
     do {
       // Store old operand in operand list.
+      if (result.full()) return {};
       result.push_back(m.value());
       // If there is no comma separator, the end is reached.
-      if (*last != token{','}) return result;
+      if (!last->is_separator(',')) return result;
       ++last;
       // When matching a comma, there has to be another operand.
       m = operand_match(last, last, symbols);
@@ -97,12 +312,12 @@ struct parser {
                          symbol_table& symbols) -> std::optional<instruction> {
     last = it;
     // First, check for an identifier token.
-    if (!holds_alternative<identifier>(*last)) return {};
+    if (!last->is_identifier()) return {};
     // Try to find entries in the instruction map with the same mnemonic.
-    const auto [first_overload, last_overload] =
-        symbols.instruction_map.equal_range(
-            std::string{get<identifier>(*last)});
-    if (distance(first_overload, last_overload) == 0) return {};
+    stats.count_lookup(parse_lookup::mnemonic);
+    const auto overloads =
+        symbols.find_instruction(last->as_identifier(), last->hash);
+    if (overloads.first == overloads.last) return {};
 
     ++last;
 
@@ -111,86 +326,191 @@ struct parser {
     if (!m) return {};
     auto& operands = m.value();
 
-    // Find the first overload that matches the operand types.
-    for (auto p = first_overload; p != last_overload; ++p) {
-      const auto overload_index = p->second;
-      const auto& overload_types =
-          symbols.instructions[overload_index].operands;
-      // Check the size.
-      if (operands.size() != overload_types.size()) continue;
-      // Check the types.
-      bool check = true;
-      for (size_t i = 0; i < operands.size(); ++i) {
-        if (operands[i].index() != static_cast<size_t>(overload_types[i])) {
-          check = false;
-          break;
-        }
-      }
-      // Return instruction constructed from valid overload.
-      if (check) return {{overload_index, operands}};
+    // The operand types select the overload by one table lookup.
+    [[maybe_unused]] const auto timer =
+        stats.time(parse_stage::overload_resolution);
+    stats.count_lookup(parse_lookup::overload);
+    const auto id = symbols.find_overload(overloads, operands.signature());
+    if (id == symbol_table::no_overload) {
+      stats.count_failed_overload();
+      return {};
     }
-    // No overload could be found.
-    return {};
+    return {{id, operands}};
   }
 
   auto label_definition_match(token_iterator it, token_iterator& last,
                               program& prog) -> std::optional<label_id> {
     last = it;
-    if (!holds_alternative<identifier>(*last)) return {};
+    if (!last->is_identifier()) return {};
     ++last;
-    if (*last != token{':'}) return {};
+    if (!last->is_separator(':')) return {};
     ++last;
-    const auto id = prog.symbols.label_id(get<identifier>(*it));
-    prog.symbols.labels[id].address = prog.instructions.size();
-    return id;
+    stats.count_lookup(parse_lookup::label);
+    return prog.symbols.label_id(it->as_identifier(), it->hash);
   }
 
-  bool directive_match(token_iterator it, token_iterator& last, program& prog) {
+  /// Matches a data directive and appends its values to the data section
+  /// of the program. Values of '.byte', '.word' and '.dword' are read in
+  /// one loop through a single position of the token window. Hence, lists
+  /// may have any length. The file of '.incbin' is memory-mapped and only
+  /// referenced by the data section. Its content is never lexed.
+  bool data_directive_match(token_iterator it,
+                            token_iterator& last,
+                            program& prog) {
+    const auto directive = data_directive_of(*it);
+    if (directive == data_directive::none) return false;
+    last = it + 1;
+
+    if (directive == data_directive::incbin) {
+      if (!last->is_string_literal()) return false;
+      prog.data.append(mapped_file{std::string(last->as_string_literal())});
+      ++last;
+      return true;
+    }
+
+    const auto size = data_size(directive);
+    const auto bits = 8 * size;
+    while (true) {
+      if (!last->is_int_literal()) return false;
+      const auto value = last->as_int_literal();
+      if ((size < 8) && ((value < -(immediate{1} << (bits - 1))) ||
+                         (value >= (immediate{1} << bits))))
+        throw std::runtime_error("Value " + std::to_string(value) +
+                                 " does not fit into " +
+                                 std::to_string(bits) + " bits.");
+      prog.data.append(uint64_t(value), size);
+      window.drop(last);
+      if (!last->is_separator(',')) return true;
+      window.drop(last);
+    }
+  }
+
+  /// Hands over labels of preceding lines without anything else on them.
+  template <typename sink_type>
+  void define_pending_labels(sink_type& sink) {
+    if (pending_labels.empty()) return;
+    [[maybe_unused]] const auto timer = stats.time(parse_stage::emission);
+    for (const auto label : pending_labels) sink.define_label(label);
+    pending_labels.clear();
+  }
+
+  /// Labels of data are defined in the symbol table directly and
+  /// therefore have to be checked like by the single-pass encoder.
+  static void define_data_label(program& prog,
+                                label_id label,
+                                size_t address) {
+    auto& data = prog.symbols.labels[label];
+    if (data.address != symbol_table::label_data::invalid)
+      throw std::runtime_error("Redefinition of label '" +
+                               std::string(prog.symbols.label_names[label]) +
+                               "'.");
+    data = {address, true};
+  }
+
+  /// Matches one line consisting of an optional label definition and
+  /// an optional instruction or data directive. Labels and instructions
+  /// are handed over to the given sink. Labels in front of data directives
+  /// refer to the data and are defined in the symbol table directly.
+  /// Labels on their own line refer to the next instruction or data
+  /// directive, like in 'table:' followed by '.word 1' on the next line.
+  template <typename sink_type>
+  bool directive_match(token_iterator it,
+                       token_iterator& last,
+                       program& prog,
+                       sink_type& sink) {
     auto optlabel = label_definition_match(it, last, prog);
     if (!optlabel) last = it;
+    if (data_directive_of(*last) != data_directive::none) {
+      const auto address = prog.data.size();
+      for (const auto label : pending_labels)
+        define_data_label(prog, label, address);
+      pending_labels.clear();
+      if (optlabel) define_data_label(prog, optlabel.value(), address);
+      if (!data_directive_match(last, last, prog)) return false;
+      if (!last->is_separator('\n')) return false;
+      ++last;
+      return true;
+    }
+    if (optlabel && last->is_separator('\n')) {
+      pending_labels.push_back(optlabel.value());
+      ++last;
+      return true;
+    }
+    define_pending_labels(sink);
+    if (optlabel) {
+      [[maybe_unused]] const auto timer = stats.time(parse_stage::emission);
+      sink.define_label(optlabel.value());
+    }
     auto optinstr = instruction_match(last, last, prog.symbols);
-    if (optinstr) prog.instructions.push_back(optinstr.value());
+    if (optinstr) {
+      [[maybe_unused]] const auto timer = stats.time(parse_stage::emission);
+      sink.emit(optinstr.value());
+    }
     if (!(bool(optlabel) || bool(optinstr))) return false;
-    if (*last != token{'\n'}) return false;
+    if (!last->is_separator('\n')) return false;
     ++last;
     return true;
   }
 
-  void prefetch_token_line() {
-    token_buffer.clear();
-    token t;
-    do {
-      t = lex.next_token();
-      token_buffer.push_back(t);
-    } while ((t != token{}) && (t != token{'\n'}));
+  bool directive_match(token_iterator it, token_iterator& last, program& prog) {
+    program_sink sink{prog};
+    return directive_match(it, last, prog, sink);
   }
 
-  void parse(program& prog) {
-    int i = 0;
+  /// Parses the whole input. Labels are added to the symbol table of the
+  /// given program while label definitions and instructions go to the sink.
+  /// Labels at the end of the input refer to the end of the text.
+  /// Returns the number of parsed lines, counted like for 'parse_error'.
+  template <typename sink_type>
+  auto parse(program& prog, sink_type& sink) -> size_t {
+    stats.start();
+    pending_labels.clear();
+    size_t i = 0;
     while (lex) {
-      prefetch_token_line();
-      auto it = token_buffer.begin();
-      if (*it == token{}) break;
-      auto success = directive_match(it, it, prog);
-      if (!success)
-        throw std::runtime_error("Failed to parse directive at line " +
-                                 std::to_string(i));
+      // Identifiers of the previous line are not referenced anymore.
+      window.next_line();
+      lex.release_identifiers();
+      auto it = window.begin();
+      if (it->is_end()) break;
+      auto success = directive_match(it, it, prog, sink);
+      if (!success) throw parse_error{i};
+      stats.count_line();
       ++i;
     }
+    define_pending_labels(sink);
+    stats.finish();
+    return i;
   }
 
-  lexer& lex;
-  token_list token_buffer{};
+  auto parse(program& prog) -> size_t {
+    program_sink sink{prog};
+    return parse(prog, sink);
+  }
+
+  [[no_unique_address]] instrumentation_type stats{};
+  lexer_type& lex;
+  window_type window;
+  std::vector<label_id> pending_labels{};
 };
 
 inline auto int_register_match(token_iterator it, token_iterator& last,
                                symbol_table& symbols)
     -> std::optional<int_register> {
-  if (!std::holds_alternative<identifier>(*it)) return {};
-  auto e = symbols.int_register_map.find(std::string(get<identifier>(*it)));
-  if (e == end(symbols.int_register_map)) return {};
+  if (!it->is_identifier()) return {};
+  const auto r = symbols.find_int_register(it->as_identifier(), it->hash);
+  if (!r) return {};
   last = ++it;
-  return e->second;
+  return r;
+}
+
+inline auto float_register_match(token_iterator it, token_iterator& last,
+                                 symbol_table& symbols)
+    -> std::optional<float_register> {
+  if (!it->is_identifier()) return {};
+  const auto r = symbols.find_float_register(it->as_identifier(), it->hash);
+  if (!r) return {};
+  last = ++it;
+  return r;
 }
 
 inline auto memory_address_match(token_iterator it, token_iterator& last,
@@ -199,17 +519,16 @@ inline auto memory_address_match(token_iterator it, token_iterator& last,
   memory_address result{};
   last = it;
 
-  if (holds_alternative<int_literal>(*last))
-    result.offset = get<int_literal>(*last++);
+  if (last->is_int_literal()) result.offset = (last++)->as_int_literal();
 
-  if (*last != token{'('}) return {};
+  if (!last->is_separator('(')) return {};
   ++last;
 
   const auto r = int_register_match(last, last, symbols);
   if (!r) return {};
   result.base = r.value();
 
-  if (*last != token{')'}) return {};
+  if (!last->is_separator(')')) return {};
   ++last;
 
   return result;
@@ -222,15 +541,17 @@ inline auto operand_match(token_iterator it, token_iterator& last,
   if (const auto m = memory_address_match(it, last, symbols)) return m.value();
   // Integer Register
   if (const auto m = int_register_match(it, last, symbols)) return m.value();
+  // Floating-Point Register
+  if (const auto m = float_register_match(it, last, symbols)) return m.value();
   // Integer Literal
-  if (holds_alternative<int_literal>(*it)) {
+  if (it->is_int_literal()) {
     last = it + 1;
-    return immediate(get<int_literal>(*it));
+    return immediate(it->as_int_literal());
   }
   // Label
-  if (holds_alternative<identifier>(*it)) {
+  if (it->is_identifier()) {
     last = it + 1;
-    return symbols.label_id(get<identifier>(*it));
+    return symbols.label_id(it->as_identifier(), it->hash);
   }
 
   return {};
@@ -250,9 +571,10 @@ inline auto operand_list_match(token_iterator it, token_iterator& last,
   // Loop for possible successive operands.
   do {
     // Store old operand in operand list.
+    if (result.full()) return {};
     result.push_back(m.value());
     // If there is no comma separator, the end is reached.
-    if (*last != token{','}) return result;
+    if (!last->is_separator(',')) return result;
     ++last;
     // When matching a comma, there has to be another operand.
     m = operand_match(last, last, symbols);
@@ -265,11 +587,11 @@ inline auto instruction_match(token_iterator it, token_iterator& last,
     -> std::optional<instruction> {
   last = it;
   // First, check for an identifier token.
-  if (!holds_alternative<identifier>(*last)) return {};
+  if (!last->is_identifier()) return {};
   // Try to find entries in the instruction map with the same mnemonic.
-  const auto [first_overload, last_overload] =
-      symbols.instruction_map.equal_range(std::string{get<identifier>(*last)});
-  if (distance(first_overload, last_overload) == 0) return {};
+  const auto overloads =
+      symbols.find_instruction(last->as_identifier(), last->hash);
+  if (overloads.first == overloads.last) return {};
 
   ++last;
 
@@ -278,35 +600,20 @@ inline auto instruction_match(token_iterator it, token_iterator& last,
   if (!m) return {};
   auto& operands = m.value();
 
-  // Find the first overload that matches the operand types.
-  for (auto p = first_overload; p != last_overload; ++p) {
-    const auto overload_index = p->second;
-    const auto& overload_types = symbols.instructions[overload_index].operands;
-    // Check the size.
-    if (operands.size() != overload_types.size()) continue;
-    // Check the types.
-    bool check = true;
-    for (size_t i = 0; i < operands.size(); ++i) {
-      if (operands[i].index() != static_cast<size_t>(overload_types[i])) {
-        check = false;
-        break;
-      }
-    }
-    // Return instruction constructed from valid overload.
-    if (check) return {{overload_index, operands}};
-  }
-  // No overload could be found.
-  return {};
+  // The operand types select the overload by one table lookup.
+  const auto id = symbols.find_overload(overloads, operands.signature());
+  if (id == symbol_table::no_overload) return {};
+  return {{id, operands}};
 }
 
 inline auto label_definition_match(token_iterator it, token_iterator& last,
                                    program& prog) -> std::optional<label_id> {
   last = it;
-  if (!holds_alternative<identifier>(*last)) return {};
+  if (!last->is_identifier()) return {};
   ++last;
-  if (*last != token{':'}) return {};
+  if (!last->is_separator(':')) return {};
   ++last;
-  const auto id = prog.symbols.label_id(get<identifier>(*it));
+  const auto id = prog.symbols.label_id(it->as_identifier(), it->hash);
   prog.symbols.labels[id].address = prog.instructions.size();
   return id;
 }
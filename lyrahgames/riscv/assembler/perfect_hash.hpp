@@ -0,0 +1,124 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+//
+#include <lyrahgames/riscv/assembler/string_pool.hpp>
+
+namespace lyrahgames::riscv {
+
+/// Immutable map from strings to values that is built at compile time.
+/// The 'string_hash' of every key selects a bucket and the constructor
+/// searches for every bucket, starting with the largest one, a seed that
+/// maps all of its keys to free slots. Such a hash-and-displace scheme finds
+/// perfect hash functions for hundreds of keys, like all mnemonics of a full
+/// instruction set, while the load factor stays high. A lookup with a
+/// precomputed hash needs one seed access, one slot access and one string
+/// comparison.
+template <typename T, size_t N>
+class perfect_hash_map {
+ public:
+  using key_type = std::string_view;
+  using mapped_type = T;
+  using value_type = std::pair<key_type, mapped_type>;
+
+  /// Keep the load factor at or below one half and use about two keys
+  /// per bucket to find seeds fast.
+  static constexpr size_t slot_bits = std::bit_width(N) + 1;
+  static constexpr size_t slot_count = size_t{1} << slot_bits;
+  static constexpr size_t bucket_bits = std::bit_width(N / 2);
+  static constexpr size_t bucket_count = size_t{1} << bucket_bits;
+  static constexpr uint16_t empty = -1;
+  static_assert(N < empty);
+
+  struct entry {
+    key_type key;
+    uint32_t hash;
+    mapped_type value;
+  };
+
+  constexpr perfect_hash_map(const std::array<value_type, N>& list) {
+    for (size_t i = 0; i < N; ++i)
+      entries[i] = {list[i].first, string_hash(list[i].first), list[i].second};
+
+    // Place large buckets first while most slots are free.
+    std::array<uint16_t, bucket_count> sizes{};
+    for (const auto& e : entries) ++sizes[bucket(e.hash)];
+    std::array<uint16_t, bucket_count> order{};
+    for (size_t b = 0; b < bucket_count; ++b) order[b] = b;
+    std::ranges::sort(order, [&](auto x, auto y) {
+      return (sizes[x] != sizes[y]) ? (sizes[x] > sizes[y]) : (x < y);
+    });
+
+    slots.fill(empty);
+    for (auto b : order)
+      if (sizes[b] && !place_bucket(b))
+        // Only reachable at compile time and then a compile error.
+        throw std::logic_error("Failed to find perfect hash function.");
+  }
+
+  constexpr auto size() const noexcept { return N; }
+
+  static constexpr auto bucket(uint32_t hash) noexcept -> size_t {
+    return (uint64_t{hash * 0x9e3779b9u} << bucket_bits) >> 32;
+  }
+
+  static constexpr auto slot(uint32_t hash, uint32_t seed) noexcept
+      -> size_t {
+    return (uint64_t{(hash ^ seed) * 0x85ebca6bu} << slot_bits) >> 32;
+  }
+
+  constexpr auto slot(uint32_t hash) const noexcept -> size_t {
+    return slot(hash, seeds[bucket(hash)]);
+  }
+
+  /// Returns a pointer to the mapped value or 'nullptr' if the key is unknown.
+  constexpr auto find(key_type key, uint32_t hash) const noexcept
+      -> const mapped_type* {
+    const auto i = slots[slot(hash)];
+    if (i == empty) return nullptr;
+    const auto& e = entries[i];
+    if ((e.hash != hash) || (e.key != key)) return nullptr;
+    return &e.value;
+  }
+
+  constexpr auto find(key_type key) const noexcept {
+    return find(key, string_hash(key));
+  }
+
+  constexpr auto begin() const noexcept { return entries.begin(); }
+  constexpr auto end() const noexcept { return entries.end(); }
+
+ private:
+  /// Searches a seed that maps all keys of the bucket to free slots.
+  constexpr bool place_bucket(size_t b) {
+    for (uint32_t k = 0; k < (1u << 16); ++k) {
+      const uint32_t seed = k * 0x9e3779b9u;
+      bool free = true;
+      for (size_t i = 0; free && (i < N); ++i) {
+        if (bucket(entries[i].hash) != b) continue;
+        const auto s = slot(entries[i].hash, seed);
+        free = (slots[s] == empty);
+        if (free) slots[s] = i;
+      }
+      if (free) {
+        seeds[b] = seed;
+        return true;
+      }
+      // Keys of the bucket may collide with each other. Undo them.
+      for (auto& s : slots)
+        if ((s != empty) && (bucket(entries[s].hash) == b)) s = empty;
+    }
+    return false;
+  }
+
+  std::array<entry, N> entries{};
+  std::array<uint32_t, bucket_count> seeds{};
+  std::array<uint16_t, slot_count> slots{};
+};
+
+}  // namespace lyrahgames::riscv
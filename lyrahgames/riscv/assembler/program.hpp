@@ -1,13 +1,28 @@
 #pragma once
-#include <map>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
+#include <initializer_list>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <variant>
 #include <vector>
 //
 #include <bitset>
 #include <iomanip>
 #include <iostream>
 //
+#include <lyrahgames/riscv/assembler/data_section.hpp>
+#include <lyrahgames/riscv/assembler/isa.hpp>
+#include <lyrahgames/riscv/assembler/perfect_hash.hpp>
+#include <lyrahgames/riscv/assembler/string_pool.hpp>
+#include <lyrahgames/riscv/assembler/token.hpp>
 #include <lyrahgames/riscv/assembler/utility.hpp>
 
 namespace lyrahgames::riscv {
@@ -96,6 +111,50 @@ inline std::ostream& operator<<(std::ostream& os, int_register r) {
   return os << 'x' << int(r.code) << "[" << std::bitset<5>(r.code) << "]";
 }
 
+/// Register of the F and D extensions.
+struct float_register {
+  friend constexpr auto operator<=>(const float_register&,
+                                    const float_register&) noexcept = default;
+  uint8_t code{};
+};
+
+constexpr float_register f0{0};
+constexpr float_register f1{1};
+constexpr float_register f2{2};
+constexpr float_register f3{3};
+constexpr float_register f4{4};
+constexpr float_register f5{5};
+constexpr float_register f6{6};
+constexpr float_register f7{7};
+constexpr float_register f8{8};
+constexpr float_register f9{9};
+constexpr float_register f10{10};
+constexpr float_register f11{11};
+constexpr float_register f12{12};
+constexpr float_register f13{13};
+constexpr float_register f14{14};
+constexpr float_register f15{15};
+constexpr float_register f16{16};
+constexpr float_register f17{17};
+constexpr float_register f18{18};
+constexpr float_register f19{19};
+constexpr float_register f20{20};
+constexpr float_register f21{21};
+constexpr float_register f22{22};
+constexpr float_register f23{23};
+constexpr float_register f24{24};
+constexpr float_register f25{25};
+constexpr float_register f26{26};
+constexpr float_register f27{27};
+constexpr float_register f28{28};
+constexpr float_register f29{29};
+constexpr float_register f30{30};
+constexpr float_register f31{31};
+
+inline std::ostream& operator<<(std::ostream& os, float_register r) {
+  return os << 'f' << int(r.code) << "[" << std::bitset<5>(r.code) << "]";
+}
+
 struct memory_address {
   friend constexpr auto operator<=>(const memory_address&,
                                     const memory_address&) noexcept = default;
@@ -108,31 +167,74 @@ inline std::ostream& operator<<(std::ostream& os, const memory_address& m) {
   return os << m.offset << "(" << m.base << ")";
 }
 
-enum class operand_type : size_t {
-  int_register = 0,
-  int_literal,
-  memory_address,
-  label,
-};
-
 using label_id = size_t;
 
-using operand_value =
-    std::variant<int_register, immediate, memory_address, size_t>;
-using operand_value_list = std::vector<operand_value>;
-
-using operand_type_list = std::vector<operand_type>;
-const operand_type_list int_r_operand_types{operand_type::int_register,
-                                            operand_type::int_register,
-                                            operand_type::int_register};
-const operand_type_list int_i_operand_types{operand_type::int_register,
-                                            operand_type::int_register,
-                                            operand_type::int_literal};
-const operand_type_list int_b_operand_types{operand_type::int_register,
-                                            operand_type::int_register,
-                                            operand_type::label};
-const operand_type_list int_memory_operand_types{operand_type::int_register,
-                                                 operand_type::memory_address};
+using operand_value = std::
+    variant<int_register, immediate, memory_address, size_t, float_register>;
+
+/// Operands of one instruction stored in place.
+/// No instruction takes more than four operands. Hence, parsing and
+/// copying instructions does not need any dynamic allocation.
+class operand_value_list {
+ public:
+  static constexpr size_t capacity = 4;
+
+  using value_type = operand_value;
+  using const_iterator = const operand_value*;
+
+  constexpr operand_value_list() noexcept = default;
+
+  constexpr operand_value_list(std::initializer_list<operand_value> list) {
+    if (list.size() > capacity)
+      throw std::length_error("Too many operands for one instruction.");
+    for (const auto& x : list) push_back(x);
+  }
+
+  constexpr auto size() const noexcept -> size_t { return count; }
+  constexpr bool empty() const noexcept { return !count; }
+  constexpr bool full() const noexcept { return count == capacity; }
+
+  /// The list must not be full.
+  constexpr void push_back(const operand_value& x) noexcept {
+    types |= x.index() << (operand_type_bits * count);
+    values[count++] = x;
+  }
+
+  /// Packed operand types that are updated on every insertion.
+  constexpr auto signature() const noexcept -> operand_signature {
+    return (operand_signature(count) << operand_count_shift) | types;
+  }
+
+  constexpr auto operator[](size_t i) const noexcept -> const operand_value& {
+    return values[i];
+  }
+
+  constexpr auto data() const noexcept { return values.data(); }
+  constexpr auto begin() const noexcept -> const_iterator { return data(); }
+  constexpr auto end() const noexcept -> const_iterator {
+    return data() + count;
+  }
+
+  constexpr operator std::span<const operand_value>() const noexcept {
+    return {data(), size()};
+  }
+
+  friend constexpr bool operator==(const operand_value_list& x,
+                                   const operand_value_list& y) noexcept {
+    return std::equal(x.begin(), x.end(), y.begin(), y.end());
+  }
+
+  friend constexpr auto operator<=>(const operand_value_list& x,
+                                    const operand_value_list& y) noexcept {
+    return std::lexicographical_compare_three_way(x.begin(), x.end(),
+                                                  y.begin(), y.end());
+  }
+
+ private:
+  std::array<operand_value, capacity> values{};
+  uint8_t count = 0;
+  uint16_t types = 0;
+};
 
 inline std::ostream& operator<<(std::ostream& os, const operand_value& op) {
   using namespace std;
@@ -141,6 +243,7 @@ inline std::ostream& operator<<(std::ostream& os, const operand_value& op) {
     void operator()(immediate n) const { os << n; }
     void operator()(memory_address c) const { os << c; }
     void operator()(size_t c) const { os << '$' << c; }
+    void operator()(float_register id) const { os << id; }
     std::ostream& os;
   } printer{os};
   visit(printer, op);
@@ -148,7 +251,7 @@ inline std::ostream& operator<<(std::ostream& os, const operand_value& op) {
 }
 
 inline std::ostream& operator<<(std::ostream& os,
-                                const operand_value_list& oplist) {
+                                std::span<const operand_value> oplist) {
   using namespace std;
   if (oplist.empty()) return os;
   auto it = begin(oplist);
@@ -157,113 +260,393 @@ inline std::ostream& operator<<(std::ostream& os,
   return os;
 }
 
+inline std::ostream& operator<<(std::ostream& os,
+                                const operand_value_list& oplist) {
+  return os << std::span<const operand_value>{oplist};
+}
+
+/// Non-owning view of an instruction with the operands stored elsewhere.
+struct instruction_view {
+  size_t id;
+  std::span<const operand_value> operands;
+};
+
 struct instruction {
   friend inline auto operator<=>(const instruction&,
                                  const instruction&) noexcept = default;
 
+  operator instruction_view() const noexcept { return {id, operands}; }
+
   size_t id;
   operand_value_list operands{};
 };
 
-inline std::ostream& operator<<(std::ostream& os, const instruction& instr) {
+inline std::ostream& operator<<(std::ostream& os, instruction_view instr) {
   using namespace std;
   return os << setw(5) << instr.id << " " << instr.operands;
 }
 
-struct symbol_table {
-  struct label_data {
-    static constexpr size_t invalid = -1;
-    size_t address;
-  };
+inline std::ostream& operator<<(std::ostream& os, const instruction& instr) {
+  return os << instruction_view(instr);
+}
+
+/// Structure-of-arrays storage for the instructions of a program.
+/// Overload ids are stored in one array and the operands of all
+/// instructions are stored consecutively in one shared arena.
+/// Instructions are accessed through 'instruction_view'.
+class instruction_list {
+ public:
+  instruction_list() = default;
+
+  explicit instruction_list(std::pmr::memory_resource* r)
+      : ids{r}, offsets{r}, operand_values{r} {}
+
+  class iterator {
+   public:
+    using value_type = instruction_view;
+    using reference = instruction_view;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    iterator(const instruction_list* l, size_t i) : list{l}, index{i} {}
+
+    auto operator*() const -> instruction_view { return (*list)[index]; }
+
+    iterator& operator++() {
+      ++index;
+      return *this;
+    }
 
-  struct instruction_data {
-    operand_type_list operands;
+    iterator operator++(int) {
+      auto result = *this;
+      ++index;
+      return result;
+    }
+
+    friend bool operator==(const iterator&, const iterator&) = default;
+
+   private:
+    const instruction_list* list = nullptr;
+    size_t index = 0;
   };
 
-  auto label_id(identifier id) -> size_t {
-    auto label = std::string(id);
-    auto search = label_map.find(label);
-
-    // Label has not been inserted, yet.
-    if (search == end(label_map)) {
-      auto index = labels.size();
-      label_map.emplace(std::move(label), index);
-      // Address of label is currently not known.
-      labels.push_back({label_data::invalid});
-      return index;
+  auto size() const noexcept -> size_t { return ids.size(); }
+  bool empty() const noexcept { return ids.empty(); }
+
+  void reserve(size_t instruction_count, size_t operand_count = 0) {
+    ids.reserve(instruction_count);
+    offsets.reserve(instruction_count);
+    operand_values.reserve(operand_count);
+  }
+
+  void clear() noexcept {
+    ids.clear();
+    offsets.clear();
+    operand_values.clear();
+  }
+
+  void push_back(instruction_view instr) {
+    ids.push_back(instr.id);
+    offsets.push_back(operand_values.size());
+    operand_values.insert(operand_values.end(), instr.operands.begin(),
+                          instr.operands.end());
+  }
+
+  auto id(size_t i) const noexcept -> size_t { return ids[i]; }
+
+  auto operands(size_t i) const noexcept -> std::span<const operand_value> {
+    const auto first = offsets[i];
+    const auto last =
+        (i + 1 < offsets.size()) ? offsets[i + 1] : operand_values.size();
+    return {operand_values.data() + first, last - first};
+  }
+
+  auto operator[](size_t i) const noexcept -> instruction_view {
+    return {id(i), operands(i)};
+  }
+
+  auto begin() const noexcept { return iterator{this, 0}; }
+  auto end() const noexcept { return iterator{this, size()}; }
+
+  friend bool operator==(const instruction_list&,
+                         const instruction_list&) = default;
+
+ private:
+  std::pmr::vector<uint32_t> ids{};
+  std::pmr::vector<uint32_t> offsets{};
+  std::pmr::vector<operand_value> operand_values{};
+};
+
+/// Perfect hash function for the operand signatures of one mnemonic.
+/// The mask selects the slot inside the table of the mnemonic.
+struct signature_hash {
+  constexpr auto slot(operand_signature s) const noexcept -> size_t {
+    return ((s * multiplier) >> 16) & mask;
+  }
+
+  uint32_t multiplier = 0;
+  uint32_t mask = 0;
+};
+
+/// Half-open range of indices into 'instruction_table' that
+/// contains all overloads of the same mnemonic. Overloads are found by
+/// their operand signature in the slots of 'overload_table' that start
+/// at 'table'.
+struct overload_range {
+  size_t first = 0;
+  size_t last = 0;
+  uint32_t table = 0;
+  signature_hash hash{};
+};
+
+/// Slot of 'overload_table' with the overload of one operand signature.
+struct overload_slot {
+  static constexpr operand_signature none = -1;
+  operand_signature signature = none;
+  uint16_t id = -1;
+};
+
+/// Description of all instruction overloads that are known to the
+/// assembler. Overloads of the same mnemonic are stored consecutively.
+/// The table is generated at compile time from 'isa_extension'. Hence,
+/// adding an extension costs neither initialization nor copies at runtime.
+inline constexpr const auto& instruction_table = rv64gc::table;
+
+/// Mnemonic of every entry in 'instruction_table'.
+inline constexpr const auto& instruction_names = rv64gc::names;
+
+/// Returns a perfect hash function for the operand signatures of the
+/// given overloads. Overloads with the same signature share their slot.
+/// Tables are as small as possible to keep all of them in few cache lines.
+constexpr auto signature_hash_of(size_t first, size_t last)
+    -> signature_hash {
+  for (uint32_t size = std::bit_ceil(last - first);; size *= 2) {
+    for (uint32_t k = 1; k < (1u << 12); ++k) {
+      const signature_hash h{(k * 0x9e3779b9u) | 1u, size - 1};
+      bool perfect = true;
+      for (auto i = first; perfect && (i < last); ++i) {
+        const auto s = instruction_table[i].signature;
+        for (auto j = first; perfect && (j < i); ++j) {
+          const auto t = instruction_table[j].signature;
+          perfect = (s == t) || (h.slot(s) != h.slot(t));
+        }
+      }
+      if (perfect) return h;
     }
+  }
+}
 
-    return search->second;
+inline constexpr size_t mnemonic_count = [] {
+  size_t result = 0;
+  for (size_t i = 0; i < std::size(instruction_names); ++i)
+    result += (i == 0) || (instruction_names[i] != instruction_names[i - 1]);
+  return result;
+}();
+
+/// All mnemonics with their overloads and signature hash functions.
+inline constexpr auto mnemonic_overloads = [] {
+  std::array<std::pair<std::string_view, overload_range>, mnemonic_count>
+      result{};
+  for (size_t i = 0, j = 0; i < std::size(instruction_names); ++i) {
+    if ((i != 0) && (instruction_names[i] != instruction_names[i - 1])) ++j;
+    if (result[j].first.empty()) result[j] = {instruction_names[i], {i, i}};
+    result[j].second.last = i + 1;
   }
+  uint32_t table = 0;
+  for (auto& [name, overloads] : result) {
+    overloads.table = table;
+    overloads.hash = signature_hash_of(overloads.first, overloads.last);
+    table += overloads.hash.mask + 1;
+  }
+  return result;
+}();
+
+/// Signature tables of all mnemonics stored consecutively.
+/// If overloads share their signature, the first one is used.
+inline constexpr auto overload_table = [] {
+  constexpr auto size = [] {
+    size_t result = 0;
+    for (const auto& [name, overloads] : mnemonic_overloads)
+      result += overloads.hash.mask + 1;
+    return result;
+  }();
+  std::array<overload_slot, size> result{};
+  for (const auto& [name, overloads] : mnemonic_overloads) {
+    for (auto i = overloads.first; i < overloads.last; ++i) {
+      const auto s = instruction_table[i].signature;
+      auto& slot = result[overloads.table + overloads.hash.slot(s)];
+      if (slot.signature == overload_slot::none) slot = {s, uint16_t(i)};
+    }
+  }
+  return result;
+}();
 
-  std::vector<label_data> labels{};
-  std::map<std::string, size_t> label_map{};
+/// Compile-time map from mnemonics to their overloads.
+inline constexpr perfect_hash_map mnemonic_map{mnemonic_overloads};
 
-  const std::map<std::string, int_register> int_register_map{
-      {"x0", x0},     {"x1", x1},   {"x2", x2},   {"x3", x3},   {"x4", x4},
-      {"x5", x5},     {"x6", x6},   {"x7", x7},   {"x8", x8},   {"x9", x9},
-      {"x10", x10},   {"x11", x11}, {"x12", x12}, {"x13", x13}, {"x14", x14},
-      {"x15", x15},   {"x16", x16}, {"x17", x17}, {"x18", x18}, {"x19", x19},
-      {"x20", x20},   {"x21", x21}, {"x22", x22}, {"x23", x23}, {"x24", x24},
-      {"x25", x25},   {"x26", x26}, {"x27", x27}, {"x28", x28}, {"x29", x29},
-      {"x30", x30},   {"x31", x31},
+/// Compile-time map from register names and their ABI aliases to registers.
+inline constexpr perfect_hash_map int_register_map{
+    std::to_array<std::pair<std::string_view, int_register>>({
+        {"x0", x0},   {"x1", x1},   {"x2", x2},   {"x3", x3},
+        {"x4", x4},   {"x5", x5},   {"x6", x6},   {"x7", x7},
+        {"x8", x8},   {"x9", x9},   {"x10", x10}, {"x11", x11},
+        {"x12", x12}, {"x13", x13}, {"x14", x14}, {"x15", x15},
+        {"x16", x16}, {"x17", x17}, {"x18", x18}, {"x19", x19},
+        {"x20", x20}, {"x21", x21}, {"x22", x22}, {"x23", x23},
+        {"x24", x24}, {"x25", x25}, {"x26", x26}, {"x27", x27},
+        {"x28", x28}, {"x29", x29}, {"x30", x30}, {"x31", x31},
 
-      {"zero", zero},
+        {"zero", zero},
 
-      {"ra", ra},     {"sp", sp},   {"gp", gp},   {"tp", tp},
+        {"ra", ra},   {"sp", sp},   {"gp", gp},   {"tp", tp},
 
-      {"t0", t0},     {"t1", t1},   {"t2", t2},
+        {"t0", t0},   {"t1", t1},   {"t2", t2},
 
-      {"fp", fp},
+        {"fp", fp},
 
-      {"s0", s0},     {"s1", s1},
+        {"s0", s0},   {"s1", s1},
 
-      {"a0", a0},     {"a1", a1},   {"a2", a2},   {"a3", a3},   {"a4", a4},
-      {"a5", a5},     {"a6", a6},   {"a7", a7},
+        {"a0", a0},   {"a1", a1},   {"a2", a2},   {"a3", a3},
+        {"a4", a4},   {"a5", a5},   {"a6", a6},   {"a7", a7},
 
-      {"s2", s2},     {"s3", s3},   {"s4", s4},   {"s5", s5},   {"s6", s6},
-      {"s7", s7},     {"s8", s8},   {"s9", s9},   {"s10", s10}, {"s11", s11},
+        {"s2", s2},   {"s3", s3},   {"s4", s4},   {"s5", s5},
+        {"s6", s6},   {"s7", s7},   {"s8", s8},   {"s9", s9},
+        {"s10", s10}, {"s11", s11},
 
-      {"t3", t3},     {"t4", t4},   {"t5", t5},   {"t6", t6},
-  };
+        {"t3", t3},   {"t4", t4},   {"t5", t5},   {"t6", t6},
+    })};
 
-  std::vector<instruction_data> instructions{
-      /* add */ {int_r_operand_types},
-      /* add */ {int_i_operand_types},
-      /* addi */ {int_i_operand_types},
-      /* bne */ {int_b_operand_types},
-      /* ld */ {int_memory_operand_types},
-      /* call */ {{operand_type::label}},
-      /* nop */ {{}},
-      /* ret */ {{}},
-  };
-  std::multimap<std::string, size_t> instruction_map{
-      {"add", 0}, {"add", 1},  {"addi", 2}, {"bne", 3},
-      {"ld", 4},  {"call", 5}, {"nop", 6},  {"ret", 7},
+/// Compile-time map from floating-point register names and their ABI
+/// aliases to registers.
+inline constexpr perfect_hash_map float_register_map{
+    std::to_array<std::pair<std::string_view, float_register>>({
+        {"f0", f0},     {"f1", f1},     {"f2", f2},     {"f3", f3},
+        {"f4", f4},     {"f5", f5},     {"f6", f6},     {"f7", f7},
+        {"f8", f8},     {"f9", f9},     {"f10", f10},   {"f11", f11},
+        {"f12", f12},   {"f13", f13},   {"f14", f14},   {"f15", f15},
+        {"f16", f16},   {"f17", f17},   {"f18", f18},   {"f19", f19},
+        {"f20", f20},   {"f21", f21},   {"f22", f22},   {"f23", f23},
+        {"f24", f24},   {"f25", f25},   {"f26", f26},   {"f27", f27},
+        {"f28", f28},   {"f29", f29},   {"f30", f30},   {"f31", f31},
+
+        {"ft0", f0},    {"ft1", f1},    {"ft2", f2},    {"ft3", f3},
+        {"ft4", f4},    {"ft5", f5},    {"ft6", f6},    {"ft7", f7},
+
+        {"fs0", f8},    {"fs1", f9},
+
+        {"fa0", f10},   {"fa1", f11},   {"fa2", f12},   {"fa3", f13},
+        {"fa4", f14},   {"fa5", f15},   {"fa6", f16},   {"fa7", f17},
+
+        {"fs2", f18},   {"fs3", f19},   {"fs4", f20},   {"fs5", f21},
+        {"fs6", f22},   {"fs7", f23},   {"fs8", f24},   {"fs9", f25},
+        {"fs10", f26},  {"fs11", f27},
+
+        {"ft8", f28},   {"ft9", f29},   {"ft10", f30},  {"ft11", f31},
+    })};
+
+struct symbol_table {
+  /// Labels of instructions store the instruction index as address.
+  /// Labels of data store the byte offset into the data section.
+  struct label_data {
+    static constexpr size_t invalid = -1;
+    size_t address;
+    bool data = false;
   };
+
+  using instruction_data = riscv::instruction_data;
+  using overload_range = riscv::overload_range;
+
+  symbol_table() = default;
+
+  explicit symbol_table(std::pmr::memory_resource* r)
+      : labels{r}, label_names{r} {}
+
+  static constexpr std::span<const instruction_data> instructions{
+      instruction_table};
+
+  static auto find_int_register(identifier id, uint32_t hash)
+      -> std::optional<int_register> {
+    const auto r = int_register_map.find(id, hash);
+    if (!r) return {};
+    return *r;
+  }
+
+  /// All names of floating-point registers start with 'f'. Other
+  /// identifiers, like labels, are rejected without a lookup.
+  static auto find_float_register(identifier id, uint32_t hash)
+      -> std::optional<float_register> {
+    if (!id.starts_with('f')) return {};
+    const auto r = float_register_map.find(id, hash);
+    if (!r) return {};
+    return *r;
+  }
+
+  static auto find_instruction(identifier id, uint32_t hash)
+      -> overload_range {
+    const auto r = mnemonic_map.find(id, hash);
+    if (!r) return {};
+    return *r;
+  }
+
+  static constexpr size_t no_overload = -1;
+
+  /// Returns the overload of a known mnemonic that takes operands of the
+  /// given signature or 'no_overload' by one access to 'overload_table'.
+  static auto find_overload(const overload_range& overloads,
+                            operand_signature s) noexcept -> size_t {
+    const auto& slot = overload_table[overloads.table + overloads.hash.slot(s)];
+    if (slot.signature != s) return no_overload;
+    return slot.id;
+  }
+
+  /// Returns the index of the given label.
+  /// Labels are interned and their index equals their symbol in 'label_names'.
+  auto label_id(identifier id, uint32_t hash) -> size_t {
+    const auto [s, inserted] = label_names.insert(id, hash);
+    // Address of label is currently not known.
+    if (inserted) labels.push_back({label_data::invalid});
+    return s;
+  }
+
+  auto label_id(identifier id) -> size_t {
+    return label_id(id, string_hash(id));
+  }
+
+  std::pmr::vector<label_data> labels{};
+  string_pool label_names{};
 };
 
 inline std::ostream& operator<<(std::ostream& os, const symbol_table& symbols) {
   using namespace std;
-  for (auto [label, index] : symbols.label_map)
-    os << setw(15) << label << ": " << setw(5) << index << '\n';
+  for (symbol s = 0; s < symbols.label_names.size(); ++s)
+    os << setw(15) << symbols.label_names[s] << ": " << setw(5) << s << '\n';
   for (size_t i = 0; i < symbols.labels.size(); ++i)
     os << setw(5) << i << ": " << setw(10) << symbols.labels[i].address << '\n';
   return os;
 }
 
+/// All containers of a program allocate from the given memory resource.
+/// Typically, this is an arena, like 'std::pmr::monotonic_buffer_resource',
+/// that is shared with the parser and the lexer of one assembly unit.
+/// Then all memory of the unit is freed at once when the arena is destroyed.
 struct program {
   friend inline auto operator<=>(const program&,
                                  const program&) noexcept = default;
 
+  program() = default;
+
+  explicit program(std::pmr::memory_resource* r)
+      : symbols{r}, instructions{r}, data{r} {}
+
   symbol_table symbols{};
-  std::vector<instruction> instructions{};
+  instruction_list instructions{};
+  data_section data{};
 };
 
 inline std::ostream& operator<<(std::ostream& os, const program& p) {
   using namespace std;
   os << p.symbols << '\n';
-  for (size_t pc = 0; auto& instr : p.instructions) {
+  for (size_t pc = 0; auto instr : p.instructions) {
     os << setw(5) << pc << ": " << instr << '\n';
     ++pc;
   }
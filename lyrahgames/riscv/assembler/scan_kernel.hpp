@@ -0,0 +1,276 @@
+#pragma once
+#include <cstdint>
+//
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LYRAHGAMES_RISCV_X86_SIMD
+#include <immintrin.h>
+#endif
+//
+#include <lyrahgames/riscv/assembler/utility.hpp>
+
+// Scanning kernels for contiguous character buffers.
+// Every kernel returns a pointer to the first character in [first, last)
+// that ends the scanned character class or 'last' if there is none.
+// The SIMD variants classify 16 or 32 bytes at once and hand over the
+// remaining tail to the scalar variant. The fastest variant supported by
+// the executing CPU is chosen once at program start.
+
+namespace lyrahgames::riscv {
+
+namespace scalar {
+
+/// Skips spaces and tabs.
+constexpr auto scan_space(czstring_iterator first, czstring_iterator last)
+    -> czstring_iterator {
+  while ((first != last) && ((*first == ' ') || (*first == '\t'))) ++first;
+  return first;
+}
+
+/// Finds the next newline or null character.
+constexpr auto scan_line_end(czstring_iterator first, czstring_iterator last)
+    -> czstring_iterator {
+  while ((first != last) && (*first != '\n') && (*first != '\0')) ++first;
+  return first;
+}
+
+/// Finds the next '*/' sequence or null character.
+constexpr auto scan_comment_end(czstring_iterator first,
+                                czstring_iterator last) -> czstring_iterator {
+  for (; first != last; ++first) {
+    if (*first == '\0') return first;
+    if ((*first == '*') && (first + 1 != last) && (first[1] == '/'))
+      return first;
+  }
+  return first;
+}
+
+/// Skips characters that are allowed inside of identifiers.
+constexpr auto scan_identifier_tail(czstring_iterator first,
+                                    czstring_iterator last)
+    -> czstring_iterator {
+  for (; first != last; ++first) {
+    const auto c = *first;
+    const bool letter = static_cast<unsigned char>((c | 0x20) - 'a') < 26;
+    const bool digit = static_cast<unsigned char>(c - '0') < 10;
+    if (!(letter || digit || (c == '.') || (c == '_'))) break;
+  }
+  return first;
+}
+
+}  // namespace scalar
+
+#ifdef LYRAHGAMES_RISCV_X86_SIMD
+
+namespace sse2 {
+
+/// Unsigned range check 'lo <= c < lo + n' with signed SSE2 comparisons.
+inline __m128i in_range(__m128i x, char lo, char n) {
+  const auto shifted = _mm_sub_epi8(x, _mm_set1_epi8(char(lo + 128)));
+  return _mm_cmplt_epi8(shifted, _mm_set1_epi8(char(n - 128)));
+}
+
+inline auto first_set(czstring_iterator p, uint32_t mask) {
+  return p + __builtin_ctz(mask);
+}
+
+inline auto scan_space(czstring_iterator first, czstring_iterator last)
+    -> czstring_iterator {
+  for (; last - first >= 16; first += 16) {
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const auto space = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+                                    _mm_cmpeq_epi8(x, _mm_set1_epi8('\t')));
+    const uint32_t mask = ~_mm_movemask_epi8(space) & 0xffff;
+    if (mask) return first_set(first, mask);
+  }
+  return scalar::scan_space(first, last);
+}
+
+inline auto scan_line_end(czstring_iterator first, czstring_iterator last)
+    -> czstring_iterator {
+  for (; last - first >= 16; first += 16) {
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const auto end = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')),
+                                  _mm_cmpeq_epi8(x, _mm_setzero_si128()));
+    const uint32_t mask = _mm_movemask_epi8(end);
+    if (mask) return first_set(first, mask);
+  }
+  return scalar::scan_line_end(first, last);
+}
+
+inline auto scan_comment_end(czstring_iterator first, czstring_iterator last)
+    -> czstring_iterator {
+  // The second load looks one character ahead.
+  for (; last - first >= 17; first += 16) {
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const auto y =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 1));
+    const auto end = _mm_or_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('*')),
+                      _mm_cmpeq_epi8(y, _mm_set1_epi8('/'))),
+        _mm_cmpeq_epi8(x, _mm_setzero_si128()));
+    const uint32_t mask = _mm_movemask_epi8(end);
+    if (mask) return first_set(first, mask);
+  }
+  return scalar::scan_comment_end(first, last);
+}
+
+inline auto scan_identifier_tail(czstring_iterator first,
+                                 czstring_iterator last) -> czstring_iterator {
+  for (; last - first >= 16; first += 16) {
+    const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const auto letter =
+        in_range(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 26);
+    const auto digit = in_range(x, '0', 10);
+    const auto other = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('.')),
+                                    _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+    const auto tail = _mm_or_si128(_mm_or_si128(letter, digit), other);
+    const uint32_t mask = ~_mm_movemask_epi8(tail) & 0xffff;
+    if (mask) return first_set(first, mask);
+  }
+  return scalar::scan_identifier_tail(first, last);
+}
+
+}  // namespace sse2
+
+namespace avx2 {
+
+#define LYRAHGAMES_RISCV_AVX2 __attribute__((target("avx2")))
+
+LYRAHGAMES_RISCV_AVX2 inline __m256i in_range(__m256i x, char lo, char n) {
+  const auto shifted = _mm256_sub_epi8(x, _mm256_set1_epi8(char(lo + 128)));
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8(char(n - 128)), shifted);
+}
+
+LYRAHGAMES_RISCV_AVX2 inline auto scan_space(czstring_iterator first,
+                                             czstring_iterator last)
+    -> czstring_iterator {
+  for (; last - first >= 32; first += 32) {
+    const auto x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    const auto space =
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')));
+    const uint32_t mask = ~uint32_t(_mm256_movemask_epi8(space));
+    if (mask) return sse2::first_set(first, mask);
+  }
+  return sse2::scan_space(first, last);
+}
+
+LYRAHGAMES_RISCV_AVX2 inline auto scan_line_end(czstring_iterator first,
+                                                czstring_iterator last)
+    -> czstring_iterator {
+  for (; last - first >= 32; first += 32) {
+    const auto x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    const auto end =
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(x, _mm256_setzero_si256()));
+    const uint32_t mask = _mm256_movemask_epi8(end);
+    if (mask) return sse2::first_set(first, mask);
+  }
+  return sse2::scan_line_end(first, last);
+}
+
+LYRAHGAMES_RISCV_AVX2 inline auto scan_comment_end(czstring_iterator first,
+                                                   czstring_iterator last)
+    -> czstring_iterator {
+  for (; last - first >= 33; first += 32) {
+    const auto x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    const auto y =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + 1));
+    const auto end = _mm256_or_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('*')),
+                         _mm256_cmpeq_epi8(y, _mm256_set1_epi8('/'))),
+        _mm256_cmpeq_epi8(x, _mm256_setzero_si256()));
+    const uint32_t mask = _mm256_movemask_epi8(end);
+    if (mask) return sse2::first_set(first, mask);
+  }
+  return sse2::scan_comment_end(first, last);
+}
+
+LYRAHGAMES_RISCV_AVX2 inline auto scan_identifier_tail(czstring_iterator first,
+                                                       czstring_iterator last)
+    -> czstring_iterator {
+  for (; last - first >= 32; first += 32) {
+    const auto x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    const auto letter =
+        in_range(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 26);
+    const auto digit = in_range(x, '0', 10);
+    const auto other =
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('.')),
+                        _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+    const auto tail = _mm256_or_si256(_mm256_or_si256(letter, digit), other);
+    const uint32_t mask = ~uint32_t(_mm256_movemask_epi8(tail));
+    if (mask) return sse2::first_set(first, mask);
+  }
+  return sse2::scan_identifier_tail(first, last);
+}
+
+#undef LYRAHGAMES_RISCV_AVX2
+
+}  // namespace avx2
+
+#endif  // LYRAHGAMES_RISCV_X86_SIMD
+
+/// Set of scanning kernels that belong to the same instruction set.
+struct scan_kernel {
+  using function = auto (*)(czstring_iterator, czstring_iterator)
+      -> czstring_iterator;
+
+  const char* name;
+  function space;
+  function line_end;
+  function comment_end;
+  function identifier_tail;
+};
+
+constexpr scan_kernel scalar_scan_kernel{
+    "scalar", scalar::scan_space, scalar::scan_line_end,
+    scalar::scan_comment_end, scalar::scan_identifier_tail};
+
+#ifdef LYRAHGAMES_RISCV_X86_SIMD
+constexpr scan_kernel sse2_scan_kernel{"sse2", sse2::scan_space,
+                                       sse2::scan_line_end,
+                                       sse2::scan_comment_end,
+                                       sse2::scan_identifier_tail};
+
+constexpr scan_kernel avx2_scan_kernel{"avx2", avx2::scan_space,
+                                       avx2::scan_line_end,
+                                       avx2::scan_comment_end,
+                                       avx2::scan_identifier_tail};
+#endif
+
+/// Returns the fastest scanning kernel supported by the executing CPU.
+inline auto best_scan_kernel() noexcept -> const scan_kernel& {
+#ifdef LYRAHGAMES_RISCV_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return avx2_scan_kernel;
+  return sse2_scan_kernel;
+#else
+  return scalar_scan_kernel;
+#endif
+}
+
+/// The scanning kernel chosen at program start.
+inline const scan_kernel& active_scan_kernel = best_scan_kernel();
+
+inline auto scan_space(czstring_iterator first, czstring_iterator last) {
+  return active_scan_kernel.space(first, last);
+}
+
+inline auto scan_line_end(czstring_iterator first, czstring_iterator last) {
+  return active_scan_kernel.line_end(first, last);
+}
+
+inline auto scan_comment_end(czstring_iterator first, czstring_iterator last) {
+  return active_scan_kernel.comment_end(first, last);
+}
+
+inline auto scan_identifier_tail(czstring_iterator first,
+                                 czstring_iterator last) {
+  return active_scan_kernel.identifier_tail(first, last);
+}
+
+}  // namespace lyrahgames::riscv
@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lyrahgames::riscv {
+
+/// Identifier of a string that has been interned by a 'string_pool'.
+using symbol = uint32_t;
+
+/// 32-bit FNV-1a hash of a string.
+/// The lexers compute this value once for every identifier token
+/// such that lookups in string pools do not need to touch the characters
+/// again unless a candidate entry has been found.
+constexpr auto string_hash(std::string_view str) noexcept -> uint32_t {
+  uint32_t hash = 2166136261u;
+  for (auto c : str) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/// Interning table for strings.
+/// Every distinct string gets a consecutive symbol starting at zero.
+/// Characters are copied into an arena of large blocks and therefore
+/// the views returned by the pool stay valid for the lifetime of the pool.
+/// Lookup uses open addressing with linear probing on precomputed hashes.
+/// All memory is taken from the given memory resource.
+class string_pool {
+ public:
+  static constexpr size_t block_size = 1 << 14;
+
+  string_pool() = default;
+
+  explicit string_pool(std::pmr::memory_resource* r)
+      : entries{r}, slots{r}, blocks{r}, resource{r} {}
+
+  string_pool(const string_pool& x) { *this = x; }
+
+  string_pool& operator=(const string_pool& x) {
+    if (this == &x) return *this;
+    clear();
+    for (symbol s = 0; s < x.size(); ++s) insert(x[s], x.hash(s));
+    return *this;
+  }
+
+  /// The new pool takes over the memory resource and the blocks of 'x'.
+  string_pool(string_pool&& x) noexcept
+      : entries{std::move(x.entries)},
+        slots{std::move(x.slots)},
+        blocks{std::move(x.blocks)},
+        block_first{std::exchange(x.block_first, nullptr)},
+        block_last{std::exchange(x.block_last, nullptr)},
+        resource{x.resource} {
+    x.entries.clear();
+    x.slots.clear();
+    x.blocks.clear();
+  }
+
+  /// Blocks can only be taken over if both pools use equal memory
+  /// resources. Otherwise, the strings of 'x' are copied.
+  string_pool& operator=(string_pool&& x) {
+    if (this == &x) return *this;
+    if (!resource->is_equal(*x.resource)) return *this = x;
+    release_blocks();
+    entries = std::move(x.entries);
+    slots = std::move(x.slots);
+    blocks = std::move(x.blocks);
+    block_first = std::exchange(x.block_first, nullptr);
+    block_last = std::exchange(x.block_last, nullptr);
+    x.entries.clear();
+    x.slots.clear();
+    x.blocks.clear();
+    return *this;
+  }
+
+  ~string_pool() { release_blocks(); }
+
+  auto size() const noexcept -> size_t { return entries.size(); }
+  bool empty() const noexcept { return entries.empty(); }
+
+  auto operator[](symbol s) const noexcept -> std::string_view {
+    return {entries[s].data, entries[s].size};
+  }
+
+  auto hash(symbol s) const noexcept -> uint32_t { return entries[s].hash; }
+
+  /// Returns the symbol of the given string if it has been inserted before.
+  auto find(std::string_view str, uint32_t hash) const noexcept
+      -> std::optional<symbol> {
+    if (slots.empty()) return {};
+    const auto mask = slots.size() - 1;
+    for (auto i = hash & mask; slots[i]; i = (i + 1) & mask) {
+      const auto s = slots[i] - 1;
+      if ((entries[s].hash == hash) && ((*this)[s] == str)) return s;
+    }
+    return {};
+  }
+
+  auto find(std::string_view str) const noexcept {
+    return find(str, string_hash(str));
+  }
+
+  /// Interns the given string and returns its symbol.
+  /// The boolean is true if the string has not been seen before.
+  auto insert(std::string_view str, uint32_t hash)
+      -> std::pair<symbol, bool> {
+    // Keep the load factor below one half.
+    if (2 * (entries.size() + 1) > slots.size()) rehash(2 * slots.size());
+
+    const auto mask = slots.size() - 1;
+    auto i = hash & mask;
+    for (; slots[i]; i = (i + 1) & mask) {
+      const auto s = slots[i] - 1;
+      if ((entries[s].hash == hash) && ((*this)[s] == str))
+        return {s, false};
+    }
+
+    const auto s = static_cast<symbol>(entries.size());
+    entries.push_back({store(str), static_cast<uint32_t>(str.size()), hash});
+    slots[i] = s + 1;
+    return {s, true};
+  }
+
+  auto insert(std::string_view str) { return insert(str, string_hash(str)); }
+
+  void clear() noexcept {
+    entries.clear();
+    slots.clear();
+    release_blocks();
+    block_first = nullptr;
+    block_last = nullptr;
+  }
+
+ private:
+  struct entry {
+    const char* data;
+    uint32_t size;
+    uint32_t hash;
+  };
+
+  void rehash(size_t count) {
+    count = std::max(count, size_t{16});
+    slots.assign(count, 0);
+    const auto mask = count - 1;
+    for (symbol s = 0; s < entries.size(); ++s) {
+      auto i = entries[s].hash & mask;
+      while (slots[i]) i = (i + 1) & mask;
+      slots[i] = s + 1;
+    }
+  }
+
+  auto store(std::string_view str) -> const char* {
+    if (str.empty()) return "";
+    if (size_t(block_last - block_first) < str.size()) {
+      const auto n = std::max(block_size, str.size());
+      block_first = static_cast<char*>(resource->allocate(n, 1));
+      block_last = block_first + n;
+      blocks.push_back({block_first, n});
+    }
+    const auto result = block_first;
+    std::memcpy(block_first, str.data(), str.size());
+    block_first += str.size();
+    return result;
+  }
+
+  void release_blocks() noexcept {
+    for (auto b : blocks) resource->deallocate(b.data(), b.size(), 1);
+    blocks.clear();
+  }
+
+  std::pmr::vector<entry> entries{};
+  std::pmr::vector<uint32_t> slots{};
+  std::pmr::vector<std::span<char>> blocks{};
+  char* block_first = nullptr;
+  char* block_last = nullptr;
+  std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+};
+
+}  // namespace lyrahgames::riscv
@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lyrahgames::riscv {
+
+/// Pool of worker threads with one task queue per worker.
+/// Workers take tasks from the back of their own queue and steal from
+/// the front of other queues when their own queue runs empty. Tasks
+/// submitted from inside a worker go to the queue of that worker.
+/// The first exception thrown by a task is rethrown by 'wait'.
+class thread_pool {
+ public:
+  using task = std::function<void()>;
+
+  explicit thread_pool(
+      size_t thread_count = std::thread::hardware_concurrency()) {
+    thread_count = std::max(thread_count, size_t{1});
+    queues.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+      queues.push_back(std::make_unique<task_queue>());
+    workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i)
+      workers.emplace_back([this, i] { run(i); });
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard lock{wake_mutex};
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers) w.join();
+  }
+
+  auto size() const noexcept { return workers.size(); }
+
+  void submit(task t) {
+    ++pending;
+    auto& q = (current_pool == this)
+                  ? *queues[current_queue]
+                  : *queues[next_queue++ % queues.size()];
+    {
+      std::lock_guard lock{q.mutex};
+      q.tasks.push_back(std::move(t));
+    }
+    {
+      std::lock_guard lock{wake_mutex};
+      ++queued;
+    }
+    wake.notify_one();
+  }
+
+  /// Blocks until all submitted tasks, including the ones
+  /// they have submitted themselves, have been finished.
+  void wait() {
+    {
+      std::unique_lock lock{done_mutex};
+      done.wait(lock, [this] { return pending == 0; });
+    }
+    if (auto e = std::exchange(error, nullptr)) std::rethrow_exception(e);
+  }
+
+ private:
+  struct task_queue {
+    std::mutex mutex{};
+    std::deque<task> tasks{};
+  };
+
+  bool pop(size_t i, task& t) {
+    auto& q = *queues[i];
+    std::lock_guard lock{q.mutex};
+    if (q.tasks.empty()) return false;
+    t = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+  }
+
+  bool steal(size_t i, task& t) {
+    for (size_t k = 1; k < queues.size(); ++k) {
+      auto& q = *queues[(i + k) % queues.size()];
+      std::lock_guard lock{q.mutex};
+      if (q.tasks.empty()) continue;
+      t = std::move(q.tasks.front());
+      q.tasks.pop_front();
+      return true;
+    }
+    return false;
+  }
+
+  void run(size_t i) {
+    current_pool = this;
+    current_queue = i;
+    task t{};
+    while (true) {
+      if (pop(i, t) || steal(i, t)) {
+        --queued;
+        try {
+          t();
+        } catch (...) {
+          std::lock_guard lock{done_mutex};
+          if (!error) error = std::current_exception();
+        }
+        t = nullptr;
+        if (--pending == 0) {
+          std::lock_guard lock{done_mutex};
+          done.notify_all();
+        }
+        continue;
+      }
+      std::unique_lock lock{wake_mutex};
+      wake.wait(lock, [this] { return stopping || queued > 0; });
+      if (stopping && queued == 0) return;
+    }
+  }
+
+  inline static thread_local const thread_pool* current_pool = nullptr;
+  inline static thread_local size_t current_queue = 0;
+
+  std::vector<std::unique_ptr<task_queue>> queues{};
+  std::vector<std::thread> workers{};
+  std::atomic<size_t> next_queue = 0;
+
+  // Number of tasks waiting in queues.
+  std::atomic<size_t> queued = 0;
+  bool stopping = false;
+  std::mutex wake_mutex{};
+  std::condition_variable wake{};
+
+  // Number of tasks that have been submitted but not yet finished.
+  std::atomic<size_t> pending = 0;
+  std::exception_ptr error{};
+  std::mutex done_mutex{};
+  std::condition_variable done{};
+};
+
+}  // namespace lyrahgames::riscv
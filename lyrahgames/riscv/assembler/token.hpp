@@ -1,10 +1,13 @@
 #pragma once
+#include <concepts>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <string_view>
-#include <variant>
+#include <type_traits>
 #include <vector>
 //
+#include <lyrahgames/riscv/assembler/string_pool.hpp>
 #include <lyrahgames/riscv/assembler/utility.hpp>
 
 namespace lyrahgames::riscv {
@@ -13,21 +16,136 @@ using identifier = std::string_view;
 using int_literal = immediate;
 using separator = char;
 
-using token = std::variant<std::monostate, identifier, int_literal, separator>;
+/// Characters between double quotes without the quotes.
+/// Escape sequences are not supported.
+struct string_literal {
+  std::string_view str;
+};
+
+enum class token_kind : uint8_t {
+  end = 0,
+  separator,
+  identifier,
+  int_literal,
+  string_literal,
+};
+
+/// Compact and trivially copyable token.
+/// Identifiers and string literals do not own their characters. They
+/// reference the source buffer or the storage of the lexer that generated
+/// them. The hash of identifiers is computed once on construction and used
+/// for all later symbol lookups. Separators
+/// and integer literals are stored in the 64-bit payload.
+struct token {
+  static constexpr size_t max_identifier_size = (size_t{1} << 24) - 1;
+
+  constexpr token() noexcept : value{0} {}
+
+  constexpr token(riscv::separator c) noexcept
+      : kind{token_kind::separator}, value{c} {}
+
+  constexpr token(riscv::identifier id) noexcept
+      : kind{token_kind::identifier},
+        size{static_cast<uint32_t>(id.size())},
+        hash{string_hash(id)},
+        data{id.data()} {}
+
+  constexpr token(czstring id) noexcept : token{riscv::identifier{id}} {}
+
+  constexpr token(riscv::string_literal s) noexcept
+      : kind{token_kind::string_literal},
+        size{static_cast<uint32_t>(s.str.size())},
+        data{s.str.data()} {}
+
+  template <std::integral T>
+  requires(!std::same_as<T, char>)  //
+      constexpr token(T n) noexcept
+      : kind{token_kind::int_literal}, value{static_cast<immediate>(n)} {}
+
+  constexpr bool is_end() const noexcept { return kind == token_kind::end; }
+
+  constexpr bool is_separator() const noexcept {
+    return kind == token_kind::separator;
+  }
+
+  constexpr bool is_separator(riscv::separator c) const noexcept {
+    return is_separator() && (value == c);
+  }
+
+  constexpr bool is_identifier() const noexcept {
+    return kind == token_kind::identifier;
+  }
+
+  constexpr bool is_int_literal() const noexcept {
+    return kind == token_kind::int_literal;
+  }
+
+  constexpr bool is_string_literal() const noexcept {
+    return kind == token_kind::string_literal;
+  }
+
+  constexpr auto as_separator() const noexcept -> riscv::separator {
+    return static_cast<riscv::separator>(value);
+  }
+
+  constexpr auto as_identifier() const noexcept -> riscv::identifier {
+    return {data, size};
+  }
+
+  constexpr auto as_int_literal() const noexcept -> riscv::int_literal {
+    return value;
+  }
+
+  constexpr auto as_string_literal() const noexcept -> std::string_view {
+    return {data, size};
+  }
+
+  friend constexpr bool operator==(const token& x, const token& y) noexcept {
+    if (x.kind != y.kind) return false;
+    if (x.is_identifier())
+      return (x.hash == y.hash) && (x.as_identifier() == y.as_identifier());
+    if (x.is_string_literal())
+      return x.as_string_literal() == y.as_string_literal();
+    return x.is_end() || (x.value == y.value);
+  }
+
+  token_kind kind : 8 = token_kind::end;
+  uint32_t size : 24 = 0;
+  uint32_t hash = 0;
+  union {
+    riscv::int_literal value;
+    czstring data;
+  };
+};
+
+static_assert(sizeof(token) <= 16);
+static_assert(std::is_trivially_copyable_v<token>);
+
 using token_list = std::vector<token>;
 using token_iterator = typename std::vector<token>::const_iterator;
 
 inline std::ostream& operator<<(std::ostream& os, const token& t) {
-  using namespace std;
-  struct {
-    void operator()(std::monostate s) const { os << "end"; }
-    void operator()(identifier id) const { os << "id: " << id; }
-    void operator()(int_literal n) const { os << "int: " << n; }
-    void operator()(separator c) const { os << c; }
-    std::ostream& os;
-  } printer{os};
   os << "<";
-  visit(printer, t);
+  switch (t.kind) {
+    case token_kind::end:
+      os << "end";
+      break;
+    case token_kind::separator:
+      if (t.is_separator('\n'))
+        os << "\\n";
+      else
+        os << t.as_separator();
+      break;
+    case token_kind::identifier:
+      os << "id: " << t.as_identifier();
+      break;
+    case token_kind::int_literal:
+      os << "int: " << t.as_int_literal();
+      break;
+    case token_kind::string_literal:
+      os << "str: \"" << t.as_string_literal() << '"';
+      break;
+  }
   return os << ">";
 }
 
@@ -0,0 +1,200 @@
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/elf.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/mapped_file.hpp>
+#include <lyrahgames/riscv/assembler/object_cache.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+#include <lyrahgames/riscv/assembler/thread_pool.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+struct options {
+  vector<filesystem::path> inputs{};
+  filesystem::path output_directory{};
+  filesystem::path cache_directory{};
+  uint64_t cache_size = uint64_t{1} << 30;
+  size_t thread_count = thread::hardware_concurrency();
+  bool elf32 = false;
+};
+
+void print_usage(ostream& os) {
+  os << "usage: riscv-as [--elf32] [-j <threads>] [-o <directory>]\n"
+        "                [--cache <directory>] [--cache-size <bytes>] "
+        "<file.s>...\n";
+}
+
+auto parse_options(int argc, char* argv[]) -> options {
+  options result{};
+  for (int i = 1; i < argc; ++i) {
+    const string_view arg = argv[i];
+    if (arg == "--elf32") {
+      result.elf32 = true;
+      continue;
+    }
+    if ((arg == "-j") || (arg == "-o") || (arg == "--cache") ||
+        (arg == "--cache-size")) {
+      if (++i == argc)
+        throw runtime_error("Missing value for option '" + string(arg) +
+                            "'.");
+      if (arg == "-j")
+        result.thread_count = stoul(argv[i]);
+      else if (arg == "-o")
+        result.output_directory = argv[i];
+      else if (arg == "--cache")
+        result.cache_directory = argv[i];
+      else
+        result.cache_size = stoull(argv[i]);
+      continue;
+    }
+    result.inputs.push_back(arg);
+  }
+  return result;
+}
+
+struct path_hash {
+  auto operator()(const filesystem::path& p) const noexcept {
+    return filesystem::hash_value(p);
+  }
+};
+
+/// The object of an input is placed next to it or in the output directory.
+auto object_path(const filesystem::path& input,
+                 const filesystem::path& output_directory)
+    -> filesystem::path {
+  auto result = input;
+  result.replace_extension(".o");
+  if (!output_directory.empty())
+    result = output_directory / result.filename();
+  return result;
+}
+
+/// Runs lexer, parser and encoder on one translation unit.
+/// All intermediate state is allocated from one arena per unit.
+/// With a cache, units whose content has been assembled before with the
+/// same options are copied from the cache instead. Units that include
+/// other files by '.incbin' are not stored because the key only covers
+/// their own content. Hence, they are never found either.
+void assemble(const filesystem::path& input,
+              const filesystem::path& output,
+              bool elf32,
+              const object_cache* cache) {
+  const mapped_file file{input};
+  object_cache_key key{};
+  if (cache) {
+    key = object_cache_key_of(file.view(), elf32 ? "elf32" : "");
+    if (const auto entry = cache->find(key)) {
+      const auto object = entry->object();
+      ofstream out{output, ios::binary | ios::trunc};
+      if (!out.write(object.data(), object.size()) || !out.flush())
+        throw runtime_error("Failed to write file '" + output.string() +
+                            "'.");
+      return;
+    }
+  }
+
+  pmr::monotonic_buffer_resource arena{};
+  program prog{&arena};
+  buffer_lexer lexer{file.view()};
+  parser parser{lexer};
+  single_pass_encoder encoder{prog.symbols, &arena};
+  parser.parse(prog, encoder);
+  const auto code = encoder.finish_relocatable();
+  const auto write = [&](const auto& object) {
+    object.write(output);
+    if (!cache || prog.data.includes_files()) return;
+    // A failing cache must not fail the assembly.
+    try {
+      cache->insert(key, object.segments());
+    } catch (const runtime_error&) {
+    }
+  };
+  if (elf32)
+    write(elf_object<elf_class::elf32>{prog.symbols, code, prog.data});
+  else
+    write(elf_object<elf_class::elf64>{prog.symbols, code, prog.data});
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  options opts{};
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const exception& e) {
+    cerr << "error: " << e.what() << '\n';
+    print_usage(cerr);
+    return EXIT_FAILURE;
+  }
+  if (opts.inputs.empty()) {
+    print_usage(cerr);
+    return EXIT_FAILURE;
+  }
+
+  // Objects of different inputs must not overwrite each other.
+  vector<filesystem::path> outputs{};
+  unordered_map<filesystem::path, size_t, path_hash> output_index{};
+  for (size_t i = 0; i < opts.inputs.size(); ++i) {
+    outputs.push_back(object_path(opts.inputs[i], opts.output_directory));
+    const auto [it, inserted] = output_index.emplace(
+        filesystem::absolute(outputs[i]).lexically_normal(), i);
+    if (inserted) continue;
+    cerr << "error: inputs '" << opts.inputs[it->second].string()
+         << "' and '" << opts.inputs[i].string()
+         << "' would be assembled into the same file '"
+         << outputs[i].string() << "'.\n";
+    return EXIT_FAILURE;
+  }
+
+  optional<object_cache> cache{};
+  if (!opts.cache_directory.empty()) {
+    try {
+      cache.emplace(opts.cache_directory, opts.cache_size);
+    } catch (const exception& e) {
+      cerr << "error: " << e.what() << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Every unit reports its own error such that all inputs are processed.
+  vector<string> errors(opts.inputs.size());
+  {
+    thread_pool pool{opts.thread_count};
+    for (size_t i = 0; i < opts.inputs.size(); ++i) {
+      pool.submit([&, i] {
+        try {
+          assemble(opts.inputs[i], outputs[i], opts.elf32,
+                   cache ? &*cache : nullptr);
+        } catch (const exception& e) {
+          errors[i] = e.what();
+        }
+      });
+    }
+    pool.wait();
+  }
+
+  // Report errors in input order to get deterministic output.
+  bool failed = false;
+  for (size_t i = 0; i < errors.size(); ++i) {
+    if (errors[i].empty()) continue;
+    cerr << opts.inputs[i].string() << ": error: " << errors[i] << '\n';
+    failed = true;
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/deprecated.hpp>
+#include <lyrahgames/riscv/assembler/elf.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/lexer.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+struct options {
+  vector<size_t> line_counts{1'000, 10'000, 100'000, 1'000'000, 10'000'000};
+  vector<string> corpora{"label", "comment", "literal", "mixed"};
+  vector<string> stages{"lexer", "buffer_lexer", "scan", "parser",
+                        "assemble"};
+  double min_time = 0.5;
+};
+
+void print_usage(ostream& os) {
+  os << "usage: riscv-bench [--lines <n,...>] [--corpus <name,...>] "
+        "[--stage <name,...>] [--min-time <seconds>]\n"
+        "corpora: label comment literal mixed\n"
+        "stages:  lexer buffer_lexer scan parser assemble\n";
+}
+
+auto split(string_view list) -> vector<string> {
+  vector<string> result{};
+  while (!list.empty()) {
+    const auto comma = list.find(',');
+    result.emplace_back(list.substr(0, comma));
+    if (comma == string_view::npos) break;
+    list.remove_prefix(comma + 1);
+  }
+  return result;
+}
+
+auto parse_options(int argc, char* argv[]) -> options {
+  options result{};
+  for (int i = 1; i < argc; ++i) {
+    const string_view arg = argv[i];
+    if (++i == argc)
+      throw runtime_error("Missing value for option '" + string(arg) + "'.");
+    if (arg == "--lines") {
+      result.line_counts.clear();
+      for (const auto& n : split(argv[i]))
+        result.line_counts.push_back(stoul(n));
+    } else if (arg == "--corpus")
+      result.corpora = split(argv[i]);
+    else if (arg == "--stage")
+      result.stages = split(argv[i]);
+    else if (arg == "--min-time")
+      result.min_time = stod(argv[i]);
+    else
+      throw runtime_error("Unknown option '" + string(arg) + "'.");
+  }
+  return result;
+}
+
+/// Deterministic generator of synthetic assembly sources.
+/// Every corpus stresses another part of the pipeline. All labels that are
+/// referenced are defined such that every corpus assembles without errors.
+class corpus_generator {
+ public:
+  static constexpr string_view registers[]{
+      "zero", "ra", "sp", "t0", "t1", "t2", "s0", "s1", "a0", "a1",
+      "a2",   "a3", "a4", "a5", "a6", "a7", "s2", "t3", "x28", "x31"};
+
+  explicit corpus_generator(string_view name) : kind{name} {
+    if ((kind != "label") && (kind != "comment") && (kind != "literal") &&
+        (kind != "mixed"))
+      throw runtime_error("Unknown corpus '" + kind + "'.");
+  }
+
+  auto generate(size_t line_count) -> string {
+    random.seed(line_count);
+    string result{};
+    result.reserve(line_count * 32);
+    for (size_t line = 0; line < line_count; ++line) {
+      if (kind == "label")
+        label_line(result, line, line_count);
+      else if (kind == "comment")
+        comment_line(result, line);
+      else if (kind == "literal")
+        literal_line(result);
+      else
+        mixed_line(result, line, line_count);
+      result += '\n';
+    }
+    return result;
+  }
+
+ private:
+  auto pick(size_t n) { return size_t(random() % n); }
+
+  auto reg() { return registers[pick(size(registers))]; }
+
+  // Labels are defined on every fourth line.
+  void label(string& s, size_t line, size_t line_count) {
+    const auto target = min(line + pick(64), line_count - 1) / 4;
+    s += "label_";
+    s += to_string(target);
+  }
+
+  void label_line(string& s, size_t line, size_t line_count) {
+    if (line % 4 == 0) {
+      s += "label_" + to_string(line / 4) + ":";
+      return;
+    }
+    if (pick(2)) {
+      s += "  bne ";
+      s += reg();
+      s += ", ";
+      s += reg();
+      s += ", ";
+    } else
+      s += "  call ";
+    label(s, line, line_count);
+  }
+
+  void comment_line(string& s, size_t line) {
+    switch (line % 4) {
+      case 0:
+        s += "// Computes the next element of the sequence.";
+        break;
+      case 1:
+        s += "  add a0, a0, a1  // Accumulate the current value.";
+        break;
+      case 2:
+        s += "/* Multiline comments may span parts of a line. */";
+        break;
+      default:
+        s += "  addi a1, a1, 8  /* Advance the pointer. */";
+    }
+  }
+
+  // Literals in all bases with and without digit separators.
+  void literal(string& s) {
+    const auto value = int(pick(4096)) - 2048;
+    const auto x = unsigned(value & 0x7ff);
+    switch (pick(4)) {
+      case 0:
+        s += to_string(value);
+        break;
+      case 1:
+        s += "0x";
+        for (int shift = 8; shift >= 0; shift -= 4)
+          s += "0123456789abcdef"[(x >> shift) & 15];
+        break;
+      case 2:
+        s += "0b";
+        for (int bit = 10; bit >= 0; --bit) {
+          s += char('0' + ((x >> bit) & 1));
+          if (bit == 4) s += '\'';
+        }
+        break;
+      default: {
+        const auto digits = to_string(abs(value));
+        if (value < 0) s += '-';
+        s += digits.substr(0, digits.size() - min<size_t>(digits.size(), 3));
+        if (digits.size() > 3) s += '\'';
+        s += digits.substr(digits.size() - min<size_t>(digits.size(), 3));
+      }
+    }
+  }
+
+  void literal_line(string& s) {
+    if (pick(2)) {
+      s += "  addi ";
+      s += reg();
+      s += ", ";
+      s += reg();
+      s += ", ";
+      literal(s);
+    } else {
+      s += "  ld ";
+      s += reg();
+      s += ", ";
+      literal(s);
+      s += "(";
+      s += reg();
+      s += ")";
+    }
+  }
+
+  void mixed_line(string& s, size_t line, size_t line_count) {
+    if (line % 4 == 0) {
+      label_line(s, line, line_count);
+      return;
+    }
+    switch (pick(8)) {
+      case 0:
+        comment_line(s, line);
+        break;
+      case 1:
+      case 2:
+        label_line(s, line, line_count);
+        break;
+      case 3:
+        s += "  add ";
+        s += reg();
+        s += ", ";
+        s += reg();
+        s += ", ";
+        s += reg();
+        break;
+      case 4:
+        s += pick(2) ? "  ret" : "  nop";
+        break;
+      default:
+        literal_line(s);
+    }
+  }
+
+  string kind;
+  mt19937_64 random{};
+};
+
+/// Runs one stage on the source and returns the number of produced items,
+/// like tokens or instructions, to keep the work observable.
+auto run_stage(string_view stage, const string& source) -> size_t {
+  if (stage == "lexer") {
+    istringstream input{source};
+    lexer lex{input};
+    size_t count = 0;
+    for (auto t = lex.next_token(); !t.is_end(); t = lex.next_token()) {
+      if (t.is_separator('\n')) lex.release_identifiers();
+      ++count;
+    }
+    return count;
+  }
+  if (stage == "buffer_lexer") {
+    buffer_lexer lex{source};
+    size_t count = 0;
+    for (auto t = lex.next_token(); !t.is_end(); t = lex.next_token())
+      ++count;
+    return count;
+  }
+  if (stage == "scan") {
+    czstring_iterator next{};
+    const auto tokens = scan(source.c_str(), next);
+    // The deprecated scanner knows no comments and stops at them.
+    if (size_t(next - source.c_str()) < source.size()) return 0;
+    return tokens.size();
+  }
+  if (stage == "parser") {
+    pmr::monotonic_buffer_resource arena{};
+    program prog{&arena};
+    buffer_lexer lex{source};
+    parser p{lex};
+    p.parse(prog);
+    return prog.instructions.size();
+  }
+  if (stage == "assemble") {
+    pmr::monotonic_buffer_resource arena{};
+    program prog{&arena};
+    buffer_lexer lex{source};
+    parser p{lex};
+    single_pass_encoder encoder{prog.symbols, &arena};
+    p.parse(prog, encoder);
+    const auto code = encoder.finish_relocatable();
+    const elf_object<> object{prog.symbols, code};
+    return object.size() ? code.text.size() : 0;
+  }
+  throw runtime_error("Unknown stage '" + string(stage) + "'.");
+}
+
+}  // namespace
+
+/// Every result is one CSV line. Times are the best of all repetitions that
+/// fit into the minimal time, which is at least one repetition.
+int main(int argc, char* argv[]) {
+  options opts{};
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const exception& e) {
+    cerr << "error: " << e.what() << '\n';
+    print_usage(cerr);
+    return EXIT_FAILURE;
+  }
+
+  try {
+    cout << "corpus,lines,bytes,stage,items,repetitions,seconds,mb_per_s,"
+            "lines_per_s\n";
+    for (const auto& name : opts.corpora) {
+      corpus_generator generator{name};
+      for (auto line_count : opts.line_counts) {
+        const auto source = generator.generate(line_count);
+        for (const auto& stage : opts.stages) {
+          using clock = chrono::steady_clock;
+          double best = 0;
+          double total = 0;
+          size_t repetitions = 0;
+          size_t items = 0;
+          do {
+            const auto start = clock::now();
+            items = run_stage(stage, source);
+            const auto end = clock::now();
+            const auto t = chrono::duration<double>(end - start).count();
+            best = repetitions ? min(best, t) : t;
+            total += t;
+            ++repetitions;
+          } while (total < opts.min_time);
+          // Stages that do not support the corpus produce no items.
+          if (!items) continue;
+          cout << name << ',' << line_count << ',' << source.size() << ','
+               << stage << ',' << items << ',' << repetitions << ',' << best
+               << ',' << source.size() / best * 1e-6 << ','
+               << line_count / best << '\n'
+               << flush;
+        }
+      }
+    }
+  } catch (const exception& e) {
+    cerr << "error: " << e.what() << '\n';
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,205 @@
+#include <stdexcept>
+#include <string>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/decoder.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto parse(const string& str) {
+  buffer_lexer l{str};
+  parser p{l};
+  program prog;
+  p.parse(prog);
+  return prog;
+}
+
+auto name_of(uint32_t word) { return instruction_names[decode_id(word)]; }
+
+}  // namespace
+
+SCENARIO("Unpacking Instruction Formats") {
+  const instruction_fields r{0b0110011, 5, 0, 6, 7, 0};
+  CHECK(unpack<instruction_format::r>(pack<instruction_format::r>(r)).rs2 ==
+        7);
+
+  for (immediate imm : {-2048, -1, 0, 1, 50, 2047}) {
+    const instruction_fields i{0b0010011, 5, 0, 6, 0, 0, imm};
+    CHECK(unpack<instruction_format::i>(pack<instruction_format::i>(i)).imm ==
+          imm);
+    const instruction_fields s{0b0100011, 0, 3, 2, 1, 0, imm};
+    CHECK(unpack<instruction_format::s>(pack<instruction_format::s>(s)).imm ==
+          imm);
+  }
+  for (immediate imm : {-4096, -12, 0, 2, 4094}) {
+    const instruction_fields b{0b1100011, 0, 1, 2, 3, 0, imm};
+    CHECK(unpack<instruction_format::b>(pack<instruction_format::b>(b)).imm ==
+          imm);
+  }
+  for (immediate imm : {-(1 << 20), -2, 0, 12, (1 << 20) - 2}) {
+    const instruction_fields j{0b1101111, 1, 0, 0, 0, 0, imm};
+    CHECK(unpack<instruction_format::j>(pack<instruction_format::j>(j)).imm ==
+          imm);
+  }
+  CHECK(unpack<instruction_format::u>(0x12345537).imm == 0x12345);
+}
+
+SCENARIO("Decoding Instruction Words") {
+  CHECK(name_of(0x007302b3) == "add");
+  CHECK(name_of(0x00a30293) == "addi");
+  CHECK(name_of(0x03213083) == "ld");
+  CHECK(name_of(0x00c000ef) == "call");
+  CHECK(name_of(0xfed51ae3) == "bne");
+  CHECK(name_of(0x00000013) == "nop");
+  CHECK(name_of(0x00008067) == "ret");
+
+  // Words that are close to known patterns.
+  CHECK(name_of(0x00000093) == "mv");
+  CHECK(name_of(0x00100093) == "li");
+  CHECK(name_of(0x00c0006f) == "j");
+  CHECK(name_of(0x00008167) == "jalr");
+  CHECK(name_of(0x407302b3) == "sub");
+  CHECK_THROWS_AS(decode_id(0xfe0302b3), runtime_error);  // funct7 of add
+  CHECK_THROWS_AS(decode_id(0x00000000), runtime_error);
+  CHECK_THROWS_AS(decode_id(0x00004501), runtime_error);  // compressed
+}
+
+SCENARIO("Round-Trip of Assembled Programs") {
+  const auto prog = parse(
+      "main:\n"
+      "      add t0, t1, t2\n"
+      "      addi t0, t1, 10\n"
+      "loop: addi a0, a0, -1\n"
+      "      ld ra, -50(sp)\n"
+      "      call test\n"
+      "      bne a0, a3, loop\n"
+      "      nop\n"
+      "test: ret\n"
+      "      bne a0, zero, end\n"
+      "end:\n");
+  const auto code = encode(prog);
+  const auto decoded = decode(code);
+  CHECK(encode(decoded) == code);
+
+  REQUIRE(decoded.instructions.size() == prog.instructions.size());
+  for (size_t i : {0, 1, 2, 3, 6, 7}) {
+    CHECK(decoded.instructions[i].id == prog.instructions[i].id);
+    CHECK(ranges::equal(decoded.instructions[i].operands,
+                        prog.instructions[i].operands));
+  }
+
+  // Targets are defined as labels named by their byte offset.
+  const auto& symbols = decoded.symbols;
+  CHECK(symbols.labels[get<label_id>(decoded.instructions[4].operands[0])]
+            .address == 7);
+  CHECK(symbols.label_names[get<label_id>(
+            decoded.instructions[5].operands[2])] == ".L8");
+  // 'bne a0, zero, end' is decoded as 'bnez a0, end'.
+  CHECK(instruction_names[decoded.instructions[8].id] == "bnez");
+  CHECK(symbols.labels[get<label_id>(decoded.instructions[8].operands[1])]
+            .address == 9);
+}
+
+SCENARIO("Round-Trip of Standard Extensions") {
+  const auto prog = parse(
+      "mul a0, a1, a2\n"
+      "remuw t0, t1, t2\n"
+      "lr.d.aq a0, (a1)\n"
+      "amoadd.w.aqrl a0, a1, (a2)\n"
+      "flw fa0, 8(sp)\n"
+      "fsd fs1, -16(s0)\n"
+      "fmadd.d fa0, fa1, fa2, fa3\n"
+      "fsgnj.s ft0, ft1, ft2\n"
+      "fmv.s ft0, ft1\n"
+      "fcvt.l.d a0, fa0\n"
+      "feq.d a0, fa0, fa1\n"
+      "csrrw a0, 0x340, a1\n"
+      "csrrsi a0, 0x300, 8\n"
+      "rdcycle a0\n"
+      "fence.i\n"
+      "slli a0, a0, 63\n"
+      "sraiw a0, a0, 31\n");
+  const auto code = encode(prog);
+  CHECK(code[0] == 0x02c58533);
+  CHECK(code[2] == 0x1405b52f);
+  CHECK(code[4] == 0x00812507);
+  CHECK(code[6] == 0x6ac5f543);
+  CHECK(code[11] == 0x34059573);
+  CHECK(code[15] == 0x03f51513);
+
+  const auto decoded = decode(code);
+  CHECK(encode(decoded) == code);
+  REQUIRE(decoded.instructions.size() == prog.instructions.size());
+  for (size_t i = 0; i < prog.instructions.size(); ++i) {
+    CAPTURE(i);
+    CHECK(decoded.instructions[i].id == prog.instructions[i].id);
+    CHECK(ranges::equal(decoded.instructions[i].operands,
+                        prog.instructions[i].operands));
+  }
+
+  // Tied fields decide between the alias and its base.
+  CHECK(name_of(code[8]) == "fmv.s");
+  CHECK(name_of(code[7]) == "fsgnj.s");
+}
+
+SCENARIO("Expanding Compressed Instructions") {
+  CHECK(expand(0x4501) == 0x00000513);  // c.li a0, 0
+  CHECK(expand(0x8082) == 0x00008067);  // c.jr ra
+  CHECK(expand(0x1141) == 0xff010113);  // c.addi sp, -16
+  CHECK(expand(0xe406) == 0x00113423);  // c.sdsp ra, 8(sp)
+  CHECK(expand(0x852e) == 0x00b00533);  // c.mv a0, a1
+  CHECK(expand(0x9002) == 0x00100073);  // c.ebreak
+  CHECK(instruction_names[decode_compressed_id(0x6105)] == "c.addi16sp");
+  CHECK(instruction_names[decode_compressed_id(0x6505)] == "c.lui");
+
+  // The all-zero parcel and reserved immediates are illegal.
+  CHECK_THROWS_AS(expand(0x0000), runtime_error);
+  CHECK_THROWS_AS(expand(0x6101), runtime_error);  // c.addi16sp sp, 0
+  CHECK_THROWS_AS(expand(0x0003), runtime_error);  // 32-bit quadrant
+}
+
+SCENARIO("Decoding Text Sections with External Targets") {
+  // 'call' to a target in front of the section, 'ret' and a branch
+  // behind the end of the section.
+  const machine_code outside{
+      0xffdff0ef, 0x00008067,
+      pack<instruction_format::b>(
+          {.opcode = 0b1100011, .funct3 = 0b001, .rs1 = 10, .rs2 = 11,
+           .imm = 16})};
+  const auto prog = decode(outside);
+  const auto label = get<label_id>(prog.instructions[0].operands[0]);
+  CHECK(prog.symbols.label_names[label] == ".L-4");
+  CHECK(prog.symbols.labels[label].address ==
+        symbol_table::label_data::invalid);
+
+  // References to the targets are left to the linker.
+  const auto code = encode_relocatable(prog);
+  REQUIRE(code.relocations.size() == 2);
+  CHECK(code.relocations[0] ==
+        relocation{0, label, instruction_format::j});
+  CHECK(prog.symbols.label_names[code.relocations[1].label] == ".L24");
+  CHECK(code.relocations[1].offset == 8);
+  CHECK(code.relocations[1].format == instruction_format::b);
+
+  // Applying them to their targets restores the section.
+  auto text = code.text;
+  CHECK(text != outside);
+  for (const auto& r : code.relocations) {
+    const auto name = prog.symbols.label_names[r.label];
+    const auto target = stoll(string(name.substr(2)));
+    text[r.offset / instruction_size] |= format_packers[size_t(r.format)](
+        {.imm = target - immediate(r.offset)});
+  }
+  CHECK(text == outside);
+
+  // Unknown word at byte offset 4.
+  const machine_code broken{0x00000013, 0xffffffff};
+  CHECK_THROWS_AS(decode(broken), runtime_error);
+}
@@ -0,0 +1,227 @@
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/elf.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+template <typename T>
+auto read(const vector<char>& bytes, size_t offset) {
+  T result{};
+  REQUIRE(offset + sizeof(T) <= bytes.size());
+  memcpy(&result, bytes.data() + offset, sizeof(T));
+  return result;
+}
+
+template <elf_class c>
+void check_object(const program& prog, const relocatable_code& code) {
+  using types = elf_types<c>;
+  using object = elf_object<c>;
+  const object obj{prog.symbols, code};
+  const auto bytes = obj.bytes();
+  CHECK(bytes.size() == obj.size());
+
+  const auto header = read<typename types::header>(bytes, 0);
+  CHECK(memcmp(header.e_ident, ELFMAG, SELFMAG) == 0);
+  CHECK(header.e_ident[EI_CLASS] == uint8_t(c));
+  CHECK(header.e_ident[EI_DATA] == ELFDATA2LSB);
+  CHECK(header.e_type == ET_REL);
+  CHECK(header.e_machine == EM_RISCV);
+  CHECK(header.e_flags == ((c == elf_class::elf64)
+                               ? EF_RISCV_FLOAT_ABI_DOUBLE
+                               : EF_RISCV_FLOAT_ABI_SOFT));
+  CHECK(header.e_shnum == object::section_count);
+  CHECK(header.e_shoff % types::alignment == 0);
+
+  const auto section = [&](size_t i) {
+    return read<typename types::section_header>(
+        bytes, header.e_shoff + i * header.e_shentsize);
+  };
+  const auto shstrtab = section(header.e_shstrndx);
+  const auto name = [&](size_t offset, size_t table) {
+    return string_view{bytes.data() + section(table).sh_offset + offset};
+  };
+  CHECK(name(section(object::text_section).sh_name, header.e_shstrndx) ==
+        ".text");
+  CHECK(name(section(object::rela_text_section).sh_name,
+             header.e_shstrndx) == ".rela.text");
+  CHECK(shstrtab.sh_type == SHT_STRTAB);
+
+  // Text section contains the encoded instructions.
+  const auto text = section(object::text_section);
+  CHECK(text.sh_size == code.text.size() * 4);
+  for (size_t i = 0; i < code.text.size(); ++i)
+    CHECK(read<uint32_t>(bytes, text.sh_offset + 4 * i) == code.text[i]);
+
+  // Symbols: null, section, local '.Lloop', global 'main' and 'extern'.
+  const auto symtab = section(object::symtab_section);
+  CHECK(symtab.sh_link == object::strtab_section);
+  CHECK(symtab.sh_entsize == sizeof(typename types::symbol));
+  REQUIRE(symtab.sh_size == 5 * sizeof(typename types::symbol));
+  CHECK(symtab.sh_info == 3);
+  const auto symbol = [&](size_t i) {
+    return read<typename types::symbol>(
+        bytes, symtab.sh_offset + i * symtab.sh_entsize);
+  };
+  CHECK(name(symbol(2).st_name, object::strtab_section) == ".Lloop");
+  CHECK(ELF64_ST_BIND(symbol(2).st_info) == STB_LOCAL);
+  CHECK(symbol(2).st_value == 4);
+  CHECK(name(symbol(3).st_name, object::strtab_section) == "main");
+  CHECK(ELF64_ST_BIND(symbol(3).st_info) == STB_GLOBAL);
+  CHECK(symbol(3).st_shndx == object::text_section);
+  CHECK(name(symbol(4).st_name, object::strtab_section) == "extern");
+  CHECK(symbol(4).st_shndx == SHN_UNDEF);
+
+  // One relocation for the call to the undefined label.
+  const auto rela = section(object::rela_text_section);
+  CHECK(rela.sh_link == object::symtab_section);
+  CHECK(rela.sh_info == object::text_section);
+  REQUIRE(rela.sh_size == sizeof(typename types::relocation));
+  const auto r = read<typename types::relocation>(bytes, rela.sh_offset);
+  CHECK(r.r_offset == 8);
+  if constexpr (c == elf_class::elf64) {
+    CHECK(ELF64_R_SYM(r.r_info) == 4);
+    CHECK(ELF64_R_TYPE(r.r_info) == R_RISCV_JAL);
+  } else {
+    CHECK(ELF32_R_SYM(r.r_info) == 4);
+    CHECK(ELF32_R_TYPE(r.r_info) == R_RISCV_JAL);
+  }
+}
+
+}  // namespace
+
+SCENARIO("Encoding Relocatable Code") {
+  const string source =
+      "main: addi a0, zero, 4\n"
+      ".Lloop: bne a0, zero, .Lloop\n"
+      "  call extern\n"
+      "  call main\n"
+      "  ret\n";
+  program prog{};
+  {
+    buffer_lexer lexer{source};
+    parser parser{lexer};
+    parser.parse(prog);
+  }
+
+  const auto code = encode_relocatable(prog);
+  CHECK(code.text.size() == 5);
+  CHECK(code.relocations ==
+        vector<relocation>{{8, 2, instruction_format::j}});
+  // The immediate of unresolved references stays zero.
+  CHECK(code.text[2] == 0x000000ef);
+
+  // The single-pass encoder produces the same result.
+  program streamed{};
+  single_pass_encoder encoder{streamed.symbols};
+  {
+    buffer_lexer lexer{source};
+    parser parser{lexer};
+    parser.parse(streamed, encoder);
+  }
+  const auto streamed_code = encoder.finish_relocatable();
+  CHECK(streamed_code.text == code.text);
+  CHECK(streamed_code.relocations == code.relocations);
+
+  check_object<elf_class::elf64>(prog, code);
+  check_object<elf_class::elf32>(prog, code);
+
+  // Files are written in one piece.
+  const auto path = filesystem::temp_directory_path() / "riscv-elf-test.o";
+  const elf_object obj{prog.symbols, code};
+  obj.write(path);
+  ifstream file{path, ios::binary};
+  const vector<char> content{istreambuf_iterator<char>{file},
+                             istreambuf_iterator<char>{}};
+  CHECK(content == obj.bytes());
+  filesystem::remove(path);
+}
+
+SCENARIO("Writing Data Sections") {
+  const string source =
+      "main: ret\n"
+      "table: .word 1, 2\n"
+      ".Lbytes: .byte 3\n";
+  program prog{};
+  {
+    buffer_lexer lexer{source};
+    parser parser{lexer};
+    parser.parse(prog);
+  }
+  using object = elf_object<elf_class::elf64>;
+  // The object refers to the text section of the code.
+  const auto code = encode_relocatable(prog);
+  const object obj{prog.symbols, code, prog.data};
+  const auto bytes = obj.bytes();
+  const auto header = read<Elf64_Ehdr>(bytes, 0);
+  const auto section = [&](size_t i) {
+    return read<Elf64_Shdr>(bytes, header.e_shoff + i * header.e_shentsize);
+  };
+  const auto name = [&](size_t offset, size_t table) {
+    return string_view{bytes.data() + section(table).sh_offset + offset};
+  };
+
+  const auto data = section(object::data_section);
+  CHECK(name(data.sh_name, header.e_shstrndx) == ".data");
+  CHECK(data.sh_type == SHT_PROGBITS);
+  CHECK(data.sh_flags == (SHF_ALLOC | SHF_WRITE));
+  CHECK(data.sh_offset % 8 == 0);
+  REQUIRE(data.sh_size == 9);
+  CHECK(string(bytes.data() + data.sh_offset, 9) ==
+        string{"\x01\0\0\0\x02\0\0\0\x03", 9});
+
+  // Symbols: null, section, local '.Lbytes', global 'main' and 'table'.
+  const auto symtab = section(object::symtab_section);
+  REQUIRE(symtab.sh_size == 5 * sizeof(Elf64_Sym));
+  const auto symbol = [&](size_t i) {
+    return read<Elf64_Sym>(bytes, symtab.sh_offset + i * sizeof(Elf64_Sym));
+  };
+  CHECK(name(symbol(2).st_name, object::strtab_section) == ".Lbytes");
+  CHECK(symbol(2).st_shndx == object::data_section);
+  CHECK(symbol(2).st_value == 8);
+  CHECK(ELF64_ST_TYPE(symbol(2).st_info) == STT_OBJECT);
+  CHECK(name(symbol(4).st_name, object::strtab_section) == "table");
+  CHECK(symbol(4).st_shndx == object::data_section);
+  CHECK(symbol(4).st_value == 0);
+  CHECK(symbol(3).st_shndx == object::text_section);
+  CHECK(ELF64_ST_TYPE(symbol(3).st_info) == STT_NOTYPE);
+}
+
+SCENARIO("Writing Objects with More Pieces than IOV_MAX") {
+  const auto path = filesystem::temp_directory_path() / "riscv-elf-pieces";
+  ofstream{path, ios::binary} << "incbin";
+
+  // Included files and values alternate and cannot be merged.
+  program prog{};
+  for (size_t i = 0; i < IOV_MAX; ++i) {
+    prog.data.append(mapped_file{path});
+    prog.data.append(i, 1);
+  }
+  REQUIRE(prog.data.segments().size() > IOV_MAX);
+
+  const auto code = encode_relocatable(prog);
+  const elf_object obj{prog.symbols, code, prog.data};
+  const auto object_path = path.string() + ".o";
+  obj.write(object_path);
+  ifstream file{object_path, ios::binary};
+  const vector<char> content{istreambuf_iterator<char>{file},
+                             istreambuf_iterator<char>{}};
+  CHECK(content.size() == obj.size());
+  CHECK(content == obj.bytes());
+  filesystem::remove(object_path);
+  filesystem::remove(path);
+}
@@ -0,0 +1,158 @@
+#include <sstream>
+#include <string>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto assemble(const string& str) {
+  buffer_lexer l{str};
+  parser p{l};
+  program prog;
+  p.parse(prog);
+  return encode(prog);
+}
+
+}  // namespace
+
+SCENARIO("Packing Instruction Formats") {
+  // add t0, t1, t2
+  CHECK(pack<instruction_format::r>({0b0110011, 5, 0, 6, 7, 0}) == 0x007302b3);
+  // addi t0, t1, -1
+  CHECK(pack<instruction_format::i>({0b0010011, 5, 0, 6, 0, 0, -1}) ==
+        0xfff30293);
+  // sd ra, 8(sp)
+  CHECK(pack<instruction_format::s>({0b0100011, 0, 3, 2, 1, 0, 8}) ==
+        0x00113423);
+  // lui a0, 0x12345
+  CHECK(pack<instruction_format::u>({0b0110111, 10, 0, 0, 0, 0, 0x12345}) ==
+        0x12345537);
+
+  CHECK_THROWS(pack<instruction_format::i>({0b0010011, 5, 0, 6, 0, 0, 2048}));
+  CHECK_THROWS(pack<instruction_format::b>({0b1100011, 0, 1, 0, 0, 0, 3}));
+  CHECK_THROWS(
+      pack<instruction_format::j>({0b1101111, 1, 0, 0, 0, 0, 1 << 20}));
+}
+
+SCENARIO("Encoding Programs") {
+  const auto code = assemble(
+      "main:\n"
+      "      add t0, t1, t2\n"
+      "      addi t0, t1, 10\n"
+      "loop: add a0, a0, -1\n"
+      "      ld ra, 50(sp)\n"
+      "      call test\n"
+      "      bne a0, a3, loop\n"
+      "      nop\n"
+      "test: ret\n");
+  CHECK(code == machine_code{
+                    0x007302b3,  // add t0, t1, t2
+                    0x00a30293,  // addi t0, t1, 10
+                    0xfff50513,  // addi a0, a0, -1
+                    0x03213083,  // ld ra, 50(sp)
+                    0x00c000ef,  // jal ra, 12
+                    0xfed51ae3,  // bne a0, a3, -12
+                    0x00000013,  // nop
+                    0x00008067,  // ret
+                });
+}
+
+SCENARIO("Encoding Rounding Modes of Conversions") {
+  // Exact conversions use the rounding mode 000 like the LLVM assembler.
+  // Other ones use the dynamic rounding mode 111.
+  CHECK(assemble("fcvt.d.w fa0, a0\n"
+                 "fcvt.d.wu fa0, a0\n"
+                 "fcvt.d.s fa0, fa1\n"
+                 "fcvt.s.w fa0, a0\n"
+                 "fcvt.d.l fa0, a0\n"
+                 "fcvt.s.d fa0, fa1\n"
+                 "fcvt.w.d a0, fa0\n") == machine_code{
+                                             0xd2050553,  // fcvt.d.w
+                                             0xd2150553,  // fcvt.d.wu
+                                             0x42058553,  // fcvt.d.s
+                                             0xd0057553,  // fcvt.s.w
+                                             0xd2257553,  // fcvt.d.l
+                                             0x4015f553,  // fcvt.s.d
+                                             0xc2057553,  // fcvt.w.d
+                                         });
+}
+
+SCENARIO("Encoding Errors") {
+  CHECK_THROWS(assemble("call undefined_label\n"));
+  CHECK_THROWS(assemble("addi a0, a0, 4096\n"));
+  CHECK_NOTHROW(assemble("addi a0, a0, -2048\n"));
+}
+
+SCENARIO("Single-Pass Encoding with Backpatching") {
+  const string str =
+      "      call end\n"
+      "main: bne a0, a1, end\n"
+      "      bne a0, a2, main\n"
+      "      call next\n"
+      "loop: add a0, a0, -1\n"
+      "next: bne a0, zero, loop\n"
+      "      call end\n"
+      "end:  ret\n";
+
+  buffer_lexer l{str};
+  parser p{l};
+  program prog;
+  single_pass_encoder encoder{prog.symbols};
+  p.parse(prog, encoder);
+
+  // Instructions are not stored and labels still know their address.
+  CHECK(prog.instructions.empty());
+  CHECK(prog.symbols.labels[prog.symbols.label_id("end")].address == 7);
+  CHECK(encoder.finish() == assemble(str));
+}
+
+SCENARIO("Single-Pass Encoding Errors") {
+  for (auto str : {"call undefined\n", "loop: nop\nloop: nop\n"}) {
+    CAPTURE(str);
+    buffer_lexer l{str};
+    parser p{l};
+    program prog;
+    single_pass_encoder encoder{prog.symbols};
+    CHECK_THROWS((p.parse(prog, encoder), encoder.finish()));
+  }
+}
+
+SCENARIO("Forward References of Compressed Instructions") {
+  const auto encode_single_pass = [](const string& str) {
+    buffer_lexer l{str};
+    parser p{l};
+    program prog;
+    single_pass_encoder encoder{prog.symbols};
+    p.parse(prog, encoder);
+    return encoder.finish();
+  };
+  const auto nops = [](size_t n) {
+    string result{};
+    for (size_t i = 0; i < n; ++i) result += "nop\n";
+    return result;
+  };
+
+  // Targets in range are patched like in the two-pass encoding.
+  for (auto str : {"c.beqz a0, end\n" + nops(60) + "end: ret\n",
+                   "c.j end\n" + nops(500) + "end: ret\n"}) {
+    CAPTURE(str);
+    CHECK(encode_single_pass(str) == assemble(str));
+  }
+
+  // Targets out of range fail like backward references.
+  for (auto str : {"c.beqz a0, end\n" + nops(64) + "end: ret\n",
+                   "c.j end\n" + nops(512) + "end: ret\n",
+                   "start: " + nops(65) + "c.beqz a0, start\n",
+                   "start: " + nops(513) + "c.j start\n"}) {
+    CAPTURE(str);
+    CHECK_THROWS_AS(encode_single_pass(str), runtime_error);
+    CHECK_THROWS_AS(assemble(str), runtime_error);
+  }
+}
@@ -0,0 +1,184 @@
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/incremental.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto assemble(const string& str) {
+  buffer_lexer l{str};
+  parser p{l};
+  program prog;
+  p.parse(prog);
+  return encode(prog);
+}
+
+auto join(const vector<string>& lines) {
+  string result{};
+  for (const auto& line : lines) result += line;
+  return result;
+}
+
+/// Random lines that only reference the labels '.L0' to '.L<n - 1>'.
+class line_generator {
+ public:
+  explicit line_generator(size_t n) : label{0, n - 1} {}
+
+  auto operator()() -> string {
+    switch (pick(rng)) {
+      case 0:
+        return "  call .L" + to_string(label(rng)) + "\n";
+      case 1:
+        return "  j .L" + to_string(label(rng)) + " // jump\n";
+      case 2:
+        return "/* comment\n   with newline */ addi a0, a0, 1\n";
+      case 3:
+        return "  ld ra, 8(sp) /* inline */\n";
+      case 4:
+        return "  // only comment\n";
+      default:
+        return "  addi a0, a1, " + to_string(pick(rng)) + "\n";
+    }
+  }
+
+  mt19937 rng{123};
+  uniform_int_distribution<size_t> pick{0, 7};
+  uniform_int_distribution<size_t> label;
+};
+
+}  // namespace
+
+SCENARIO("Incremental Assembly of Edited Sources") {
+  constexpr size_t label_count = 50;
+  line_generator generate{label_count};
+  vector<string> lines{};
+  vector<bool> is_label{};
+  for (size_t i = 0; i < 1000; ++i) {
+    const bool define = (i % 20 == 0);
+    lines.push_back(define ? ".L" + to_string(i / 20) + ":\n" : generate());
+    is_label.push_back(define);
+  }
+
+  incremental_assembler assembler{};
+  auto source = join(lines);
+  CHECK(assembler.assemble(source) == assemble(source));
+  CHECK(assembler.stats.reused_lines == 0);
+  // Equal lines are parsed only once.
+  CHECK(assembler.stats.parsed_lines < assembler.stats.lines);
+
+  // Edits only touch lines without label definitions.
+  uniform_int_distribution<size_t> position{0, lines.size() - 1};
+  uniform_int_distribution<size_t> kind{0, 2};
+  for (size_t edit = 0; edit < 200; ++edit) {
+    CAPTURE(edit);
+    auto i = position(generate.rng);
+    while (is_label[i]) i = (i + 1) % lines.size();
+    switch (kind(generate.rng)) {
+      case 0:
+        lines[i] = generate();
+        break;
+      case 1:
+        lines.insert(lines.begin() + i, generate());
+        is_label.insert(is_label.begin() + i, false);
+        break;
+      default:
+        lines.erase(lines.begin() + i);
+        is_label.erase(is_label.begin() + i);
+    }
+    source = join(lines);
+    const auto& code = assembler.assemble(source);
+    CHECK(code == assemble(source));
+    CHECK(assembler.stats.parsed_lines <= 2);
+    CHECK(assembler.stats.reused_lines + 2 >= assembler.stats.lines);
+  }
+
+  // Editing an instruction without labels re-encodes only itself.
+  const auto target = source.find("addi a0, a1, ");
+  REQUIRE(target != string::npos);
+  source.replace(target + 13, 1, "1234");
+  CHECK(assembler.assemble(source) == assemble(source));
+  CHECK(assembler.stats.encoded_instructions == 1);
+  CHECK(assembler.stats.parsed_lines == 1);
+
+  // Reverting the edit takes the line from the cache.
+  source = join(lines);
+  CHECK(assembler.assemble(source) == assemble(source));
+  CHECK(assembler.stats.parsed_lines == 0);
+  CHECK(assembler.stats.cached_lines == 1);
+}
+
+SCENARIO("Incremental Assembly with Multiline Comments") {
+  string source =
+      "main: call end\n"
+      "  addi a0, a0, 1\n"
+      "  addi a0, a0, 2\n"
+      "loop: j loop\n"
+      "end: ret\n";
+  incremental_assembler assembler{};
+  CHECK(assembler.assemble(source) == assemble(source));
+
+  // Opening a comment swallows unchanged lines behind the edit.
+  source.insert(source.find("  addi a0, a0, 1"), "/*");
+  source.insert(source.find("loop:"), "*/");
+  CHECK(assembler.assemble(source) == assemble(source));
+  CHECK(assembler.prog().instructions.size() == 3);
+
+  source.erase(source.find("/*"), 2);
+  source.erase(source.find("*/"), 2);
+  CHECK(assembler.assemble(source) == assemble(source));
+  CHECK(assembler.prog().instructions.size() == 5);
+
+  // Appending to an unterminated last line parses it again.
+  source.pop_back();
+  CHECK(assembler.assemble(source) == assemble(source));
+  source += "\n  nop";
+  CHECK(assembler.assemble(source) == assemble(source));
+}
+
+SCENARIO("Incremental Assembly Drops Unused Cached Lines") {
+  vector<string> lines{"main: addi a0, zero, 0\n", "", "  ret\n"};
+  incremental_assembler assembler{};
+  // Every edit gives the second line a content that has not been seen.
+  for (size_t i = 0; i < 2000; ++i) {
+    lines[1] = "  addi a0, a0, " + to_string(i) + "\n";
+    const auto source = join(lines);
+    CHECK(assembler.assemble(source) == assemble(source));
+    CHECK(assembler.cache_size() <= 2 * 3 + 256 + 1);
+  }
+  // Lines of the source are still cached after dropping unused ones.
+  assembler.assemble(join(lines) + "  nop\n");
+  CHECK(assembler.stats.parsed_lines == 1);
+  assembler.assemble(join(lines));
+  CHECK(assembler.stats.parsed_lines == 0);
+}
+
+SCENARIO("Incremental Assembly Recovers from Errors") {
+  string source =
+      "main: call end\n"
+      "  nop\n"
+      "end: ret\n";
+  incremental_assembler assembler{};
+  CHECK(assembler.assemble(source) == assemble(source));
+
+  // Removing a referenced label is an error.
+  auto broken = source;
+  broken.erase(broken.find("end:"), 4);
+  CHECK_THROWS_AS(assembler.assemble(broken), runtime_error);
+  CHECK_THROWS_AS(assembler.assemble("  add x1, x2\n"), runtime_error);
+  CHECK_THROWS_AS(assembler.assemble("table: .word 1\n"), runtime_error);
+
+  // After an error, everything is assembled again.
+  CHECK(assembler.assemble(source) == assemble(source));
+  CHECK(assembler.stats.reused_lines == 0);
+  CHECK(assembler.stats.parsed_lines == 3);
+}
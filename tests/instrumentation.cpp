@@ -0,0 +1,89 @@
+#include <array>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/instrumentation.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+SCENARIO("Instrumentation without Overhead") {
+  // The default instrumentation does not take any space in the parser
+  // and its token window. Both have the size of their other members.
+  static_assert(!no_instrumentation::enabled);
+  struct bare_window {
+    buffer_lexer& lex;
+    array<token, token_window<buffer_lexer>::capacity> tokens;
+    size_t count;
+  };
+  struct bare_parser {
+    buffer_lexer& lex;
+    bare_window window;
+    vector<label_id> pending_labels;
+  };
+  static_assert(sizeof(token_window<buffer_lexer>) == sizeof(bare_window));
+  static_assert(sizeof(parser<buffer_lexer>) == sizeof(bare_parser));
+  static_assert(sizeof(token_window<buffer_lexer, parse_statistics>) ==
+                sizeof(bare_window) + sizeof(parse_statistics*));
+
+  const string source = "add a0, a0, a1\n";
+  buffer_lexer lexer{source};
+  parser parser{lexer};
+  program prog{};
+  parser.parse(prog);
+  CHECK(prog.instructions.size() == 1);
+}
+
+SCENARIO("Recording Parse Statistics") {
+  const string source =
+      "main:\n"
+      "  add a0, a0, a1\n"
+      "  add a0, a0, -1   // The second overload of 'add'.\n"
+      "loop: bne a0, zero, loop\n"
+      "  call main\n"
+      "  ret\n";
+
+  pmr::monotonic_buffer_resource arena{};
+  counting_resource memory{&arena};
+  program prog{&memory};
+  buffer_lexer lexer{source};
+  parser<buffer_lexer, parse_statistics> parser{lexer};
+  ostringstream report{};
+  parser.stats.report = &report;
+  parser.stats.memory = &memory;
+  parser.parse(prog);
+  CHECK(prog.instructions.size() == 5);
+
+  const auto& stats = parser.stats;
+  CHECK(stats.lines == 6);
+  // Including the newline tokens and the end token.
+  CHECK(stats.tokens == 32);
+  CHECK(stats.lookups[size_t(parse_lookup::mnemonic)] == 5);
+  CHECK(stats.lookups[size_t(parse_lookup::label)] == 4);
+  CHECK(stats.lookups[size_t(parse_lookup::overload)] == 5);
+  CHECK(stats.failed_overloads == 0);
+  CHECK(memory.allocations() > 0);
+
+  // Exclusive stage times add up to the total time.
+  auto sum = parse_statistics::clock::duration{};
+  for (auto t : stats.times) {
+    CHECK(t.count() >= 0);
+    sum += t;
+  }
+  CHECK(sum == stats.total);
+
+  const auto json = report.str();
+  CHECK(json.starts_with("{\"seconds\":{\"total\":"));
+  CHECK(json.find("\"tokens\":32,\"lines\":6") != string::npos);
+  CHECK(json.find("\"lookups\":{\"mnemonic\":5,\"overload\":5,") !=
+        string::npos);
+  CHECK(json.find("\"failed_overloads\":0,\"allocations\":") !=
+        string::npos);
+  CHECK(json.ends_with("}\n"));
+}
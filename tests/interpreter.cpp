@@ -0,0 +1,331 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/interpreter.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto parse(const string& source) {
+  program prog{};
+  buffer_lexer lexer{source};
+  parser parser{lexer};
+  parser.parse(prog);
+  return prog;
+}
+
+}  // namespace
+
+SCENARIO("Interpreting Programs") {
+  // Sum of 64-bit words in memory with a function call per element.
+  const auto prog = parse(
+      "main:\n"
+      "  addi s0, ra, 0\n"
+      "  addi a0, zero, 0\n"
+      "  addi a1, zero, 0\n"
+      "  addi a2, zero, 80\n"
+      "loop:\n"
+      "  call load\n"
+      "  add a0, a0, a3\n"
+      "  addi a1, a1, 8\n"
+      "  nop\n"
+      "  bne a1, a2, loop\n"
+      "  addi ra, s0, 0\n"
+      "  ret\n"
+      "load:\n"
+      "  ld a3, 0x100(a1)\n"
+      "  ret\n");
+
+  interpreter vm{prog, 4096};
+  for (uint64_t i = 0; i < 10; ++i) {
+    const auto value = i * i - 3;
+    memcpy(vm.memory().data() + 0x100 + 8 * i, &value, sizeof(value));
+  }
+  CHECK(vm[sp] == 4096);
+  CHECK(vm[ra] == vm.halt_address());
+
+  const auto steps = vm.run();
+  CHECK(vm.halted());
+  CHECK(steps == 4 + 10 * 7 + 2);
+  CHECK(vm[a0] == 285 - 30);
+  CHECK(vm[a1] == 80);
+  CHECK(vm[zero] == 0);
+
+  // Execution can be stopped and continued.
+  vm.reset();
+  CHECK(vm.run(5) == 5);
+  CHECK(!vm.halted());
+  CHECK(vm.program_counter() == 11);
+  CHECK(vm.run() == steps - 5);
+  CHECK(vm.halted());
+  CHECK(vm[a0] == 285 - 30);
+}
+
+SCENARIO("Executing RV64I Instructions") {
+  // Every program leaves its result in 'a0'.
+  const pair<const char*, uint64_t> cases[]{
+      {"li a1, 7\nli a2, 9\nsub a0, a1, a2\n", uint64_t(-2)},
+      {"li a1, 3\nli a2, 65\nsll a0, a1, a2\n", 6},
+      {"li a1, -1\nli a2, 1\nslt a0, a1, a2\n", 1},
+      {"li a1, -1\nli a2, 1\nsltu a0, a1, a2\n", 0},
+      {"li a1, 12\nli a2, 10\nxor a0, a1, a2\n", 6},
+      {"li a1, -16\nli a2, 2\nsrl a0, a1, a2\n", (~uint64_t{0} >> 2) - 3},
+      {"li a1, -16\nli a2, 2\nsra a0, a1, a2\n", uint64_t(-4)},
+      {"li a1, 12\nli a2, 10\nor a0, a1, a2\n", 14},
+      {"li a1, 12\nli a2, 10\nand a0, a1, a2\n", 8},
+      {"li a1, -5\nslti a0, a1, -4\n", 1},
+      {"li a1, 5\nsltiu a0, a1, -1\n", 1},
+      {"seqz a0, zero\n", 1},
+      {"li a1, 5\nnot a0, a1\n", uint64_t(-6)},
+      {"li a1, 5\nori a0, a1, 0x70\n", 0x75},
+      {"li a1, 0x7f\nandi a0, a1, -8\n", 0x78},
+      {"li a1, 1\nslli a0, a1, 63\n", uint64_t{1} << 63},
+      {"li a1, -1\nsrli a0, a1, 60\n", 15},
+      {"li a1, -64\nsrai a0, a1, 4\n", uint64_t(-4)},
+      {"lui a1, 0x80000\naddi a1, a1, -1\naddw a0, a1, a1\n", uint64_t(-2)},
+      {"li a1, 1\nli a2, 2\nsubw a0, a1, a2\n", uint64_t(-1)},
+      {"li a1, 1\nli a2, 31\nsllw a0, a1, a2\n", 0xffffffff80000000},
+      {"li a1, -1\nli a2, 28\nsrlw a0, a1, a2\n", 15},
+      {"lui a1, 0x80000\nli a2, 28\nsraw a0, a1, a2\n", uint64_t(-8)},
+      {"lui a1, 0x7ffff\naddiw a0, a1, 2047\naddiw a0, a0, 2047\n"
+       "addiw a0, a0, 2047\n",
+       0xffffffff800007fd},
+      {"li a1, 3\nslliw a0, a1, 30\n", 0xffffffffc0000000},
+      {"li a1, -1\nsrliw a0, a1, 16\n", 0xffff},
+      {"lui a1, 0x80000\nsraiw a0, a1, 31\n", uint64_t(-1)},
+      {"li a1, 1\nsext.w a0, a1\n", 1},
+      {"lui a0, 0x12345\n", 0x12345000},
+      {"lui a0, 0xfffff\n", uint64_t(-4096)},
+      {"nop\nauipc a0, 1\n", 4096 + 4},
+      {"li a1, 1\nli a2, 1\nbeq a1, a2, skip\nli a0, 1\nskip: nop\n", 0},
+      {"li a1, -1\nblt a1, zero, skip\nli a0, 1\nskip: nop\n", 0},
+      {"li a1, -1\nbge a1, zero, skip\nli a0, 1\nskip: nop\n", 1},
+      {"li a1, -1\nbltu a1, zero, skip\nli a0, 1\nskip: nop\n", 1},
+      {"li a1, -1\nbgeu a1, zero, skip\nli a0, 1\nskip: nop\n", 0},
+  };
+  for (auto [source, expected] : cases) {
+    CAPTURE(source);
+    const auto prog = parse(source);
+    interpreter vm{prog};
+    vm.run();
+    CHECK(vm.halted());
+    CHECK(vm[a0] == expected);
+  }
+
+  // Stores write the lower bytes and loads extend them.
+  const auto prog = parse(
+      "  li a1, -2\n"
+      "  sd a1, 0x100(zero)\n"
+      "  li a1, 0x123\n"
+      "  sb a1, 0x100(zero)\n"
+      "  sh a1, 0x108(zero)\n"
+      "  sw a1, 0x110(zero)\n"
+      "  lb a2, 0x100(zero)\n"
+      "  lbu a3, 0x100(zero)\n"
+      "  lh a4, 0x100(zero)\n"
+      "  lhu a5, 0x100(zero)\n"
+      "  lw a6, 0x100(zero)\n"
+      "  lwu a7, 0x100(zero)\n"
+      "  ld s2, 0x100(zero)\n"
+      "  ld s3, 0x108(zero)\n"
+      "  ld s4, 0x110(zero)\n");
+  interpreter vm{prog, 4096};
+  vm.run();
+  CHECK(vm.halted());
+  CHECK(vm[a2] == 0x23);
+  CHECK(vm[a3] == 0x23);
+  CHECK(vm[a4] == uint64_t(int16_t(0xff23)));
+  CHECK(vm[a5] == 0xff23);
+  CHECK(vm[a6] == uint64_t(-221));
+  CHECK(vm[a7] == 0xffffff23);
+  CHECK(vm[s2] == uint64_t(-221));
+  CHECK(vm[s3] == 0x123);
+  CHECK(vm[s4] == 0x123);
+
+  // Stores out of bounds fail without changing the memory.
+  const auto store_prog = parse("li a0, 62\nsw a0, 0(a0)\n");
+  interpreter store{store_prog, 64};
+  CHECK_THROWS_AS(store.run(), runtime_error);
+  CHECK(store.program_counter() == 1);
+  CHECK(store.memory() == vector<uint8_t>(64));
+  const auto byte_prog = parse("li a0, 63\nsb a0, 0(a0)\n");
+  interpreter byte{byte_prog, 64};
+  byte.run();
+  CHECK(byte.memory()[63] == 63);
+
+  // Instructions outside of the RV64I base are not supported.
+  for (auto source : {"ecall\n", "mul a0, a0, a0\n", "fence\n"}) {
+    CAPTURE(source);
+    const auto prog = parse(source);
+    interpreter vm{prog};
+    CHECK_THROWS_AS(vm.run(), runtime_error);
+  }
+}
+
+SCENARIO("Interpreter Errors") {
+  // Writes to the zero register are discarded.
+  const auto zero_prog = parse("addi zero, zero, 5\nadd a0, zero, zero\n");
+  interpreter vm{zero_prog};
+  vm.run();
+  CHECK(vm[zero] == 0);
+  CHECK(vm[a0] == 0);
+
+  const auto load_prog = parse("addi a0, zero, -8\nld a1, 0(a0)\n");
+  interpreter load{load_prog, 64};
+  CHECK_THROWS_AS(load.run(), runtime_error);
+  CHECK(load.program_counter() == 1);
+
+  const auto jump_prog = parse("addi ra, zero, 2\nret\n");
+  interpreter jump{jump_prog};
+  CHECK_THROWS_AS(jump.run(), runtime_error);
+
+  // Instructions are decoded when their block is executed first.
+  const auto missing_prog = parse("call missing\n");
+  interpreter missing{missing_prog};
+  CHECK_THROWS_AS(missing.run(), runtime_error);
+
+  // Immediates have the same range as for the encoder.
+  for (auto source : {"addi a0, zero, 4096\n", "addi a0, zero, 5000000000\n",
+                      "ld a0, 2048(a0)\n"}) {
+    CAPTURE(source);
+    const auto prog = parse(source);
+    interpreter vm{prog};
+    CHECK_THROWS_AS(vm.run(), runtime_error);
+    CHECK(vm[a0] == 0);
+  }
+}
+
+SCENARIO("Caching Pre-Decoded Basic Blocks") {
+  const auto prog = parse(
+      "  addi a0, zero, 100\n"
+      "loop:\n"
+      "  addi a0, a0, -1\n"
+      "  nop\n"
+      "  bne a0, zero, loop\n"
+      "  ret\n");
+  interpreter vm{prog};
+  CHECK(vm.blocks().empty());
+
+  CHECK(vm.run() == 1 + 100 * 3 + 1);
+  CHECK(vm.halted());
+  CHECK(vm[a0] == 0);
+
+  // Entry block, loop block, exit block and the halting block.
+  // Every block is decoded only once no matter how often it runs.
+  const auto& blocks = vm.blocks();
+  REQUIRE(blocks.size() == 4);
+  CHECK(blocks[0].pc == 0);
+  CHECK(blocks[0].size == 4);
+  CHECK(blocks[1].pc == 1);
+  CHECK(blocks[1].size == 3);
+  CHECK(blocks[2].pc == 4);
+  CHECK(blocks[2].size == 1);
+  CHECK(blocks[3].pc == 5);
+  CHECK(vm.micro_ops().size() == 4 + 3 + 1 + 1);
+
+  // Running again reuses the cached blocks.
+  vm.reset();
+  CHECK(vm.run() == 1 + 100 * 3 + 1);
+  CHECK(vm.blocks().size() == 4);
+}
+
+SCENARIO("Translating Hot Blocks into Native Code") {
+  const auto prog = parse(
+      "main:\n"
+      "  addi s0, ra, 0\n"
+      "  addi a0, zero, 0\n"
+      "  addi a1, zero, 0\n"
+      "  addi a2, zero, 800\n"
+      "loop:\n"
+      "  call load\n"
+      "  add a0, a0, a3\n"
+      "  addi a1, a1, 8\n"
+      "  bne a1, a2, loop\n"
+      "  addi ra, s0, 0\n"
+      "  ret\n"
+      "load:\n"
+      "  ld a3, 0x100(a1)\n"
+      "  ret\n");
+
+  const auto setup = [](interpreter& vm, uint32_t threshold) {
+    vm.set_jit_threshold(threshold);
+    for (uint64_t i = 0; i < 100; ++i) {
+      const auto value = 3 * i + 1;
+      memcpy(vm.memory().data() + 0x100 + 8 * i, &value, sizeof(value));
+    }
+  };
+  interpreter reference{prog, 4096};
+  setup(reference, 0);
+  interpreter vm{prog, 4096};
+  setup(vm, 2);
+  CHECK(vm.jit_threshold() == 2);
+
+  const auto steps = reference.run();
+  CHECK(steps == 4 + 100 * 6 + 2);
+  CHECK(vm.run() == steps);
+  CHECK(vm.halted());
+  CHECK(vm.registers() == reference.registers());
+  CHECK(vm[a0] == 3 * 4950 + 100);
+#ifdef LYRAHGAMES_RISCV_X86_JIT
+  size_t translated = 0;
+  for (const auto& b : vm.blocks()) translated += (b.native != nullptr);
+  CHECK(translated >= 3);
+
+  // Native code is never writable and executable at the same time.
+  ifstream maps{"/proc/self/maps"};
+  for (string line{}; getline(maps, line);) {
+    CAPTURE(line);
+    const auto permissions = line.substr(line.find(' ') + 1, 4);
+    CHECK(!((permissions[1] == 'w') && (permissions[2] == 'x')));
+  }
+#endif
+
+  // Stopping at every step count gives the same state.
+  for (size_t n : {0, 1, 5, 17, 100, 333, 605}) {
+    reference.reset();
+    vm.reset();
+    CHECK(vm.run(n) == reference.run(n));
+    CHECK(vm.program_counter() == reference.program_counter());
+    CHECK(vm.registers() == reference.registers());
+    CHECK(vm.run() == reference.run());
+    CHECK(vm.registers() == reference.registers());
+  }
+}
+
+SCENARIO("Native Code Errors") {
+  // Faults in translated blocks are reported as by the interpreter.
+  const auto load_prog = parse(
+      "  addi a1, zero, 0\n"
+      "loop:\n"
+      "  addi a1, a1, 8\n"
+      "  ld a2, 0(a1)\n"
+      "  bne a1, zero, loop\n");
+  interpreter load{load_prog, 64};
+  load.set_jit_threshold(1);
+  CHECK_THROWS_AS(load.run(), runtime_error);
+  CHECK(load.program_counter() == 2);
+  CHECK(load[a1] == 64);
+
+  const auto jump_prog = parse(
+      "  addi a0, zero, 10\n"
+      "loop:\n"
+      "  addi a0, a0, -1\n"
+      "  bne a0, zero, loop\n"
+      "  addi ra, zero, 2\n"
+      "  ret\n");
+  interpreter jump{jump_prog};
+  jump.set_jit_threshold(1);
+  CHECK_THROWS_AS(jump.run(), runtime_error);
+  CHECK(jump.program_counter() == 4);
+  CHECK(jump[a0] == 0);
+}
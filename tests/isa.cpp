@@ -0,0 +1,154 @@
+#include <stdexcept>
+#include <string>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/decoder.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
+#include <lyrahgames/riscv/assembler/isa.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto parse(const string& str) {
+  buffer_lexer l{str};
+  parser p{l};
+  program prog;
+  p.parse(prog);
+  return prog;
+}
+
+/// Returns the 16-bit encoding of the only instruction in 'str'.
+auto compress(const string& str) -> uint16_t {
+  const auto prog = parse(str);
+  return compress(prog.instructions[0], 0, prog.symbols);
+}
+
+}  // namespace
+
+SCENARIO("Operand Syntax of Instruction Descriptions") {
+  using enum instruction_field;
+  constexpr auto load = operand_specs_of("rd,imm(rs1)");
+  static_assert(load.size() == 2);
+  static_assert(load[0].type == operand_type::int_register);
+  static_assert(load[0].fields == field_bit(rd));
+  static_assert(load[1].type == operand_type::memory_address);
+  static_assert(load[1].fields == (field_bit(rs1) | field_bit(imm)));
+
+  constexpr auto fmv = operand_specs_of("fd,fs1=fs2");
+  static_assert(fmv.size() == 2);
+  static_assert(fmv[1].type == operand_type::float_register);
+  static_assert(fmv[1].fields == (field_bit(rs1) | field_bit(rs2)));
+
+  constexpr auto csrrwi = operand_specs_of("rd,imm,zimm");
+  static_assert(csrrwi[2].type == operand_type::int_literal);
+  static_assert(csrrwi[2].fields == field_bit(rs1));
+
+  static_assert(operand_specs_of("").size() == 0);
+  CHECK_THROWS_AS(operand_specs_of("rd,rs4"), logic_error);
+}
+
+SCENARIO("Layouts of Compressed Instructions") {
+  constexpr compressed_layout lwsp{"010 uimm[5] rd uimm[4:2|7:6] 10"};
+  static_assert(lwsp);
+  static_assert(lwsp.mask() == 0xe003);
+  static_assert(lwsp.value() == 0x4002);
+  static_assert(lwsp.imm_width == 8);
+  static_assert(!lwsp.signed_imm);
+  static_assert(lwsp.contains(instruction_field::rd));
+  static_assert(!lwsp.contains(instruction_field::rs1));
+  static_assert(!compressed_layout{});
+
+  CHECK_THROWS_AS(compressed_layout{"010 rd 10"}, logic_error);
+}
+
+SCENARIO("Generated Instruction Tables") {
+  static_assert(instruction_names[0] == "add");
+  static_assert(instruction_names[2] == "addi");
+  static_assert(size(instruction_table) == rv64gc::size);
+
+  // Subsets of extensions are instruction sets on their own.
+  using rv64im = instruction_set<extension::i, extension::m>;
+  static_assert(rv64im::size ==
+                isa_extension<extension::i>::instructions.size() +
+                    isa_extension<extension::m>::instructions.size());
+
+  // Overloads of every mnemonic are stored consecutively.
+  for (size_t i = 0; i < size(instruction_names); ++i) {
+    const auto overloads = *mnemonic_map.find(instruction_names[i]);
+    CHECK(overloads.first <= i);
+    CHECK(i < overloads.last);
+  }
+
+  // Aliases take the format of their base instruction.
+  const auto fmv = mnemonic_map.find("fmv.d")->first;
+  CHECK(instruction_table[fmv].encoding.format == instruction_format::r);
+  CHECK(instruction_table[fmv].encoding.funct7 == 0b0010001);
+  const auto csrr = mnemonic_map.find("rdcycle")->first;
+  CHECK(instruction_table[csrr].encoding.imm == 0xc00);
+}
+
+SCENARIO("Compressing Instructions") {
+  CHECK(compress("c.li a0, 0") == 0x4501);
+  CHECK(compress("c.jr ra") == 0x8082);
+  CHECK(compress("c.addi sp, -16") == 0x1141);
+  CHECK(compress("c.sdsp ra, 8(sp)") == 0xe406);
+  CHECK(compress("c.mv a0, a1") == 0x852e);
+  CHECK(compress("c.addi16sp sp, 32") == 0x6105);
+  CHECK(compress("c.lw a0, 4(a1)") == 0x41c8);
+  // Upper immediates are accepted signed and as unsigned 20-bit values.
+  CHECK(compress("c.lui a0, -31") == 0x7505);
+  CHECK(compress("c.lui a0, 0xfffe1") == 0x7505);
+  CHECK(compress("c.lui a0, 0x1f") == 0x657d);
+
+  // Operands that cannot be represented in 16 bits.
+  CHECK_THROWS_AS(compress("c.lw t0, 4(a1)"), runtime_error);
+  CHECK_THROWS_AS(compress("c.lw a0, 2(a1)"), runtime_error);
+  CHECK_THROWS_AS(compress("c.addi sp, 32"), runtime_error);
+  CHECK_THROWS_AS(compress("c.addi4spn a0, a1, 16"), runtime_error);
+  CHECK_THROWS_AS(compress("c.addi16sp sp, 0"), runtime_error);
+  CHECK_THROWS_AS(compress("c.lui sp, 1"), runtime_error);
+  CHECK_THROWS_AS(compress("c.lui a0, 0xfffdf"), runtime_error);
+  CHECK_THROWS_AS(compress("c.lui a0, 0x20"), runtime_error);
+  CHECK_THROWS_AS(compress("c.mv a0, zero"), runtime_error);
+
+  // Compressed instructions are emitted as their expansion.
+  const auto prog = parse("c.addi sp, -16\nc.bnez a0, end\nc.j end\nend:\n");
+  const auto code = encode(prog);
+  REQUIRE(code.size() == 3);
+  CHECK(code[0] == 0xff010113);
+  for (size_t pc = 0; pc < code.size(); ++pc)
+    CHECK(expand(compress(prog.instructions[pc], pc, prog.symbols)) ==
+          code[pc]);
+  CHECK_THROWS_AS(encode(parse("c.addi sp, 32\n")), runtime_error);
+}
+
+SCENARIO("Compressed Round-Trip of All Parcels") {
+  // Every legal parcel expands to the instruction that compresses back.
+  size_t legal = 0;
+  for (uint32_t parcel = 0; parcel < 0x10000; ++parcel) {
+    if ((parcel & 0b11) == 0b11) continue;
+    size_t id = 0;
+    try {
+      id = decode_compressed_id(parcel);
+    } catch (const runtime_error&) {
+      continue;
+    }
+    const auto word = expand(parcel);
+    const auto& data = instruction_table[id];
+    auto f = format_unpackers[size_t(data.encoding.format)](word);
+    // The upper immediate of 'lui' is unpacked unsigned.
+    if (data.encoding.format == instruction_format::u)
+      f.imm = signed_bits(uint32_t(f.imm), 0, 20);
+    const auto result = lyrahgames::riscv::compress(id, f);
+    CAPTURE(parcel);
+    CHECK(result == parcel);
+    ++legal;
+  }
+  // Most parcels of the three quadrants are legal.
+  CHECK(legal > 3 * 0x4000 * 9 / 10);
+}
@@ -1,10 +1,18 @@
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <random>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 //
 #include <doctest/doctest.h>
 //
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/int_literal.hpp>
 #include <lyrahgames/riscv/assembler/lexer.hpp>
+#include <lyrahgames/riscv/assembler/mapped_file.hpp>
 
 using namespace std;
 using namespace lyrahgames::riscv;
@@ -135,6 +143,94 @@ SCENARIO("Parsing Integer Literals") {
   }
 }
 
+SCENARIO("Parsing 64-Bit Integer Literals") {
+  const auto parse = [](const string& str) {
+    buffer_lexer l{str};
+    const auto result = l.int_literal_match();
+    // The stream lexer has to give the same result.
+    stringstream stream{str};
+    lexer s{stream};
+    CHECK(s.int_literal_match() == result);
+    return result;
+  };
+
+  for (auto [str, value] : {
+           pair<string, int64_t>  //
+           {"9223372036854775807", INT64_MAX},
+           {"-9223372036854775808", INT64_MIN},
+           {"-0", 0},
+           {"00000000000000000000000000000042", 42},
+           {"1'000'000'000'000", 1'000'000'000'000},
+           {"0x7fff'ffff'ffff'ffff", INT64_MAX},
+           {"0xffffffffffffffff", -1},
+           {"-0x1", -1},
+           {"-0x8000000000000000", INT64_MIN},
+           {"-0b1" + string(63, '0'), INT64_MIN},
+           {"0XDeadBeef", 0xdeadbeef},
+           {"0x''1", 1},
+           {"0o1777777777777777777777", -1},
+           {"0b" + string(64, '1'), -1},
+           {"0b1" + string(63, '0'), INT64_MIN},
+       }) {
+    CAPTURE(str);
+    CHECK(parse(str) == value);
+  }
+
+  // Exceeding the range is an error and does not wrap around.
+  for (auto str : {
+           "9223372036854775808",
+           "-9223372036854775809",
+           "18446744073709551616",
+           "99999999999999999999999999",
+           "0x1'0000'0000'0000'0000",
+           "0o2000000000000000000000",
+           "-0xffffffffffffffff",
+           "-0x8000000000000001",
+           "-0o1777777777777777777777",
+       }) {
+    CAPTURE(str);
+    CHECK_THROWS_AS(parse(str), runtime_error);
+  }
+  CHECK_THROWS_AS(parse("0b1" + string(64, '0')), runtime_error);
+
+  for (auto str : {"0x1g", "12345678a", "1234567'", "0o12345678", "0x'"}) {
+    CAPTURE(str);
+    CHECK(!parse(str));
+  }
+
+  // Literals are usable in constant expressions.
+  constexpr auto value = [] {
+    czstring_iterator it = "0x1234'5678'9abc";
+    return parse_int_literal(it, it + 16);
+  }();
+  static_assert(value == 0x123456789abc);
+
+  // Random literals with separators are compared to standard conversions.
+  mt19937_64 rng{42};
+  for (size_t i = 0; i < 10000; ++i) {
+    const auto base = array{2, 8, 10, 16}[i % 4];
+    // Decimal literals are signed.
+    auto number = int64_t(rng() >> (rng() % 64));
+    if (base == 10) number &= INT64_MAX;
+    const auto negative = (base == 10) && (rng() % 2);
+    auto digits = string{};
+    auto n = uint64_t(number);
+    do {
+      digits += "0123456789abcdef"[n % base];
+      n /= base;
+    } while (n);
+    string str{};
+    for (size_t j = digits.size(); j-- > 0;) {
+      str += digits[j];
+      if (j && (rng() % 4 == 0)) str += '\'';
+    }
+    const auto prefix = array{"0b", "0o", "", "0x"}[i % 4];
+    str = (negative ? "-" : "") + string{prefix} + str;
+    CAPTURE(str);
+    CHECK(parse(str) == (negative ? -number : number));
+  }
+}
+
 SCENARIO("Parsing Identifiers") {
   for (auto str : {".", "_", "a", "X", ".L1", "_1", "next", "next_2", "next1",
                    "test_label"}) {
@@ -209,3 +305,113 @@ SCENARIO("Getting New Tokens") {
     CHECK(!l);
   }
 }
+
+SCENARIO("Compact Token Representation") {
+  static_assert(sizeof(token) <= 16);
+  static_assert(is_trivially_copyable_v<token>);
+
+  CHECK(token{}.is_end());
+  CHECK(token{'\n'}.is_separator('\n'));
+  CHECK(!token{'\n'}.is_separator(','));
+  CHECK(token{-123}.is_int_literal());
+  CHECK(token{-123}.as_int_literal() == -123);
+  CHECK(token{"loop"}.is_identifier());
+  CHECK(token{"loop"}.as_identifier() == "loop");
+
+  // Identifiers are compared by content and not by their address.
+  const string str = "loop";
+  CHECK(token{identifier{str}} == token{"loop"});
+  CHECK(token{"loop"} != token{"test"});
+  CHECK(token{10} != token{char(10)});
+  CHECK(token{} != token{0});
+}
+
+SCENARIO("Getting New Tokens from Contiguous Buffers") {
+  const std::string str =
+      "ld a0, 0x10 ( s0)\n"
+      "\n"
+      "main: // This is a comment\n"
+      "      addi t0, t1, -10\n"
+      "loop: call /* Multi-line comment */ test\n"
+      "/*test:\n"
+      "\n"
+      "  r*/et\n"
+      "  bne a0,a3,loop";
+  const token_list tokens{
+      identifier{"ld"},   identifier{"a0"}, ',',  int_literal{0x10},
+      '(',                identifier{"s0"}, ')',  '\n',  //
+      identifier{"main"}, ':',              '\n',        //
+      identifier{"addi"}, identifier{"t0"}, ',',  identifier{"t1"},
+      ',',                int_literal{-10}, '\n',  //
+      identifier{"loop"}, ':',              identifier{"call"},
+      identifier{"test"}, '\n',  //
+      identifier{"et"},   '\n',  //
+      identifier{"bne"},  identifier{"a0"}, ',',  identifier{"a3"},
+      ',',                identifier{"loop"}, '\n',  //
+      {},
+  };
+
+  buffer_lexer l{str};
+  for (const auto& t : tokens) {
+    const auto u = l.next_token();
+    CHECK(t == u);
+    // Identifiers have to reference the given buffer and not a copy.
+    if (u.is_identifier()) {
+      const auto id = u.as_identifier();
+      CHECK(str.data() <= id.data());
+      CHECK(id.data() + id.size() <= str.data() + str.size());
+    }
+  }
+  CHECK(!l);
+
+  // Unterminated multiline comments are an error.
+  buffer_lexer e{"add /* test"};
+  CHECK(e.next_token() == token{identifier{"add"}});
+  CHECK_THROWS(e.next_token());
+}
+
+SCENARIO("Getting String Literal Tokens") {
+  const std::string str = ".incbin \"data/table.bin\" // comment\n.incbin \"\"";
+  const token_list tokens{
+      identifier{".incbin"}, string_literal{"data/table.bin"}, '\n',
+      identifier{".incbin"}, string_literal{""}, '\n', {},
+  };
+  {
+    buffer_lexer l{str};
+    for (const auto& t : tokens) CHECK(l.next_token() == t);
+  }
+  {
+    stringstream stream{str};
+    lexer l{stream};
+    for (const auto& t : tokens) CHECK(l.next_token() == t);
+  }
+  CHECK(token{string_literal{"a"}} != token{identifier{"a"}});
+
+  // String literals end on the same line.
+  buffer_lexer l{"\"data\n\""};
+  CHECK_THROWS_AS(l.next_token(), runtime_error);
+  stringstream stream{"\"data"};
+  lexer s{stream};
+  CHECK_THROWS_AS(s.next_token(), runtime_error);
+}
+
+SCENARIO("Lexing Memory-Mapped Files") {
+  const auto path = filesystem::temp_directory_path() /
+                    "lyrahgames-riscv-mapped-file-test.s";
+  {
+    ofstream file{path};
+    file << "main: addi t0, t1, 10\n";
+  }
+  {
+    mapped_file file{path};
+    buffer_lexer l{file};
+    for (auto t : token_list{identifier{"main"}, ':', identifier{"addi"},
+                             identifier{"t0"}, ',', identifier{"t1"}, ',',
+                             int_literal{10}, '\n', {}})
+      CHECK(t == l.next_token());
+    CHECK(!l);
+  }
+  filesystem::remove(path);
+
+  CHECK_THROWS(mapped_file{"lyrahgames-riscv-missing-file.s"});
+}
@@ -0,0 +1,178 @@
+#include <chrono>
+#include <climits>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/object_cache.hpp>
+#include <lyrahgames/riscv/assembler/thread_pool.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto temporary_cache_directory(const string& name) {
+  const auto path = filesystem::temp_directory_path() /
+                    ("lyrahgames-riscv-object-cache-" + name);
+  filesystem::remove_all(path);
+  return path;
+}
+
+}  // namespace
+
+SCENARIO("Hashing the Content of Sources") {
+  const string source = "main: addi a0, a0, 1\n  call main\n";
+  CHECK(content_hash(source) == content_hash(source));
+  CHECK(content_hash(source) != content_hash(source, 1));
+  CHECK(content_hash("") != content_hash(string(1, '\0')));
+
+  // Every byte of longer inputs changes the hash.
+  string text(1000, 'a');
+  const auto hash = content_hash(text);
+  for (size_t i = 0; i < text.size(); ++i) {
+    text[i] = 'b';
+    CHECK(content_hash(text) != hash);
+    text[i] = 'a';
+  }
+
+  // Options of the assembler are part of the key.
+  CHECK(object_cache_key_of(source) == object_cache_key_of(source));
+  CHECK(object_cache_key_of(source) != object_cache_key_of(source, "elf32"));
+  CHECK(object_cache_key_of(source).size == source.size());
+}
+
+SCENARIO("Storing Objects in the Cache") {
+  const auto directory = temporary_cache_directory("store");
+  object_cache cache{directory};
+  const auto key = object_cache_key_of("nop\n");
+  CHECK(!cache.find(key));
+
+  const string object = "\x7f" "ELF object";
+  cache.insert(key, object);
+  const auto entry = cache.find(key);
+  REQUIRE(entry);
+  CHECK(entry->object() == object);
+  CHECK(!cache.find(object_cache_key_of("nop\n", "elf32")));
+
+  // Entries are written in pieces and replace previous ones.
+  const string first = "first ";
+  const string second = "second";
+  const vector<iovec> pieces{
+      {const_cast<char*>(first.data()), first.size()},
+      {const_cast<char*>(second.data()), second.size()}};
+  cache.insert(key, pieces);
+  CHECK(cache.find(key)->object() == first + second);
+  // Mapped entries stay valid after being replaced.
+  CHECK(entry->object() == object);
+
+  // More pieces than one 'writev' call accepts.
+  const string digits = "0123456789";
+  vector<iovec> many{};
+  string expected{};
+  for (size_t i = 0; i < 3 * IOV_MAX; ++i) {
+    many.push_back({const_cast<char*>(digits.data() + i % 10), 1});
+    expected += digits[i % 10];
+  }
+  cache.insert(key, many);
+  CHECK(cache.find(key)->object() == expected);
+
+  // Truncated and foreign files are ignored and removed.
+  const auto path = directory / key.file_name();
+  filesystem::resize_file(path, 10);
+  CHECK(!cache.find(key));
+  CHECK(!filesystem::exists(path));
+  ofstream{path} << "not an entry of the cache";
+  CHECK(!cache.find(key));
+  ofstream{path};
+  CHECK(!cache.find(key));
+
+  filesystem::remove_all(directory);
+}
+
+SCENARIO("Evicting Least Recently Used Objects") {
+  const auto directory = temporary_cache_directory("evict");
+  const string object(1000, 'x');
+  const auto entry_size = sizeof(object_cache::header) + object.size();
+  object_cache cache{directory, 3 * entry_size};
+
+  const auto key = [](int i) { return object_cache_key_of(to_string(i)); };
+  for (int i = 0; i < 3; ++i) {
+    cache.insert(key(i), object);
+    // Modification times need to be distinguishable.
+    filesystem::last_write_time(
+        directory / key(i).file_name(),
+        filesystem::file_time_type::clock::now() - chrono::seconds(10 - i));
+  }
+  CHECK(cache.size() == 3 * entry_size);
+
+  // Finding an entry marks it as recently used.
+  CHECK(cache.find(key(0)));
+  cache.insert(key(3), object);
+  CHECK(cache.size() == 3 * entry_size);
+  CHECK(cache.find(key(0)));
+  CHECK(!cache.find(key(1)));
+  CHECK(cache.find(key(2)));
+  CHECK(cache.find(key(3)));
+
+  // Temporary files of interrupted insertions are removed when stale.
+  const auto stale = directory / (key(0).file_name() + ".tmp-1-2-3");
+  const auto fresh = directory / (key(0).file_name() + ".tmp-1-2-4");
+  ofstream{stale} << "partial";
+  ofstream{fresh} << "partial";
+  filesystem::last_write_time(stale, filesystem::file_time_type::clock::now() -
+                                         object_cache::stale_time -
+                                         chrono::seconds(1));
+  CHECK(cache.size() == 3 * entry_size);
+  cache.evict();
+  CHECK(!filesystem::exists(stale));
+  CHECK(filesystem::exists(fresh));
+  filesystem::remove(fresh);
+
+  // Entries larger than the limit are evicted.
+  object_cache small{directory, 10};
+  small.evict();
+  CHECK(small.size() == 0);
+
+  filesystem::remove_all(directory);
+}
+
+SCENARIO("Concurrent Access to the Cache") {
+  const auto directory = temporary_cache_directory("concurrent");
+  constexpr size_t key_count = 8;
+  const auto object = [](size_t i) { return string(100 + i, char('a' + i)); };
+
+  // Every worker uses its own cache object like separate processes do.
+  vector<char> valid(4 * key_count);
+  {
+    thread_pool pool{4};
+    for (size_t task = 0; task < valid.size(); ++task) {
+      pool.submit([&, task] {
+        object_cache cache{directory};
+        const auto i = task % key_count;
+        const auto key = object_cache_key_of(to_string(i));
+        cache.insert(key, object(i));
+        const auto entry = cache.find(key);
+        valid[task] = entry && (entry->object() == object(i));
+      });
+    }
+    pool.wait();
+  }
+  for (size_t task = 0; task < valid.size(); ++task) {
+    CAPTURE(task);
+    CHECK(valid[task]);
+  }
+
+  // No temporary files are left behind.
+  size_t files = 0;
+  for (const auto& e : filesystem::directory_iterator{directory}) {
+    CHECK(e.path().extension() == ".o");
+    ++files;
+  }
+  CHECK(files == key_count);
+
+  filesystem::remove_all(directory);
+}
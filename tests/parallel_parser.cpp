@@ -0,0 +1,193 @@
+#include <random>
+#include <string>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/parallel_parser.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto random_source(size_t line_count) {
+  mt19937 rng{777};
+  uniform_int_distribution<size_t> pick{0, 9};
+  uniform_int_distribution<size_t> label{0, line_count / 8};
+  string result{};
+  for (size_t i = 0; i < line_count; ++i) {
+    switch (pick(rng)) {
+      case 0:
+        // Labels may refer to the following data and must be unique.
+        result += ".L" + to_string(i) + ":\n";
+        break;
+      case 1:
+        result += "  bne a0, a1, .L" + to_string(label(rng)) + "\n";
+        break;
+      case 2:
+        result += "  call .L" + to_string(label(rng)) + " // call\n";
+        break;
+      case 3:
+        // Multiline comments must never be split.
+        result += "/* comment\n\n  with newlines */\n";
+        break;
+      case 4:
+        result += "  ld ra, 8(sp) /* inline */\n";
+        break;
+      case 5:
+        result += "  // only comment with /* inside\n";
+        break;
+      case 6:
+        result += ".D" + to_string(i) + ": .word " + to_string(i) + ", -1\n";
+        break;
+      case 7:
+        // Labels on the previous line refer to this data.
+        result += "  .byte " + to_string(i % 256) + "\n";
+        break;
+      default:
+        result += "  addi a0, a0, " + to_string(i % 2048) + "\n";
+        break;
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+SCENARIO("Splitting Sources at Line Boundaries") {
+  const string str =
+      "add a0, a1, a2\n"
+      "/* comment\n"
+      "\n"
+      "   comment */ addi a0, a0, 1\n"
+      "// line comment /*\n"
+      "ret";
+  for (size_t n = 1; n < 2 * str.size(); ++n) {
+    CAPTURE(n);
+    const auto chunks = split_lines(str, n);
+    CHECK(chunks.size() <= n);
+    // Chunks are contiguous, cover everything and end behind newlines.
+    size_t size = 0;
+    for (auto chunk : chunks) {
+      CHECK(chunk.data() == str.data() + size);
+      size += chunk.size();
+      if (chunk.data() + chunk.size() != str.data() + str.size())
+        CHECK(chunk.back() == '\n');
+    }
+    CHECK(size == str.size());
+    // No chunk ends inside the multiline comment.
+    for (auto chunk : chunks) {
+      const auto end = chunk.data() + chunk.size() - str.data();
+      CHECK(((end <= 15) || (end >= 56)));
+    }
+  }
+  CHECK(split_lines("", 4).size() == 1);
+}
+
+SCENARIO("Splitting Sources behind Directives") {
+  // Labels on their own line stay with the directive they refer to.
+  const string str =
+      "  nop\n"
+      "table:\n"
+      "\n"
+      "  // comment\n"
+      "other:\n"
+      "  .word 1\n"
+      "  ret\n";
+  for (size_t n = 2; n < 2 * str.size(); ++n) {
+    CAPTURE(n);
+    for (auto chunk : split_lines(str, n)) {
+      const auto end = chunk.data() + chunk.size() - str.data();
+      CHECK(((end <= 6) || (end >= 44)));
+    }
+  }
+  CHECK(!has_directive("table:\n"));
+  CHECK(!has_directive("  // comment\n"));
+  CHECK(!has_directive(""));
+  CHECK(has_directive("table: .word 1\n"));
+  CHECK(has_directive("  ret\n"));
+}
+
+SCENARIO("Parsing Large Sources in Parallel") {
+  const auto source = random_source(5000);
+
+  program expected{};
+  {
+    buffer_lexer lexer{source};
+    parser parser{lexer};
+    parser.parse(expected);
+  }
+
+  thread_pool pool{4};
+  for (size_t n : {1, 2, 3, 7, 16, 100}) {
+    CAPTURE(n);
+    program prog{};
+    parallel_parse(source, prog, pool, n);
+    CHECK(prog.instructions == expected.instructions);
+    CHECK(prog.symbols.labels.size() == expected.symbols.labels.size());
+    for (symbol s = 0; s < prog.symbols.label_names.size(); ++s) {
+      CHECK(prog.symbols.label_names[s] == expected.symbols.label_names[s]);
+      CHECK(prog.symbols.labels[s].address ==
+            expected.symbols.labels[s].address);
+      CHECK(prog.symbols.labels[s].data == expected.symbols.labels[s].data);
+    }
+    CHECK(prog.data == expected.data);
+  }
+
+  // Errors are reported even if they occur in a later chunk.
+  program prog{};
+  CHECK_THROWS_AS(parallel_parse(source + "add x1, x2\n", prog, pool, 8),
+                  runtime_error);
+
+  // Labels defined in an earlier chunk cannot be redefined as data.
+  // Both text and data labels of the first chunk are redefined as data.
+  const auto first_label = [&](const string& prefix) {
+    const auto begin = source.find("\n" + prefix) + 1;
+    return source.substr(begin, source.find(':', begin) - begin);
+  };
+  for (auto redefinition : {first_label(".D") + ": .word 1\n",
+                            first_label(".L") + ":\n.byte 1\n"}) {
+    CAPTURE(redefinition);
+    program redefined{};
+    string message{};
+    try {
+      parallel_parse(source + redefinition, redefined, pool, 8);
+    } catch (const runtime_error& e) {
+      message = e.what();
+    }
+    CHECK(message.starts_with("Redefinition of label '"));
+  }
+}
+
+SCENARIO("Parallel Parse Errors Refer to the Source Line") {
+  // The invalid line is placed in the middle of a later chunk.
+  const auto source =
+      random_source(3000) + "add x1, x2\n" + random_source(1000);
+
+  string expected{};
+  try {
+    buffer_lexer lexer{source};
+    parser parser{lexer};
+    program prog{};
+    parser.parse(prog);
+  } catch (const parse_error& e) {
+    expected = e.what();
+  }
+  REQUIRE(!expected.empty());
+
+  thread_pool pool{4};
+  for (size_t n : {1, 2, 3, 7, 16, 100}) {
+    CAPTURE(n);
+    program prog{};
+    string message{};
+    try {
+      parallel_parse(source, prog, pool, n);
+    } catch (const parse_error& e) {
+      message = e.what();
+    }
+    CHECK(message == expected);
+  }
+}
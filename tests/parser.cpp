@@ -1,9 +1,13 @@
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 //
 #include <doctest/doctest.h>
 //
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
 #include <lyrahgames/riscv/assembler/deprecated.hpp>
+#include <lyrahgames/riscv/assembler/encoder.hpp>
 #include <lyrahgames/riscv/assembler/lexer.hpp>
 #include <lyrahgames/riscv/assembler/parser.hpp>
 
@@ -50,7 +54,7 @@ SCENARIO("Parsing Memory Addressing Schemes") {
     symbol_table symbols;
     auto it = tokens.cbegin();
     auto m = memory_address_match(it, it, symbols);
-    CHECK(holds_alternative<monostate>(*it));
+    CHECK(it->is_end());
     CHECK(m.value() == mem);
   }
 }
@@ -79,7 +83,7 @@ SCENARIO("Parsing Instruction Operands") {
        }) {
     CHECK(operand_match(it, it, symbols).value() == op);
   }
-  CHECK(holds_alternative<monostate>(*it));
+  CHECK(it->is_end());
   // cout << symbols;
 }
 
@@ -153,7 +157,7 @@ SCENARIO("Parsing Directives") {
     auto success = directive_match(it, it, prog);
 
     CHECK(success);
-    CHECK(holds_alternative<monostate>(*it));
+    CHECK(it->is_end());
   }
 
   cout << prog << '\n';
@@ -194,10 +198,13 @@ SCENARIO("") {
       "  ";
   auto stream = stringstream{str};
   lexer l{stream};
-  parser p{l};
+  token_window window{l};
   while (l) {
-    p.prefetch_token_line();
-    for (const auto& t : p.token_buffer) cout << t;
+    window.next_line();
+    for (auto it = window.begin();; ++it) {
+      cout << *it;
+      if (it->is_end() || it->is_separator('\n')) break;
+    }
     cout << '\n';
   }
 }
@@ -225,3 +232,281 @@ SCENARIO("") {
   p.parse(prog);
   cout << prog;
 }
+
+SCENARIO("Parsing Contiguous Buffers") {
+  const string str =
+      "main:\n"
+      "      addi t0, t1, 10\n"
+      "loop: call test // comment\n"
+      "      ld ra, 50(sp)\n"
+      "test: ret\n"
+      "  bne a0,a3,loop";
+
+  program expected;
+  {
+    auto stream = stringstream{str};
+    lexer l{stream};
+    parser p{l};
+    p.parse(expected);
+  }
+
+  buffer_lexer l{str};
+  parser p{l};
+  program prog;
+  p.parse(prog);
+
+  CHECK(prog.instructions == expected.instructions);
+  CHECK(prog.symbols.labels.size() == expected.symbols.labels.size());
+  for (symbol s = 0; s < prog.symbols.label_names.size(); ++s)
+    CHECK(prog.symbols.label_names[s] == expected.symbols.label_names[s]);
+  CHECK(prog.instructions.size() == 5);
+}
+
+SCENARIO("Streaming Tokens Through a Fixed Window") {
+  const string str =
+      "main: addi a0, zero, 1\n"
+      "      bne a0, zero, main";
+  buffer_lexer l{str};
+  token_window window{l};
+
+  // Tokens are pulled lazily and never beyond the end of the line.
+  auto it = window.begin();
+  CHECK(*(it + 2) == token{"addi"});
+  CHECK(l.position() == str.data() + 10);
+  CHECK(*(it + 20) == token{'\n'});
+  CHECK(*(it + 9) == token{'\n'});
+
+  window.next_line();
+  it = window.begin();
+  CHECK(*it == token{"bne"});
+  CHECK(*(it + 6) == token{'\n'});
+
+  // Lines that do not fit into the window are rejected.
+  string long_line = "add a0";
+  for (size_t i = 0; i < token_window<buffer_lexer>::capacity; ++i)
+    long_line += ", a0";
+  buffer_lexer long_lexer{long_line};
+  parser p{long_lexer};
+  program prog;
+  CHECK_THROWS_AS(p.parse(prog), runtime_error);
+}
+
+SCENARIO("Streaming Instructions to a Callback") {
+  const string str =
+      "main:\n"
+      "      addi t0, t1, 10\n"
+      "loop: call test // comment\n"
+      "      ld ra, 50(sp)\n"
+      "test: ret\n"
+      "  bne a0,a3,loop";
+
+  program expected;
+  {
+    buffer_lexer l{str};
+    parser p{l};
+    p.parse(expected);
+  }
+
+  buffer_lexer l{str};
+  parser p{l};
+  program prog;
+  vector<size_t> label_addresses{};
+  instruction_list instructions{};
+  callback_sink sink{
+      [&](size_t id) {
+        label_addresses.push_back(id);
+        label_addresses.push_back(instructions.size());
+      },
+      [&](instruction_view instr) { instructions.push_back(instr); }};
+  p.parse(prog, sink);
+
+  CHECK(prog.instructions.empty());
+  CHECK(instructions == expected.instructions);
+  CHECK(label_addresses == vector<size_t>{0, 0, 1, 1, 2, 3});
+}
+
+SCENARIO("Parsing Data Directives") {
+  string str =
+      "main: addi a0, zero, 1\n"
+      "table: .word 1, -1, 0x12345678 // comment\n"
+      "  .byte 0xff, -128 /* inline */, 7\n"
+      "  ret\n"
+      "constant: .dword 0x0123456789abcdef\n";
+  // Lists are not limited by the token window.
+  string expected_data =
+      string{"\x01\x00\x00\x00\xff\xff\xff\xff\x78\x56\x34\x12", 12} +
+      "\xff\x80\x07" + "\xef\xcd\xab\x89\x67\x45\x23\x01";
+  str += "long: .word 0";
+  expected_data.append(4, '\0');
+  for (size_t i = 1; i < 1000; ++i) {
+    str += ", " + to_string(i);
+    for (size_t k = 0; k < 4; ++k) expected_data += char(i >> 8 * k);
+  }
+  str += "\n";
+
+  program prog;
+  {
+    buffer_lexer l{str};
+    parser p{l};
+    p.parse(prog);
+  }
+  CHECK(prog.instructions.size() == 2);
+  CHECK(prog.data.bytes() == expected_data);
+  // Copied values are stored in one piece.
+  CHECK(prog.data.segments().size() == 1);
+  CHECK(!prog.data.includes_files());
+
+  const auto label = [&](string_view name) {
+    return prog.symbols.labels[prog.symbols.label_id(name)];
+  };
+  CHECK(!label("main").data);
+  CHECK(label("table").data);
+  CHECK(label("table").address == 0);
+  CHECK(label("constant").address == 15);
+  CHECK(label("long").address == 23);
+
+  // The stream lexer gives the same data.
+  program expected;
+  {
+    auto stream = stringstream{str};
+    lexer l{stream};
+    parser p{l};
+    p.parse(expected);
+  }
+  CHECK(expected.data == prog.data);
+
+  // Labels of data are no jump targets.
+  CHECK(encode(prog).size() == 2);
+  {
+    program jump;
+    buffer_lexer l{"j table\ntable: .byte 1\n"};
+    parser p{l};
+    p.parse(jump);
+    CHECK_THROWS_AS(encode(jump), runtime_error);
+  }
+
+  for (auto str : {".byte 256\n", ".byte -129\n", ".word 0x1'0000'0000\n"}) {
+    CAPTURE(str);
+    buffer_lexer l{str};
+    parser p{l};
+    program prog;
+    CHECK_THROWS_AS(p.parse(prog), runtime_error);
+  }
+  for (auto str : {".word\n", ".word 1,\n", ".word 1 2\n", ".byte a0\n",
+                   ".incbin\n", ".incbin 1\n", ".dword 1, \"x\"\n"}) {
+    CAPTURE(str);
+    buffer_lexer l{str};
+    parser p{l};
+    program prog;
+    CHECK_THROWS_AS(p.parse(prog), runtime_error);
+  }
+}
+
+SCENARIO("Binding Labels on Their Own Line") {
+  const string str =
+      "main:\n"
+      "  addi a0, zero, 1\n"
+      "table:\n"
+      "aliased: // comment\n"
+      "\n"
+      "  .word 1, 2\n"
+      "bytes:\n"
+      "  .byte 3\n"
+      "loop:\n"
+      "  j loop\n"
+      "end:\n";
+  program prog;
+  {
+    buffer_lexer l{str};
+    parser p{l};
+    p.parse(prog);
+  }
+  const auto label = [&](string_view name) {
+    return prog.symbols.labels[prog.symbols.label_id(name)];
+  };
+  CHECK(!label("main").data);
+  CHECK(label("main").address == 0);
+  CHECK(label("table").data);
+  CHECK(label("table").address == 0);
+  CHECK(label("aliased").data);
+  CHECK(label("aliased").address == 0);
+  CHECK(label("bytes").data);
+  CHECK(label("bytes").address == 8);
+  CHECK(!label("loop").data);
+  CHECK(label("loop").address == 1);
+  // Labels at the end refer to the end of the text.
+  CHECK(!label("end").data);
+  CHECK(label("end").address == 2);
+
+  // The single-pass encoder gets the same labels.
+  program encoded;
+  buffer_lexer l{str};
+  parser p{l};
+  single_pass_encoder encoder{encoded.symbols};
+  p.parse(encoded, encoder);
+  CHECK(encoder.finish_relocatable().text == encode_relocatable(prog).text);
+  CHECK(encoded.symbols.labels[encoded.symbols.label_id("table")].data);
+  CHECK(encoded.symbols.labels[encoded.symbols.label_id("end")].address ==
+        2);
+}
+
+SCENARIO("Redefining Labels of Data") {
+  // Labels of data are checked like the ones of instructions.
+  const auto error_of = [](const string& str, bool single_pass) {
+    buffer_lexer l{str};
+    parser p{l};
+    program prog;
+    single_pass_encoder encoder{prog.symbols};
+    try {
+      if (single_pass)
+        p.parse(prog, encoder);
+      else
+        p.parse(prog);
+    } catch (const runtime_error& e) {
+      return string{e.what()};
+    }
+    return string{};
+  };
+  for (auto str : {"a: .word 1\na: .word 2\n", "a: ret\na: .word 1\n",
+                   "a:\n  .word 1\na:\n  .byte 2\n",
+                   "a: .word 1\nb:\na:\n  .byte 2\n"}) {
+    CAPTURE(str);
+    CHECK(error_of(str, false) == "Redefinition of label 'a'.");
+    CHECK(error_of(str, true) == "Redefinition of label 'a'.");
+  }
+}
+
+SCENARIO("Including Binary Files") {
+  const auto path = filesystem::temp_directory_path() / "riscv-incbin-test";
+  string content(10000, '\0');
+  for (size_t i = 0; i < content.size(); ++i) content[i] = char(i * 7);
+  ofstream{path, ios::binary} << content;
+
+  const auto str = "  .byte 1\nblob: .incbin \"" + path.string() +
+                   "\"\nend: .byte 2\n";
+  program prog;
+  {
+    buffer_lexer l{str};
+    parser p{l};
+    p.parse(prog);
+  }
+  CHECK(prog.data.size() == content.size() + 2);
+  CHECK(prog.data.bytes() == "\x01" + content + "\x02");
+  // The file is referenced and not copied.
+  CHECK(prog.data.segments().size() == 3);
+  CHECK(prog.data.includes_files());
+  CHECK(prog.symbols.labels[prog.symbols.label_id("blob")].address == 1);
+  CHECK(prog.symbols.labels[prog.symbols.label_id("end")].address ==
+        content.size() + 1);
+
+  // Copies of the program share the mapping.
+  const auto copy = prog;
+  prog = program{};
+  CHECK(copy.data.bytes() == "\x01" + content + "\x02");
+
+  filesystem::remove(path);
+  buffer_lexer l{str};
+  parser p{l};
+  program missing;
+  CHECK_THROWS_AS(p.parse(missing), runtime_error);
+}
@@ -0,0 +1,107 @@
+#include <array>
+#include <string_view>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/perfect_hash.hpp>
+#include <lyrahgames/riscv/assembler/program.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+SCENARIO("Compile-Time Perfect Hash Maps") {
+  constexpr perfect_hash_map map{to_array<pair<string_view, int>>({
+      {"one", 1},
+      {"two", 2},
+      {"three", 3},
+  })};
+  static_assert(*map.find("one") == 1);
+  static_assert(*map.find("three") == 3);
+  static_assert(!map.find("four"));
+  static_assert(!map.find(""));
+
+  // Lookups with a hash of another key have to fail.
+  CHECK(!map.find("one", string_hash("two")));
+  CHECK(*map.find("two", string_hash("two")) == 2);
+}
+
+SCENARIO("Register and Mnemonic Tables Are Built at Compile Time") {
+  static_assert(*int_register_map.find("zero") == x0);
+  static_assert(*int_register_map.find("s11") == x27);
+  static_assert(!int_register_map.find("x32"));
+  static_assert(mnemonic_map.find("add")->first == 0);
+  static_assert(mnemonic_map.find("add")->last == 2);
+  static_assert(mnemonic_map.size() == mnemonic_count);
+  static_assert(mnemonic_map.find("fmadd.d"));
+  static_assert(mnemonic_map.find("amoswap.w.aqrl"));
+  static_assert(*float_register_map.find("fa0") == f10);
+  static_assert(!float_register_map.find("a0"));
+
+  // Every entry has to be reachable through its own hash.
+  for (const auto& e : int_register_map)
+    CHECK(int_register_map.find(e.key, e.hash) == &e.value);
+  for (size_t i = 0; i < size(instruction_names); ++i) {
+    const auto r = mnemonic_map.find(instruction_names[i]);
+    CHECK(r->first <= i);
+    CHECK(i < r->last);
+  }
+}
+
+SCENARIO("Overload Resolution by Operand Signatures") {
+  using enum operand_type;
+  static_assert(operand_signature_of(operand_specs_of("rd,rs1,rs2")) ==
+                0x3000);
+  static_assert(operand_signature_of(operand_specs_of("rd,rs1,imm")) ==
+                0x3040);
+  static_assert(operand_signature_of(operand_specs_of("label")) == 0x1003);
+  static_assert(operand_value_list{x1, immediate{2}}.signature() == 0x2008);
+  static_assert(operand_signature_of(operand_specs_of("fd,fs1,fs2")) ==
+                0x3124);
+  static_assert(operand_value_list{}.signature() == 0);
+
+  // Every overload is found by its own operand types.
+  for (size_t i = 0; i < size(instruction_table); ++i) {
+    const auto overloads = *mnemonic_map.find(instruction_names[i]);
+    const auto s = instruction_table[i].signature;
+    const auto id = symbol_table::find_overload(overloads, s);
+    // Overloads with equal signatures, like 'jal label' and 'call', do
+    // not exist. Hence, every overload is found by its own signature.
+    CHECK(id == i);
+  }
+
+  // Operand types without overload fail for every mnemonic.
+  const auto add = *mnemonic_map.find("add");
+  const operand_value_list operands{x1, x2};
+  CHECK(symbol_table::find_overload(add, operands.signature()) ==
+        symbol_table::no_overload);
+  const auto ret = *mnemonic_map.find("ret");
+  CHECK(symbol_table::find_overload(ret, operand_value_list{x1}.signature()) ==
+        symbol_table::no_overload);
+  // Try all signatures of up to four operands for every mnemonic.
+  vector<operand_signature> signatures{};
+  for (size_t count = 0; count <= 4; ++count) {
+    size_t combinations = 1;
+    for (size_t i = 0; i < count; ++i) combinations *= operand_type_count;
+    for (size_t k = 0; k < combinations; ++k) {
+      operand_signature s = count << operand_count_shift;
+      for (size_t i = 0, x = k; i < count; ++i, x /= operand_type_count)
+        s |= (x % operand_type_count) << (operand_type_bits * i);
+      signatures.push_back(s);
+    }
+  }
+  for (const auto& [name, hash, overloads] : mnemonic_map) {
+    size_t found = 0;
+    bool valid = true;
+    for (auto s : signatures) {
+      const auto id = symbol_table::find_overload(overloads, s);
+      if (id == symbol_table::no_overload) continue;
+      ++found;
+      valid = valid && (overloads.first <= id) && (id < overloads.last) &&
+              (instruction_table[id].signature == s);
+    }
+    CAPTURE(name);
+    CHECK(valid);
+    CHECK(found == overloads.last - overloads.first);
+  }
+}
@@ -0,0 +1,113 @@
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <sstream>
+#include <string>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/buffer_lexer.hpp>
+#include <lyrahgames/riscv/assembler/parser.hpp>
+#include <lyrahgames/riscv/assembler/program.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+SCENARIO("Storing Operands In Place") {
+  operand_value_list list{x1, immediate{-3}};
+  CHECK(list.size() == 2);
+  CHECK(!list.empty());
+  CHECK(!list.full());
+  CHECK(list[0] == operand_value{x1});
+  CHECK(list[1] == operand_value{immediate{-3}});
+  CHECK(list == operand_value_list{x1, immediate{-3}});
+  CHECK(list != operand_value_list{x1});
+  CHECK(operand_value_list{x1} < list);
+
+  list.push_back(memory_address{x2, 8});
+  list.push_back(size_t{0});
+  CHECK(list.full());
+  CHECK_THROWS_AS((operand_value_list{x1, x2, x3, x4, x5}), length_error);
+
+  stringstream out{};
+  out << list;
+  CHECK(out.str() == "x1[00001], -3, 8(x2[00010]), $0");
+}
+
+SCENARIO("Storing Instructions as Structure of Arrays") {
+  const vector<instruction> instructions{
+      {0, {x5, x6, x7}},
+      {6, {}},
+      {3, {x10, x0, size_t{0}}},
+      {4, {x1, memory_address{x2, 16}}},
+  };
+
+  instruction_list list{};
+  CHECK(list.empty());
+  for (const auto& instr : instructions) list.push_back(instr);
+  CHECK(list.size() == instructions.size());
+
+  for (size_t i = 0; const auto instr : list) {
+    CAPTURE(i);
+    CHECK(instr.id == instructions[i].id);
+    CHECK(list.id(i) == instructions[i].id);
+    CHECK(ranges::equal(instr.operands, instructions[i].operands));
+    ++i;
+  }
+  CHECK(list[1].operands.empty());
+
+  auto copy = list;
+  CHECK(copy == list);
+  copy.push_back(instructions[0]);
+  CHECK(copy != list);
+  copy.clear();
+  CHECK(copy.empty());
+}
+
+SCENARIO("Rejecting Too Many Operands") {
+  const string source = "add x1, x2, x3, x4, x5\n";
+  buffer_lexer lexer{source};
+  parser parser{lexer};
+  program prog{};
+  CHECK_THROWS_AS(parser.parse(prog), runtime_error);
+}
+
+SCENARIO("Allocating Parse State from an Arena") {
+  const string source =
+      "main:\n"
+      "  addi a0, zero, 16\n"
+      "loop:\n"
+      "  ld ra, 8(sp)\n"
+      "  bne a0, zero, loop\n"
+      "  call main\n"
+      "  ret\n";
+
+  program expected{};
+  {
+    stringstream input{source};
+    lexer lexer{input};
+    parser parser{lexer};
+    parser.parse(expected);
+  }
+
+  // Every allocation has to go to the arena. Falling back to
+  // the default resource or exhausting the buffer throws.
+  alignas(max_align_t) array<byte, 1 << 16> buffer;
+  pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size(),
+                                       pmr::null_memory_resource()};
+  const auto default_resource =
+      pmr::set_default_resource(pmr::null_memory_resource());
+  {
+    program prog{&arena};
+    stringstream input{source};
+    lexer lexer{input, &arena};
+    parser parser{lexer};
+    CHECK_NOTHROW(parser.parse(prog));
+    CHECK(prog.instructions.size() == 5);
+    CHECK(prog.instructions == expected.instructions);
+    CHECK(prog.symbols.label_names.size() == 2);
+    CHECK(prog.symbols.labels[prog.symbols.label_id("loop")].address == 1);
+  }
+  pmr::set_default_resource(default_resource);
+}
@@ -0,0 +1,79 @@
+#include <random>
+#include <string>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/scan_kernel.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+namespace {
+
+auto available_scan_kernels() {
+  vector<const scan_kernel*> result{&scalar_scan_kernel};
+#ifdef LYRAHGAMES_RISCV_X86_SIMD
+  result.push_back(&sse2_scan_kernel);
+  if (__builtin_cpu_supports("avx2")) result.push_back(&avx2_scan_kernel);
+#endif
+  return result;
+}
+
+}  // namespace
+
+SCENARIO("Scanning Kernels Agree with Scalar Reference") {
+  // Small alphabet to produce many boundaries of every character class.
+  const string alphabet = "  \t\t\n*/ab_.09Z,:(-\x80\xff";
+  mt19937 rng{12345};
+  uniform_int_distribution<size_t> pick{0, alphabet.size() - 1};
+  uniform_int_distribution<size_t> run{0, 80};
+
+  for (int i = 0; i < 2000; ++i) {
+    // Build long runs of one character class to cross vector boundaries.
+    string str{};
+    while (str.size() < 200) {
+      const auto c = alphabet[pick(rng)];
+      str.append(run(rng), c);
+      str += alphabet[pick(rng)];
+    }
+    // Embedded null characters must also be handled.
+    if (i % 7 == 0) str[pick(rng) * 9] = '\0';
+
+    const auto n = uniform_int_distribution<size_t>{0, str.size()}(rng);
+    const auto first = str.data() + n / 3;
+    const auto last = str.data() + n;
+
+    for (auto k : available_scan_kernels()) {
+      CAPTURE(k->name);
+      CHECK(k->space(first, last) == scalar::scan_space(first, last));
+      CHECK(k->line_end(first, last) == scalar::scan_line_end(first, last));
+      CHECK(k->comment_end(first, last) ==
+            scalar::scan_comment_end(first, last));
+      CHECK(k->identifier_tail(first, last) ==
+            scalar::scan_identifier_tail(first, last));
+    }
+  }
+}
+
+SCENARIO("Scanning Kernels Find Lexeme Boundaries") {
+  for (auto k : available_scan_kernels()) {
+    CAPTURE(k->name);
+    const string str =
+        "   \t  \t      \t\t          \t       \t      next_label.2 // comment "
+        "that is long enough to fill multiple vector registers\n"
+        "/* multiline comment that has to be skipped at once * / **/";
+    const auto first = str.data();
+    const auto last = first + str.size();
+
+    const auto id = k->space(first, last);
+    CHECK(*id == 'n');
+    const auto id_end = k->identifier_tail(id, last);
+    CHECK(string(id, id_end) == "next_label.2");
+    const auto newline = k->line_end(id_end, last);
+    CHECK(*newline == '\n');
+    const auto comment_end = k->comment_end(newline + 3, last);
+    CHECK(comment_end == last - 2);
+    CHECK(k->comment_end(comment_end + 1, last) == last);
+  }
+}
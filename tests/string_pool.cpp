@@ -0,0 +1,102 @@
+#include <memory_resource>
+#include <string>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/program.hpp>
+#include <lyrahgames/riscv/assembler/string_pool.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+SCENARIO("Interning Strings") {
+  string_pool pool{};
+  CHECK(pool.empty());
+  CHECK(!pool.find("main"));
+
+  CHECK(pool.insert("main") == pair{symbol{0}, true});
+  CHECK(pool.insert("loop") == pair{symbol{1}, true});
+  CHECK(pool.insert("main") == pair{symbol{0}, false});
+  CHECK(pool.size() == 2);
+  CHECK(pool[0] == "main");
+  CHECK(pool[1] == "loop");
+  CHECK(pool.find("loop").value() == 1);
+  CHECK(pool.find("loop", string_hash("loop")).value() == 1);
+  CHECK(!pool.find("test"));
+
+  // Symbols and views have to stay stable while the pool grows.
+  const auto main_view = pool[0];
+  vector<string> labels{};
+  for (size_t i = 0; i < 10'000; ++i) labels.push_back(".L" + to_string(i));
+  for (size_t i = 0; i < labels.size(); ++i)
+    CHECK(pool.insert(labels[i]).first == i + 2);
+  CHECK(pool.size() == labels.size() + 2);
+  CHECK(main_view.data() == pool[0].data());
+  for (size_t i = 0; i < labels.size(); ++i)
+    CHECK(pool.find(labels[i]).value() == i + 2);
+
+  // Copies own their characters.
+  string_pool copy = pool;
+  pool.clear();
+  CHECK(pool.empty());
+  CHECK(!pool.find("main"));
+  CHECK(copy.size() == labels.size() + 2);
+  CHECK(copy.find(".L9999").value() == 10'001);
+  CHECK(copy[1] == "loop");
+}
+
+SCENARIO("Moving String Pools Between Memory Resources") {
+  pmr::monotonic_buffer_resource arena{};
+  program prog{&arena};
+  for (size_t i = 0; i < 100; ++i) prog.symbols.label_id(".L" + to_string(i));
+
+  // Moved pools keep the memory resource of their source.
+  auto moved = std::move(prog);
+  CHECK(moved.symbols.label_names.size() == 100);
+  CHECK(moved.symbols.label_names[42] == ".L42");
+  CHECK(prog.symbols.label_names.empty());
+
+  // Pools with another resource copy the strings.
+  program other{};
+  other.symbols.label_id("main");
+  other = std::move(moved);
+  CHECK(other.symbols.label_names.size() == 100);
+  CHECK(other.symbols.label_names.find(".L99").value() == 99);
+  CHECK(!other.symbols.label_names.find("main"));
+
+  // Pools with equal resources take over the blocks.
+  string_pool first{&arena};
+  first.insert("first");
+  const auto view = first[0];
+  string_pool second{&arena};
+  second.insert("second");
+  second = std::move(first);
+  CHECK(second.size() == 1);
+  CHECK(second[0].data() == view.data());
+  CHECK(first.empty());
+  first.insert("again");
+  CHECK(first[0] == "again");
+}
+
+SCENARIO("Resolving Labels and Keywords by Interned Symbols") {
+  symbol_table symbols{};
+  CHECK(symbols.label_id("loop") == 0);
+  CHECK(symbols.label_id("test") == 1);
+  CHECK(symbols.label_id("loop", string_hash("loop")) == 0);
+  CHECK(symbols.labels.size() == 2);
+  CHECK(symbols.label_names[1] == "test");
+
+  CHECK(symbols.find_int_register("a0", string_hash("a0")).value() == a0);
+  CHECK(symbols.find_int_register("zero", string_hash("zero")).value() == x0);
+  CHECK(!symbols.find_int_register("add", string_hash("add")));
+  CHECK(!symbols.find_int_register("loop", string_hash("loop")));
+
+  const auto add = symbols.find_instruction("add", string_hash("add"));
+  CHECK(add.first == 0);
+  CHECK(add.last == 2);
+  const auto ret = symbols.find_instruction("ret", string_hash("ret"));
+  CHECK(ret.last - ret.first == 1);
+  const auto a0 = symbols.find_instruction("a0", string_hash("a0"));
+  CHECK(a0.first == a0.last);
+}
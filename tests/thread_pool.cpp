@@ -0,0 +1,38 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+//
+#include <doctest/doctest.h>
+//
+#include <lyrahgames/riscv/assembler/thread_pool.hpp>
+
+using namespace std;
+using namespace lyrahgames::riscv;
+
+SCENARIO("Running Tasks on a Work-Stealing Thread Pool") {
+  thread_pool pool{4};
+  CHECK(pool.size() == 4);
+
+  vector<size_t> results(1000);
+  for (size_t i = 0; i < results.size(); ++i)
+    pool.submit([&, i] { results[i] = 2 * i; });
+  pool.wait();
+  for (size_t i = 0; i < results.size(); ++i) CHECK(results[i] == 2 * i);
+
+  // Tasks submitted by tasks are waited for as well.
+  atomic<size_t> count = 0;
+  for (size_t i = 0; i < 16; ++i) {
+    pool.submit([&] {
+      for (size_t j = 0; j < 64; ++j) pool.submit([&] { ++count; });
+    });
+  }
+  pool.wait();
+  CHECK(count == 16 * 64);
+
+  // The first exception is rethrown and the pool stays usable.
+  pool.submit([] { throw runtime_error("task failed"); });
+  CHECK_THROWS_AS(pool.wait(), runtime_error);
+  pool.submit([&] { ++count; });
+  CHECK_NOTHROW(pool.wait());
+  CHECK(count == 16 * 64 + 1);
+}